@@ -5,6 +5,7 @@
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 #include "gameState.h"
+#include "textureLoader.h"
 #include <iostream>
 #include <unordered_map>
 #include <string>
@@ -13,9 +14,10 @@ class GUI {
 private:
     // No more UI state flags - moved to GameState
     std::unordered_map<std::string, GLuint> imageTextures; // Cache for loaded textures
+    TextureLoader* textureLoader = nullptr;
     
 public:
-    bool Initialize(GLFWwindow* window); 
+    bool Initialize(GLFWwindow* window, TextureLoader* loader); 
     void NewFrame();                      
     void Render(GameState* gameState);                        
     void Shutdown();                      
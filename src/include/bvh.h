@@ -0,0 +1,90 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One node of the flattened hierarchy, 32 bytes so two fit a cache line.
+// Children of an interior node are stored next to each other, so one index
+// reaches both.
+struct BVHNode {
+    glm::vec3 boundsMin;
+    uint32_t leftOrFirst; // interior: index of the left child (right = left + 1); leaf: first triangle
+    glm::vec3 boundsMax;
+    uint32_t count;       // 0 for interior nodes, triangle count for leaves
+
+    bool isLeaf() const { return count > 0; }
+};
+
+static_assert(sizeof(BVHNode) == 32, "BVHNode must stay 32 bytes");
+
+struct BVHTriangle {
+    glm::vec3 v0, v1, v2;
+};
+
+// Nearest hit of a ray cast.
+struct BVHRayHit {
+    float distance = 0.0f;
+    uint32_t triangle = 0; // index into triangles()
+    uint32_t mesh = 0;     // mesh the triangle came from
+};
+
+// Counters of the last build.
+struct BVHBuildStats {
+    unsigned int triangles = 0;
+    unsigned int nodes = 0;
+    unsigned int leaves = 0;
+    unsigned int maxDepth = 0;
+    float milliseconds = 0.0f;
+    bool fromCache = false;
+};
+
+// Bounding volume hierarchy over the triangles of a static model, in model
+// space. Built top-down with binned SAH splits; subtrees above a size
+// threshold are built on worker threads. The nodes live in one array in
+// depth-first order, and the triangles are reordered to match the leaves, so
+// traversal walks memory mostly forward.
+//
+// Queries:
+//   frustum  - meshes with at least one leaf touching the frustum
+//   raycast  - nearest triangle hit along a ray
+//   sphere   - triangles overlapping a sphere, for collision and interaction
+class TriangleBVH {
+public:
+    // Appends the triangles of one mesh; mesh is the id reported back by queries.
+    void addMesh(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices, uint32_t mesh);
+    void build();
+    void clear();
+
+    bool empty() const { return nodes.empty(); }
+    const std::vector<BVHNode>& hierarchy() const { return nodes; }
+    const std::vector<BVHTriangle>& triangles() const { return tris; }
+    uint32_t triangleMesh(uint32_t triangle) const { return triMeshes[triangle]; }
+    uint32_t meshCount() const { return meshTotal; }
+    const BVHBuildStats& stats() const { return buildStats; }
+
+    // Marks visible[mesh] = 1 for every mesh with a leaf inside the frustum of
+    // clip = viewProjectionModel; visible is resized to meshCount().
+    void queryFrustum(const glm::mat4& viewProjectionModel, std::vector<uint8_t>& visible) const;
+    // Nearest hit within maxDistance; direction must be normalized.
+    bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, BVHRayHit& hit) const;
+    // Appends the triangles overlapping the sphere; returns true if there was any.
+    bool overlapSphere(const glm::vec3& center, float radius, std::vector<uint32_t>& out) const;
+
+    // Flat image for the mesh cache, in host byte order (a raw copy of the arrays).
+    // deserialize rejects images whose nodes would send a query out of bounds.
+    void serialize(std::vector<uint8_t>& out) const;
+    bool deserialize(const uint8_t* data, size_t size);
+
+private:
+    std::vector<BVHNode> nodes;
+    std::vector<BVHTriangle> tris;
+    std::vector<uint32_t> triMeshes;
+    uint32_t meshTotal = 0;
+    BVHBuildStats buildStats;
+};
+
+#endif
@@ -7,6 +7,10 @@
 const unsigned int SCR_WIDTH = 1920;
 const unsigned int SCR_HEIGHT = 1080;
 
+// Resolution the deferred path renders the scene at before upscaling to the window
+const int PS1_INTERNAL_WIDTH = 320;
+const int PS1_INTERNAL_HEIGHT = 240;
+
 // Movement constants
 const float STEP_COOLDOWN = 0.6f;
 const float BOB_AMOUNT = 0.05f;
@@ -55,6 +59,28 @@ const float MATERIAL_ALPHA = 1.0f;
 const float FOG_NEAR = 4.0f;
 const float FOG_FAR = 7.0f;
 const glm::vec3 FOG_COLOR = glm::vec3(0.02f, 0.02f, 0.04f);
+// Steps the fog factor is quantized to. The last step is pure FOG_COLOR, so
+// nothing past FOG_FAR - (FOG_FAR - FOG_NEAR) / FOG_LEVELS can be seen; the
+// renderer pulls its far plane in to that distance and culls what lies beyond.
+// Unfogged and emissive draws (light beam, bonfire) must stay inside it.
+const int FOG_LEVELS = 8;
+
+// Shader features; disabled ones are compiled out of every variant
+const bool ENABLE_FOG = true;
+const bool ENABLE_QUANTIZATION = true; // PS1 color quantization and dithering
+
+// Depth-only pass before the opaque level draws, so levelFs runs once per pixel.
+// Toggled at runtime with F3; RenderQueue::overdraw() reports what it saves.
+const bool DEPTH_PREPASS_DEFAULT = true;
+
+// Size of the occluder depth target the Hi-Z pyramid is built from. Coarse is
+// enough: a mesh is only culled when a whole pyramid texel in front of it is covered.
+const int OCCLUSION_HIZ_WIDTH = 160;
+const int OCCLUSION_HIZ_HEIGHT = 120;
+
+// On GL 4.3 contexts the level is culled by a compute pass and drawn with
+// multi-draw indirect instead of through the render queue. Toggled with F5.
+const bool GPU_DRIVEN_DEFAULT = true;
 
 // Torch/Emissive lighting
 const glm::vec3 TORCH_DIR_AMBIENT = glm::vec3(0.01f, 0.005f, 0.002f);
@@ -62,12 +88,22 @@ const glm::vec3 TORCH_DIR_DIFFUSE = glm::vec3(0.1f, 0.08f, 0.05f);
 const float TORCH_SHININESS = 2.0f;
 const float TORCH_EMISSIVE_STRENGTH = 1.5f;
 
+// Light beam self-illumination
+const glm::vec3 BEAM_LIGHT_DIRECTION = glm::vec3(0.0f, -1.0f, 0.0f);
+const glm::vec3 BEAM_LIGHT_COLOR = glm::vec3(2.5f, 2.5f, 2.0f);
+
 // Camera constants
 const float CAMERA_HEIGHT = 1.0f;
-const float BOUNDARY_LIMIT = 2.8f;
+const float BOUNDARY_LIMIT = 2.8f; // only for levels without sectors; see sectorGraph.h
+const float PLAYER_RADIUS = 0.25f;  // closest the camera gets to a wall of a level with sectors
+const float WALL_MAX_NORMAL_Y = 0.7f; // steeper triangles block movement; flatter ones are floor or ceiling
 const float PITCH_CONSTRAINT_MAX = 89.0f;
 const float PITCH_CONSTRAINT_MIN = -89.0f;
 const float ZOOM_MIN = 1.0f;
 const float ZOOM_MAX = 45.0f;
 
+// Asset caches, relative to the working directory
+const char* const MESH_CACHE_DIRECTORY = "cache/meshes";
+const char* const SHADER_CACHE_DIRECTORY = "cache/shaders";
+
 #endif
\ No newline at end of file
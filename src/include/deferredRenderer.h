@@ -0,0 +1,73 @@
+#ifndef DEFERRED_RENDERER_H
+#define DEFERRED_RENDERER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <shader.h>
+#include <lightClusters.h>
+
+// Texture units the light and resolve passes read the G-buffer from.
+const GLint GBUFFER_ALBEDO_TEXTURE_UNIT = 0;
+const GLint GBUFFER_NORMAL_TEXTURE_UNIT = 1;
+const GLint GBUFFER_DEPTH_TEXTURE_UNIT = 2;
+const GLint LIGHT_ACCUMULATION_TEXTURE_UNIT = 3;
+
+// Deferred shading at the PS1 internal resolution. The scene's opaque
+// geometry is written once to a G-buffer:
+//   albedo (RGBA8), normal (RGB10_A2, packed to [0, 1]), depth (DEPTH24)
+// Every visible point light is then drawn as an instanced sphere that adds its
+// contribution to a RGBA16F accumulation target, so a pixel pays for the
+// lights that reach it once, however often it was overdrawn. The resolve
+// pass upscales to the window with nearest filtering, adds the directional
+// light, applies quantization, fog and dithering, and writes the G-buffer
+// depth so forward passes drawn afterwards are still depth tested.
+class DeferredRenderer {
+public:
+    DeferredRenderer(int width, int height);
+    ~DeferredRenderer();
+    DeferredRenderer(const DeferredRenderer&) = delete;
+    DeferredRenderer& operator=(const DeferredRenderer&) = delete;
+
+    bool isComplete() const { return complete; }
+
+    // binds and clears the G-buffer; draw the geometry pass after this
+    void beginGeometry();
+    // accumulates the visible lights of clusters, then resolves into the default framebuffer
+    void lightAndResolve(const LightClusters& clusters, const glm::mat4& view, const glm::mat4& projection,
+                         float farPlane, const GLint viewport[4]);
+
+private:
+    int width;
+    int height;
+    bool complete = false;
+
+    GLuint gBuffer = 0;
+    GLuint lightBuffer = 0;
+    GLuint albedoTexture = 0;
+    GLuint normalTexture = 0;
+    GLuint depthTexture = 0;
+    GLuint lightTexture = 0;
+    GLuint lightDepth = 0;    // copy of the G-buffer depth the light pass tests against
+
+    GLuint sphereVAO = 0;
+    GLuint sphereVBO = 0;
+    GLuint sphereEBO = 0;
+    GLsizei sphereIndexCount = 0;
+    float sphereScale = 1.0f; // grows the tessellated sphere to enclose the true one
+    GLuint emptyVAO = 0;      // the resolve triangle is generated from gl_VertexID
+
+    Shader* lightVolumeShader = nullptr;
+    Shader* resolveShader = nullptr;
+    // per-frame uniforms, resolved once
+    UniformHandle volumeInverseViewProjection;
+    UniformHandle volumeMaxRange;
+    UniformHandle resolveInverseViewProjection;
+    UniformHandle resolveViewportSize;
+
+    void createTargets();
+    void createSphere(int rings, int segments);
+    static GLuint createTexture(GLenum internalFormat, GLenum format, GLenum type, int width, int height);
+};
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef FRAME_CONSTANTS_H
+#define FRAME_CONSTANTS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+// Uniform buffer binding point of the FrameConstants block in every scene shader.
+const GLuint FRAME_CONSTANTS_BINDING = 0;
+
+// C++ mirrors of the std140 FrameConstants block generated in shaderVariants.cpp.
+// vec3 members are 16-byte aligned in std140, so explicit padding keeps the
+// offsets identical to the GLSL side; the static_asserts below guard them.
+struct GPUDirLight {
+    glm::vec3 direction;
+    float pad0;
+    glm::vec3 ambient;
+    float pad1;
+    glm::vec3 diffuse;
+    float pad2;
+    glm::vec3 specular;
+    float pad3;
+};
+
+struct FrameConstants {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec3 viewPos;
+    float time;
+    GPUDirLight dirLight;
+    glm::vec3 fogColor;
+    float fogNear;
+    float fogFar;
+    float pad[3];
+    glm::vec4 clusterParams; // see LightClusters::shaderParams
+};
+
+static_assert(sizeof(GPUDirLight) == 64, "DirLight must match std140 layout");
+static_assert(offsetof(FrameConstants, viewPos) == 128, "FrameConstants must match std140 layout");
+static_assert(offsetof(FrameConstants, dirLight) == 144, "FrameConstants must match std140 layout");
+static_assert(offsetof(FrameConstants, fogColor) == 208, "FrameConstants must match std140 layout");
+static_assert(offsetof(FrameConstants, clusterParams) == 240, "FrameConstants must match std140 layout");
+static_assert(sizeof(FrameConstants) % 16 == 0, "FrameConstants must be padded to a vec4 multiple");
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef FRUSTUM_CULLER_H
+#define FRUSTUM_CULLER_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Counters for the last cull.
+struct CullStats {
+    unsigned int tested = 0;  // bounds handed to add()
+    unsigned int visible = 0; // bounds touching the frustum
+    unsigned int culled = 0;  // bounds entirely outside one of the planes
+};
+
+// Left, right, bottom, top, near and far plane of a view-projection matrix:
+// xyz the inward unit normal, w the distance.
+void extractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]);
+
+// View frustum culling of world-space bounds. Each frame the bounds of every
+// candidate draw are appended to structure-of-arrays storage, then tested in
+// one pass against the six planes of the view-projection matrix, four at a
+// time with SSE. A draw survives unless its box or its bounding sphere lies
+// entirely behind some plane; box and sphere share a center, so each plane
+// costs one distance and one compare against the smaller of the two radii.
+class FrustumCuller {
+public:
+    void begin(const glm::mat4& viewProjection);
+    // bounds of one draw: box center, box half extents and enclosing sphere radius; returns its index
+    uint32_t add(const glm::vec3& center, const glm::vec3& halfExtent, float radius);
+    void cull();
+
+    bool visible(uint32_t index) const { return visibility[index] != 0; }
+    const CullStats& stats() const { return lastStats; }
+
+private:
+    glm::vec4 planes[6]; // xyz inward normal, w distance; normalized
+
+    // padded to a multiple of 4 for SIMD
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+    std::vector<float> radius;
+    std::vector<uint8_t> visibility;
+    size_t count = 0;
+
+    CullStats lastStats;
+};
+
+#endif
@@ -13,6 +13,7 @@
 #include "renderer.h"
 #include "GUI.h"
 #include "interactionSystem.h"
+#include "textureLoader.h"
 
 class GameEngine {
 private:
@@ -20,6 +21,7 @@ private:
     GameState gameState;
     InputHandler* inputHandler;
     Renderer* renderer;
+    TextureLoader* textureLoader;
     AudioManager* audioManager;
     GUI* gui;
     
@@ -3,11 +3,25 @@
 
 #include <glm/glm.hpp>
 #include <camera.h>
+#include <functional>
 #include <string>
 #include <GLFW/glfw3.h>
 #include "interactionSystem.h"
 #include "inventory.h"
 
+// How the renderer shades the scene; switchable at runtime to compare both on the same frame.
+enum class RenderPath {
+    Forward,  // clustered forward shading at window resolution
+    Deferred  // G-buffer at the PS1 internal resolution plus light volumes
+};
+
+// How draws hidden behind the level are rejected; see occlusionCuller.h.
+enum class OcclusionMode {
+    Off,
+    HiZ,              // bounds tested against a depth pyramid of the level, read back a few frames later
+    ConditionalRender // per-batch box queries gate the real draws on the GPU, nothing read back
+};
+
 class GameState {
 public:
     // Camera
@@ -24,6 +38,10 @@ public:
     bool awaitingRelock;
     bool eKeyPressed;
     bool tabKeyPressed;
+    bool renderPathKeyPressed;
+    bool depthPrepassKeyPressed;
+    bool occlusionKeyPressed;
+    bool gpuDrivenKeyPressed;
     
     // Movement and effects
     glm::vec3 lastCameraPos;
@@ -46,6 +64,17 @@ public:
     bool showItemDescription = false;
     std::string selectedItemDescription = "";
 
+    // Rendering
+    RenderPath renderPath = RenderPath::Forward;
+    bool depthPrepass;
+
+    // Where the player may stand; unset means the square of BOUNDARY_LIMIT
+    std::function<bool(const glm::vec3&)> walkable;
+    // Hi-Z is opt-in: its verdicts arrive a few frames late, so objects can pop in when turning
+    OcclusionMode occlusionMode = OcclusionMode::Off;
+    // GPU-culled multi-draw of the level; only takes effect where IndirectScene::supported()
+    bool gpuDriven;
+
     // New: sword/bonfire state exposed to other systems
     bool hasBrokenSword = false;
     std::string swordType;
@@ -0,0 +1,34 @@
+#ifndef GL_CAPS_H
+#define GL_CAPS_H
+
+#include <glad/glad.h>
+
+#include <string>
+
+// What the current context supports, queried once after GLAD is loaded.
+// Optional paths check these flags instead of assuming the 3.3 core baseline.
+struct GLCaps {
+    int major = 0;
+    int minor = 0;
+    std::string vendor;
+    std::string renderer;
+    std::string version;
+    std::string glslVersion;
+
+    bool programBinary = false;       // glGetProgramBinary / glProgramBinary (4.1, ARB_get_program_binary)
+    GLint programBinaryFormats = 0;   // 0 means the driver cannot actually save binaries
+    bool parallelShaderCompile = false; // KHR/ARB_parallel_shader_compile: compiler threads, completion polling
+    bool bufferStorage = false;       // glBufferStorage, persistent mapping (4.4, ARB_buffer_storage)
+    bool textureBufferRange = false;  // glTexBufferRange (4.3, ARB_texture_buffer_range)
+
+    bool atLeast(int wantMajor, int wantMinor) const {
+        return major > wantMajor || (major == wantMajor && minor >= wantMinor);
+    }
+};
+
+// Fills the capabilities from the current context and applies context-wide
+// settings that depend on them; call after gladLoadGLLoader.
+void initializeGLCaps();
+const GLCaps& glCaps();
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// Kinds of state calls the cache filters, for the per-frame counters.
+enum class GLStateCall : uint8_t {
+    Program = 0,
+    VertexArray,
+    ActiveTexture,
+    BindTexture,
+    Capability, // glEnable / glDisable
+    BlendFunc,
+    DepthMask,
+    DepthFunc,
+    CullFace,
+    ColorMask,
+    Count
+};
+
+const size_t GL_STATE_CALL_KINDS = static_cast<size_t>(GLStateCall::Count);
+
+const char* glStateCallName(GLStateCall call);
+
+// Calls of one frame: issued reached the driver, elided matched the cached
+// value and were dropped.
+struct GLStateStats {
+    unsigned int issued[GL_STATE_CALL_KINDS] = {};
+    unsigned int elided[GL_STATE_CALL_KINDS] = {};
+    unsigned int invalidations = 0;
+
+    unsigned int totalIssued() const;
+    unsigned int totalElided() const;
+};
+
+// Shadow copy of the bind and fixed-function state the frame touches: the
+// program, the VAO, the 2D and buffer textures of the first units with the
+// active unit, blend, depth, cull and color mask. Setters only reach GL when
+// the value differs from the cached one.
+//
+// The cache only knows what went through it. Code that changes this state
+// behind its back (texture uploads, ImGui) must be followed by invalidate(),
+// after which every value is unknown and the next call of each kind is issued.
+// beginFrame() invalidates too, so loading code between frames needs no care.
+class GLStateCache {
+public:
+    GLStateCache() { invalidate(); }
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vertexArray);
+    // unit is an index (0 for GL_TEXTURE0); the active unit only changes when a bind needs it
+    void bindTexture(GLuint unit, GLenum target, GLuint texture);
+    // makes a unit active, for calls that act on the bound texture (glTexParameter)
+    void activeTexture(GLuint unit);
+    // GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE and GL_DEPTH_CLAMP are cached; others are always issued
+    void setCapability(GLenum capability, bool enabled);
+    void blendFunc(GLenum source, GLenum destination);
+    void depthMask(bool enabled);
+    void depthFunc(GLenum function);
+    void cullFace(GLenum face);
+    void colorMask(bool enabled);
+
+    void invalidate();
+    // closes the counters of the previous frame and invalidates
+    void beginFrame();
+    // counters of the last complete frame
+    const GLStateStats& stats() const { return lastFrame; }
+
+private:
+    static const GLuint TRACKED_UNITS = 16;
+    static const int TRACKED_CAPABILITIES = 4;
+
+    // UNKNOWN never matches a real value, so the next call goes through
+    static const GLuint UNKNOWN = 0xFFFFFFFFu;
+
+    GLuint program;
+    GLuint vertexArray;
+    GLuint activeUnit;
+    GLuint textures2D[TRACKED_UNITS];
+    GLuint textureBuffers[TRACKED_UNITS];
+    GLuint capabilities[TRACKED_CAPABILITIES];
+    GLuint blendSource;
+    GLuint blendDestination;
+    GLuint depthWrites;
+    GLuint depthFunction;
+    GLuint cullFaceMode;
+    GLuint colorWrites;
+
+    GLStateStats frame;
+    GLStateStats lastFrame;
+
+    // true if the call must be issued; updates the cached value and the counters
+    bool change(GLStateCall call, GLuint& cached, GLuint value);
+};
+
+// The cache of the one GL context the game renders with.
+GLStateCache& glState();
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef INDIRECT_SCENE_H
+#define INDIRECT_SCENE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <shader.h>
+#include <model.h>
+#include <meshPool.h>
+#include <material.h>
+
+// Counters of the last drawn frame. Visibility stays on the GPU, so there is
+// no culled count; multiDraws is what the CPU paid for.
+struct IndirectSceneStats {
+    unsigned int objects = 0;    // commands in the buffer, one per static mesh
+    unsigned int multiDraws = 0; // glMultiDrawElementsIndirect calls
+};
+
+// GPU-driven drawing of static geometry on GL 4.3 contexts. Every mesh gets
+// one indirect command, its instance data and its world bounds, all uploaded
+// once. Each frame a compute pass tests the bounds against the frustum and
+// sets the command's instance count to one or zero, and the commands are
+// issued without reading anything back. Commands are ordered so that those
+// sharing a material, vertex format and index type are adjacent; each such
+// run is one glMultiDrawElementsIndirect, so the CPU cost depends on the
+// number of materials, not on the number of meshes.
+//
+// Only construct it when supported() is true; the GL 3.3 path is the render queue.
+class IndirectScene {
+public:
+    IndirectScene();
+    ~IndirectScene();
+    IndirectScene(const IndirectScene&) = delete;
+    IndirectScene& operator=(const IndirectScene&) = delete;
+
+    // compute shaders, shader storage buffers and multi-draw indirect
+    static bool supported();
+
+    // adds every mesh of a static model; call before the first cull()
+    void add(const Model& model, const glm::mat4& transform);
+    bool empty() const { return objects.empty(); }
+
+    // culls against viewProjection; meshVisibility (optional, indexed like the
+    // model's meshes, only valid with a single model) removes meshes the CPU already rejected
+    void cull(const glm::mat4& viewProjection, const std::vector<uint8_t>* meshVisibility = nullptr);
+    // draws the commands cull() left visible with program, as opaque geometry
+    void draw(const MeshPool& meshPool, const Shader& program);
+
+    const IndirectSceneStats& stats() const { return lastStats; }
+
+private:
+    // Layout of glMultiDrawElementsIndirect commands.
+    struct DrawCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    // Layout of Bounds in frustumCullCs.glsl (std430: the uint fills the vec3's padding).
+    struct GpuBounds {
+        glm::vec4 centerRadius; // box center, sphere radius
+        glm::vec3 halfExtent;
+        uint32_t meshIndex;     // position in its model, for the visibility mask
+    };
+    static_assert(sizeof(GpuBounds) == 32, "GpuBounds must match the std430 Bounds struct");
+
+    struct Object {
+        const Mesh* mesh;
+        uint32_t meshIndex; // position in its model, for the visibility mask
+        glm::mat4 transform;
+        glm::vec3 center;
+        glm::vec3 halfExtent;
+        float radius;
+    };
+
+    // adjacent commands drawn by one call
+    struct Run {
+        const Material* material;
+        VertexFormat format;
+        GLenum indexType;
+        uint32_t firstCommand;
+        uint32_t commandCount;
+    };
+
+    std::vector<Object> objects;
+    std::vector<Run> runs;
+    bool uploaded = false;
+
+    GLuint commandBuffer = 0;  // indirect commands, written by the cull pass
+    GLuint boundsBuffer = 0;   // GpuBounds per command
+    GLuint instanceBuffer = 0; // InstanceData per command, fetched through baseInstance
+    GLuint maskBuffer = 0;     // one byte per mesh index
+    size_t maskCapacity = 0;
+
+    Shader* cullProgram = nullptr;
+    UniformHandle planesUniform;
+    UniformHandle objectCountUniform;
+    UniformHandle useMaskUniform;
+
+    IndirectSceneStats lastStats;
+
+    void upload();
+};
+
+#endif
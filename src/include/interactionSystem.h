@@ -33,6 +33,10 @@ public:
     // Optional helpers
     void ClearInteractables();
 
+    // Objects whose position fails the test are ignored, e.g. ones in rooms out of view
+    void SetReachableTest(std::function<bool(const glm::vec3&)> test);
+
 private:
     std::vector<InteractableObject> interactables;
+    std::function<bool(const glm::vec3&)> reachable;
 };
\ No newline at end of file
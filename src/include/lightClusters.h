@@ -0,0 +1,121 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include <streamBuffer.h>
+
+// Froxel grid: screen tiles by exponential depth slices between the near and far planes.
+const int LIGHT_CLUSTER_X = 16;
+const int LIGHT_CLUSTER_Y = 9;
+const int LIGHT_CLUSTER_Z = 24;
+const int LIGHT_CLUSTER_COUNT = LIGHT_CLUSTER_X * LIGHT_CLUSTER_Y * LIGHT_CLUSTER_Z;
+
+// RGBA32F texels per light in the light data buffer:
+//   position.xyz, constant | ambient.rgb, linear | diffuse.rgb, quadratic | specular.rgb, range
+const int LIGHT_DATA_TEXELS = 4;
+
+// Texture units of the cluster buffers, above the ones materials use.
+const GLint LIGHT_CLUSTER_TEXTURE_UNIT = 13;
+const GLint LIGHT_INDEX_TEXTURE_UNIT = 14;
+const GLint LIGHT_DATA_TEXTURE_UNIT = 15;
+
+// Steps the scene shaders quantize point light attenuation to. A light adds
+// nothing where its attenuation rounds down to zero, which bounds its range.
+const int LIGHT_ATTENUATION_LEVELS = 12;
+
+// A point light as the renderer sees it for one frame.
+struct ScenePointLight {
+    glm::vec3 position;
+    float constant;
+    float linear;
+    float quadratic;
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+
+    bool hasColor() const {
+        return ambient != glm::vec3(0.0f) || diffuse != glm::vec3(0.0f) || specular != glm::vec3(0.0f);
+    }
+};
+
+// Distance past which the quantized attenuation of a light is zero (infinity if it never falls off).
+float pointLightRange(const ScenePointLight& light);
+
+// Counters for the last build.
+struct LightClusterStats {
+    unsigned int lights = 0;           // lights handed to build()
+    unsigned int droppedLights = 0;    // lights beyond what the buffers can index
+    unsigned int visibleLights = 0;    // lights overlapping the view frustum
+    unsigned int lightIndices = 0;     // cluster -> light references uploaded
+    unsigned int maxClusterLights = 0; // longest list of any cluster
+    unsigned int droppedIndices = 0;   // references beyond the buffer texture limit
+};
+
+// Clustered forward lighting. Every frame the lights are binned into a
+// view-space froxel grid on the CPU and the result is uploaded as three
+// buffer textures:
+//   lightClusters (RG32UI): first index and count per cluster
+//   lightIndices  (R16UI):  light indices, grouped by cluster
+//   lightData     (RGBA32F): LIGHT_DATA_TEXELS texels per light
+// The fragment shaders look up their cluster and loop over its list only, so
+// shading cost follows the local light density instead of the total count.
+class LightClusters {
+public:
+    LightClusters() = default;
+    ~LightClusters();
+    LightClusters(const LightClusters&) = delete;
+    LightClusters& operator=(const LightClusters&) = delete;
+
+    // projection must be a symmetric perspective projection with the given planes
+    void build(const std::vector<ScenePointLight>& lights, const glm::mat4& view, const glm::mat4& projection,
+               float nearPlane, float farPlane, const glm::ivec2& viewportSize);
+    // binds the buffers to the LIGHT_*_TEXTURE_UNIT units
+    void bind() const;
+    // fences this frame's regions; call once every draw reading the lists is issued
+    void endFrame();
+
+    // FrameConstants::clusterParams: xy = clusters per pixel, z = slices per log depth, w = slice bias
+    const glm::vec4& shaderParams() const { return params; }
+    const LightClusterStats& stats() const { return lastStats; }
+
+private:
+    // Conservative cluster range of one light; empty if first > last on any axis.
+    struct ClusterRange {
+        int x0, x1, y0, y1, z0, z1;
+    };
+
+    struct BufferTexture {
+        StreamBuffer stream{ GL_TEXTURE_BUFFER };
+        GLuint texture = 0;
+        GLuint attached = 0; // buffer the texture was last pointed at
+    };
+
+    BufferTexture clusterBuffer;
+    BufferTexture indexBuffer;
+    BufferTexture dataBuffer;
+    GLint maxTexels = 0;
+    GLint offsetAlignment = 0; // GL_TEXTURE_BUFFER_OFFSET_ALIGNMENT where ranges are used
+
+    // structure-of-arrays copies of the light spheres, padded to a multiple of 4 for SIMD
+    std::vector<float> centerX, centerY, centerZ, radius;
+    std::vector<ClusterRange> ranges;
+    std::vector<uint16_t> compactIds;   // light index -> position in lightData
+    std::vector<uint32_t> clusterCounts;
+    std::vector<uint32_t> clusterTable; // offset, count per cluster
+    std::vector<uint16_t> indices;
+    std::vector<glm::vec4> lightData;
+
+    glm::vec4 params = glm::vec4(0.0f);
+    LightClusterStats lastStats;
+
+    void computeRanges(const glm::mat4& view, const glm::mat4& projection, float nearPlane, float farPlane,
+                       size_t count);
+    void upload(BufferTexture& target, GLenum format, const void* data, size_t bytes);
+};
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Uniform buffer binding point of the MaterialParams block in every scene shader.
+const GLuint MATERIAL_PARAMS_BINDING = 1;
+
+// Maps of a material. Each has a fixed texture unit (MATERIAL_TEXTURE_UNIT_BASE
+// + slot); the samplers are pointed at them once when the programs are configured.
+enum MaterialTextureSlot : uint32_t {
+    MATERIAL_TEXTURE_DIFFUSE = 0,
+    MATERIAL_TEXTURE_SPECULAR = 1,
+    MATERIAL_TEXTURE_NORMAL = 2,
+    MATERIAL_TEXTURE_HEIGHT = 3,
+    MATERIAL_TEXTURE_SLOTS = 4
+};
+
+const GLint MATERIAL_TEXTURE_UNIT_BASE = 0;
+
+// Slot of an imported texture type ("texture_diffuse", ...); MATERIAL_TEXTURE_SLOTS if unknown.
+MaterialTextureSlot materialTextureSlot(const std::string& type);
+
+// C++ mirror of the std140 MaterialParams block generated in shaderVariants.cpp.
+struct MaterialParams {
+    glm::vec4 diffuseColor = glm::vec4(1.0f); // multiplies the diffuse map; Kd of materials without one
+    float shininess = 32.0f;
+    float alpha = 1.0f;
+    float emissiveStrength = 0.0f;
+    float pad = 0.0f;
+};
+
+static_assert(sizeof(MaterialParams) == 32, "MaterialParams must match std140 layout");
+
+// A surface resolved at import: texture names per slot and a range of the
+// parameter buffer. Binding it is a few integer binds.
+struct Material {
+    uint16_t id = 0; // dense and stable for the run; the material field of the sort keys
+    GLuint textures[MATERIAL_TEXTURE_SLOTS] = {}; // 0 where the material has no map
+    MaterialParams params;
+    GLuint paramsBuffer = 0;
+    GLintptr paramsOffset = 0;
+
+    // binds the maps to their units and the parameters to MATERIAL_PARAMS_BINDING
+    void bind() const;
+};
+
+// Owns every material and the uniform buffer holding their parameters, one
+// aligned range each. Materials with the same maps and parameters are shared,
+// so draws of identical surfaces sort and batch together across models.
+class MaterialLibrary {
+public:
+    MaterialLibrary() = default;
+    ~MaterialLibrary();
+    MaterialLibrary(const MaterialLibrary&) = delete;
+    MaterialLibrary& operator=(const MaterialLibrary&) = delete;
+
+    // textures: GL names per slot, 0 for missing maps; a missing diffuse map
+    // becomes a white texture, so diffuseColor shows through
+    const Material* acquire(const GLuint textures[MATERIAL_TEXTURE_SLOTS], const MaterialParams& params);
+
+    size_t size() const { return materials.size(); }
+
+private:
+    std::vector<std::unique_ptr<Material>> materials;
+    GLuint buffer = 0;
+    size_t stride = 0;   // sizeof(MaterialParams) rounded up to the UBO offset alignment
+    size_t capacity = 0; // materials the buffer has room for
+    GLuint whiteTexture = 0;
+
+    void createResources();
+    void grow();
+};
+
+#endif
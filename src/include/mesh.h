@@ -7,42 +7,47 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <shader.h>
+#include <material.h>
+#include <meshPool.h>
+#include <vertexFormat.h>
 
+#include <cmath>
+#include <cstring>
 #include <string>
 #include <vector>
 
-#define MAX_BONE_INFLUENCE 4
-
-struct Vertex {
-    // position
-    glm::vec3 Position;
-    // normal
-    glm::vec3 Normal;
-    // texCoords
-    glm::vec2 TexCoords;
-    // tangent
-    glm::vec3 Tangent;
-    // bitangent
-    glm::vec3 Bitangent;
-	//bone indexes which will influence this vertex
-	int m_BoneIDs[MAX_BONE_INFLUENCE];
-	//weights from each bone
-	float m_Weights[MAX_BONE_INFLUENCE];
-};
-
 struct Texture {
     unsigned int id;
     std::string type;
     std::string path;
 };
 
+// GPU-ready geometry produced by Mesh::encode, in the layout the pool stores
+struct EncodedGeometry {
+    VertexFormat format = VertexFormat::Standard;
+    std::vector<uint8_t> vertices;
+    size_t vertexCount = 0;
+    std::vector<uint8_t> indices;
+    GLenum indexType = GL_UNSIGNED_INT;
+    size_t indexCount = 0;
+};
+
 class Mesh {
 public:
-    // mesh Data
+    // mesh Data, CPU side; released once uploaded to the pool
     std::vector<Vertex>       vertices;
     std::vector<unsigned int> indices;
-    std::vector<Texture>      textures;
-    unsigned int VAO;
+    std::vector<Texture>      textures; // imported references, kept to rebuild the material from the mesh cache
+    const Material* material = nullptr; // resolved textures and parameters, owned by the MaterialLibrary
+    MeshAllocation geometry; // where the mesh lives in the MeshPool
+    unsigned int id; // unique per mesh, used to group instances
+    glm::vec3 boundsMin, boundsMax; // model-space bounds
+    float boundsRadius = 0.0f;      // sphere around boundsCenter() enclosing every vertex; at most half the box diagonal
+    glm::mat4 positionDecode = glm::mat4(1.0f); // maps stored positions to model space, see VertexFormat::Packed
+
+    // per-instance attributes (model matrix columns + parameters), fed by RenderQueue
+    static const unsigned int INSTANCE_MODEL_LOCATION = 7;
+    static const unsigned int INSTANCE_PARAMS_LOCATION = 11;
 
     // constructor
     Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures)
@@ -50,96 +55,125 @@ public:
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
+        this->id = nextMeshId()++;
+        computeBounds();
+    }
 
-        // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+    // constructor for geometry that is already encoded (e.g. read from the mesh
+    // cache); call upload with the encoded data afterwards
+    Mesh(std::vector<Texture> textures, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+         float boundsRadius, const glm::mat4 &positionDecode)
+    {
+        this->textures = textures;
+        this->boundsMin = boundsMin;
+        this->boundsMax = boundsMax;
+        this->boundsRadius = boundsRadius;
+        this->positionDecode = positionDecode;
+        this->id = nextMeshId()++;
     }
 
-    // render the mesh
-    void Draw(Shader &shader) 
+    // encodes the geometry in the smallest format the shader can read and frees the CPU-side copies
+    EncodedGeometry encode(uint32_t shaderAttributeMask)
     {
-        // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
+        EncodedGeometry encoded;
+        encoded.format = chooseVertexFormat(shaderAttributeMask, vertices);
+        encoded.vertices = encodeVertices(vertices, encoded.format, boundsMin, boundsMax, positionDecode);
+        encoded.vertexCount = vertices.size();
+        encoded.indexCount = indices.size();
+
+        // 16-bit indices whenever the mesh is small enough to address with them
+        if (vertices.size() <= 0xFFFF)
+        {
+            std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+            encoded.indexType = GL_UNSIGNED_SHORT;
+            encoded.indices.resize(shortIndices.size() * sizeof(uint16_t));
+            if (!shortIndices.empty())
+                memcpy(encoded.indices.data(), shortIndices.data(), encoded.indices.size());
+        }
+        else
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            std::string number;
-            std::string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to string
-            else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to string
-             else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to string
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            encoded.indexType = GL_UNSIGNED_INT;
+            encoded.indices.resize(indices.size() * sizeof(uint32_t));
+            memcpy(encoded.indices.data(), indices.data(), encoded.indices.size());
         }
-        
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+
+        std::vector<Vertex>().swap(vertices);
+        std::vector<unsigned int>().swap(indices);
+        return encoded;
+    }
+
+    // copies encoded geometry into the shared pool
+    void upload(MeshPool &pool, VertexFormat format, const void *vertexData, size_t vertexCount,
+                const void *indexData, GLenum indexType, size_t indexCount)
+    {
+        geometry = pool.allocate(format, vertexData, vertexCount, indexData, indexType, indexCount);
+        this->vertexCount = vertexCount;
+    }
+
+    void upload(MeshPool &pool, const EncodedGeometry &encoded)
+    {
+        upload(pool, encoded.format, encoded.vertices.data(), encoded.vertexCount,
+               encoded.indices.data(), encoded.indexType, encoded.indexCount);
+    }
+
+    // bytes the mesh occupies in the pool
+    size_t gpuBytes() const
+    {
+        size_t indexSize = geometry.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+        return vertexCount * vertexFormatStride(geometry.format) + geometry.indexCount * indexSize;
+    }
+
+    // draws instanceCount copies with whatever program and textures are bound; expects the pool VAO of its format bound
+    void drawInstanced(unsigned int instanceCount) const
+    {
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, geometry.indexCount, geometry.indexType,
+                                          (void*)geometry.indexOffset, static_cast<GLsizei>(instanceCount),
+                                          geometry.baseVertex);
+    }
+
+    // center of the bounds in model space
+    glm::vec3 boundsCenter() const
+    {
+        return (boundsMin + boundsMax) * 0.5f;
+    }
+
+    // identifies the material for sorting; meshes sharing a material compare equal
+    unsigned int materialKey() const
+    {
+        return material ? material->id : 0;
     }
 
 private:
-    // render data 
-    unsigned int VBO, EBO;
+    size_t vertexCount = 0;
+
+    void computeBounds()
+    {
+        boundsMin = glm::vec3(0.0f);
+        boundsMax = glm::vec3(0.0f);
+        boundsRadius = 0.0f;
+        if (vertices.empty())
+            return;
+        boundsMin = boundsMax = vertices[0].Position;
+        for (const Vertex &v : vertices)
+        {
+            boundsMin = glm::min(boundsMin, v.Position);
+            boundsMax = glm::max(boundsMax, v.Position);
+        }
+        // sharing the box center lets the culler test box and sphere with one plane distance
+        glm::vec3 center = boundsCenter();
+        float radiusSquared = 0.0f;
+        for (const Vertex &v : vertices)
+        {
+            glm::vec3 offset = v.Position - center;
+            radiusSquared = glm::max(radiusSquared, glm::dot(offset, offset));
+        }
+        boundsRadius = std::sqrt(radiusSquared);
+    }
 
-    // initializes all the buffer objects/arrays
-    void setupMesh()
+    static unsigned int& nextMeshId()
     {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
-        // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);  
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);	
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);	
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);	
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-		// ids
-		glEnableVertexAttribArray(5);
-		glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, m_BoneIDs));
-
-		// weights
-		glEnableVertexAttribArray(6);
-		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
-        glBindVertexArray(0);
+        static unsigned int counter = 0;
+        return counter;
     }
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,102 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <material.h>
+#include <vertexFormat.h>
+
+// Bump whenever the file layout, the vertex encoding or the optimization pass changes.
+const uint32_t MESH_CACHE_VERSION = 5;
+
+// Read-only memory mapping of a whole file.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    const uint8_t* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const uint8_t* bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#else
+    int descriptor = -1;
+#endif
+};
+
+struct MeshCacheTexture {
+    std::string type;
+    std::string path;
+};
+
+// One mesh as stored in the cache: encoded GPU-ready geometry plus what is
+// needed to rebuild the Mesh without Assimp. When read back, vertexData and
+// indexData point into the mapping.
+struct MeshCacheEntry {
+    VertexFormat format = VertexFormat::Standard;
+    GLenum indexType = GL_UNSIGNED_INT;
+    const void* vertexData = nullptr;
+    size_t vertexCount = 0;
+    const void* indexData = nullptr;
+    size_t indexCount = 0;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
+    glm::mat4 positionDecode = glm::mat4(1.0f);
+    std::vector<MeshCacheTexture> textures;
+    MaterialParams material;
+};
+
+// Hashes a model file together with the material libraries it references, so
+// editing either invalidates the cache.
+uint64_t hashModelSources(const std::string& modelPath);
+
+// Where the cache of a model lives (under MESH_CACHE_DIRECTORY).
+std::string meshCachePath(const std::string& modelPath);
+
+// Writes the cache atomically (temporary file, then rename). bvhData and
+// sectorData are optional TriangleBVH and SectorGraph images stored after the geometry.
+bool writeMeshCache(const std::string& cachePath, uint64_t sourceHash, uint32_t attributeMask,
+                    const std::vector<MeshCacheEntry>& meshes, const std::vector<uint8_t>& bvhData,
+                    const std::vector<uint8_t>& sectorData);
+
+// Maps a cache and validates it against the current sources and shader
+// attributes. The entries stay valid while the reader is alive.
+class MeshCacheReader {
+public:
+    bool open(const std::string& cachePath, uint64_t sourceHash, uint32_t attributeMask);
+
+    const std::vector<MeshCacheEntry>& meshes() const { return entries; }
+    // the stored TriangleBVH image; empty if none was written
+    const uint8_t* bvhData() const { return bvh; }
+    size_t bvhSize() const { return bvhBytes; }
+    // the stored SectorGraph image; empty if the model has no sectors
+    const uint8_t* sectorData() const { return sectors; }
+    size_t sectorSize() const { return sectorBytes; }
+
+private:
+    MappedFile file;
+    std::vector<MeshCacheEntry> entries;
+    const uint8_t* bvh = nullptr;
+    size_t bvhBytes = 0;
+    const uint8_t* sectors = nullptr;
+    size_t sectorBytes = 0;
+};
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <cstddef>
+#include <vector>
+
+#include <vertexFormat.h>
+
+// FIFO size used to measure vertex reuse; close to the post-transform cache of current GPUs.
+const unsigned int MESH_OPTIMIZER_CACHE_SIZE = 16;
+
+// Before/after numbers of one optimization pass. ACMR is vertex shader
+// invocations per triangle (0.5 is ideal for a regular grid, 3 is no reuse);
+// ATVR is invocations per unique vertex (1 is ideal).
+struct MeshOptimizationStats {
+    size_t triangles = 0;
+    size_t verticesBefore = 0;
+    size_t verticesAfter = 0;
+    float acmrBefore = 0.0f;
+    float acmrAfter = 0.0f;
+    float atvrAfter = 0.0f;
+
+    MeshOptimizationStats& operator+=(const MeshOptimizationStats& other);
+};
+
+// Merges bitwise identical vertices and rewrites the indices to match.
+void weldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+// Reorders triangles for post-transform cache hits (Forsyth's linear-speed algorithm).
+void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount);
+
+// Groups the cache-ordered triangles into clusters and sorts the clusters so
+// outward-facing ones come first, cutting overdraw while keeping most of the
+// cache order. threshold is the ACMR increase a cluster split may cost (1.05 = 5%).
+void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, float threshold);
+
+// Renumbers vertices in the order the indices first reference them so vertex
+// fetch walks memory linearly. Unreferenced vertices are dropped.
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+// Simulates a FIFO post-transform cache and returns the average cache miss ratio.
+float computeACMR(const std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize);
+
+// Runs weld, cache, overdraw and fetch ordering in sequence. indices must be a
+// triangle list; the importer filters other primitive types out beforehand.
+MeshOptimizationStats optimizeMesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+#endif
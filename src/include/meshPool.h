@@ -0,0 +1,64 @@
+#ifndef MESH_POOL_H
+#define MESH_POOL_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <vertexFormat.h>
+
+// Where a mesh's geometry lives inside the pool. Drawn with
+// glDrawElements*BaseVertex against the VAO of its vertex format.
+struct MeshAllocation {
+    VertexFormat format = VertexFormat::Standard;
+    GLint baseVertex = 0;       // first vertex of the mesh in its format's vertex buffer
+    size_t indexOffset = 0;     // byte offset of the first index in the index buffer
+    GLsizei indexCount = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+
+    bool valid() const { return indexCount > 0; }
+};
+
+// Sub-allocates all static geometry from one large vertex buffer per vertex
+// format and one shared index buffer holding both 16- and 32-bit ranges. Each
+// format has a single VAO, so drawing a different mesh of the same format never
+// rebinds buffers or vertex layouts. Allocations are append-only; buffers grow
+// by copying on the GPU when they run out of room.
+class MeshPool {
+public:
+    MeshPool() = default;
+    ~MeshPool();
+    MeshPool(const MeshPool&) = delete;
+    MeshPool& operator=(const MeshPool&) = delete;
+
+    MeshAllocation allocate(VertexFormat format, const void* vertexData, size_t vertexCount,
+                            const void* indexData, GLenum indexType, size_t indexCount);
+
+    void bind(VertexFormat format) const;
+    GLuint vertexArray(VertexFormat format) const { return arenas[static_cast<size_t>(format)].vao; }
+
+    size_t vertexBytesUsed() const;
+    size_t indexBytesUsed() const { return indexBytes; }
+
+private:
+    struct VertexArena {
+        GLuint vao = 0;
+        GLuint vbo = 0;
+        size_t stride = 0;
+        size_t count = 0;
+        size_t capacity = 0;
+    };
+
+    VertexArena arenas[VERTEX_FORMAT_COUNT];
+    GLuint ebo = 0;
+    size_t indexBytes = 0;
+    size_t indexCapacity = 0;
+
+    void createArena(VertexFormat format);
+    void growVertices(VertexFormat format, size_t requiredVertices);
+    void growIndices(size_t requiredBytes);
+    void setupVertexArray(VertexFormat format);
+};
+
+#endif
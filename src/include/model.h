@@ -4,12 +4,19 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include <stb_image.h>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
 #include <mesh.h>
+#include <material.h>
+#include <meshPool.h>
+#include <meshOptimizer.h>
+#include <meshCache.h>
+#include <bvh.h>
+#include <sectorGraph.h>
+#include <staticBatcher.h>
+#include <textureLoader.h>
 #include <shader.h>
 
 #include <string>
@@ -19,45 +26,25 @@
 #include <map>
 #include <vector>
 
-inline unsigned int TextureFromFile(const char *path, const std::string &directory, bool gamma = false)
+// Optional import steps, named so call sites read without counting bools.
+struct ModelLoadOptions
 {
-    std::string filename = std::string(path);
-    filename = directory + '/' + filename;
-
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
+    // also build (or read from the mesh cache) the triangle BVH
+    bool buildBvh = false;
+    // marks the model as never moving: the transform is baked into the
+    // vertices, so meshes, bounds, BVH and sectors are in world space and the
+    // model is drawn with the identity, and meshes sharing a material are
+    // merged into one (see staticBatcher.h)
+    const glm::mat4 *staticTransform = nullptr;
+};
 
-    return textureID;
-}
+// Geometry sizes of the last load, for reporting.
+struct ModelLoadStats
+{
+    size_t gpuBytes = 0;      // vertex and index bytes in the mesh pool
+    size_t unpackedBytes = 0; // the same geometry as full Vertex and 32-bit indices; 0 from the cache
+    bool fromCache = false;   // read from the mesh cache rather than imported
+};
 
 class Model 
 {
@@ -67,19 +54,44 @@ public:
     std::vector<Mesh>    meshes;
     std::string directory;
     bool gammaCorrection;
+    TextureLoader &textureLoader;
+    MaterialLibrary &materials;
+    TriangleBVH bvh; // model-space triangle hierarchy; empty unless requested, mesh ids index meshes
+    SectorGraph sectors; // rooms and portals from sector_/portal_ object names; empty for untagged models
 
-    // constructor
-    Model(std::string const &path, bool gamma = false);
+    // constructor, uploads all meshes into the given pool in the smallest vertex
+    // format that provides the attributes in attributeMask (see Shader::declaredAttributeMask).
+    // Textures are queued on the loader and show a placeholder until they arrive;
+    // each mesh's material is resolved into the library at import.
+    Model(std::string const &path, MeshPool &pool, TextureLoader &textureLoader, MaterialLibrary &materials,
+          uint32_t attributeMask, bool gamma = false, const ModelLoadOptions &options = {});
 
-    // draws the model
-    void Draw(Shader &shader);
+    // Replaces the imported shininess, alpha and emissive strength of every
+    // mesh's material, e.g. with tuning the exporter cannot express.
+    void overrideMaterialParams(float shininess, float alpha, float emissiveStrength);
+
+    // totals of the import-time optimization pass; zero when loaded from the mesh cache
+    const MeshOptimizationStats& optimization() const { return optimizationStats; }
+    const ModelLoadStats& loadStats() const { return loadStatistics; }
     
 private:
+    MeshOptimizationStats optimizationStats;
+    ModelLoadStats loadStatistics;
+    bool bvhRequested;
+    bool staticBatching;
+    glm::mat4 staticTransform;
+    std::vector<std::string> meshNames; // object name per imported mesh, only used during import
+
     // helper functions
-    void loadModel(std::string const &path);
+    void loadModel(std::string const &path, MeshPool &pool, uint32_t attributeMask);
+    bool loadFromCache(std::string const &cachePath, uint64_t sourceHash,
+                       MeshPool &pool, uint32_t attributeMask);
     void processNode(aiNode *node, const aiScene *scene);
     Mesh processMesh(aiMesh *mesh, const aiScene *scene);
     std::vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, std::string typeName);
+    MaterialParams loadMaterialParams(aiMaterial *mat, bool hasDiffuseMap);
+    const Material *resolveMaterial(const std::vector<Texture> &textures, const MaterialParams &params);
+    Texture loadTexture(const std::string &path, const std::string &typeName);
 };
 
 #endif
@@ -0,0 +1,123 @@
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include <shader.h>
+
+// Unit the depth pyramid and the occluder depth are sampled from by the culling passes.
+const GLint OCCLUSION_PYRAMID_TEXTURE_UNIT = 4;
+
+// World-space bounds of one queued draw, keyed by its Mesh::id.
+struct OcclusionCandidate {
+    uint32_t mesh;
+    glm::vec3 center;
+    glm::vec3 halfExtent;
+};
+
+// Counters; HiZ numbers describe the newest result that has been read back.
+struct OcclusionStats {
+    unsigned int tested = 0;             // HiZ: candidates in that result
+    unsigned int occluded = 0;           // HiZ: candidates found fully behind the pyramid
+    unsigned int latencyFrames = 0;      // HiZ: frames between the test and its use
+    unsigned int conditionalQueries = 0; // ConditionalRender: box queries issued two frames ago
+    unsigned int conditionalSkipped = 0; // ConditionalRender: how many of those batches the GPU skipped
+};
+
+// GPU occlusion culling for GL 3.3.
+//
+// HiZ: the level is drawn depth-only into a small target (the occluder pass),
+// reduced into a max-depth mip pyramid, and every candidate box is projected
+// and compared against the pyramid level where it covers at most 2x2 texels,
+// one point per candidate into a visibility texture. That texture is read
+// back through a ring of pixel buffers guarded by fences, so the CPU never
+// waits; the queue uses the newest finished result, one to three frames old.
+//
+// ConditionalRender: before a batch is drawn, the box around its instances is
+// drawn with a GL_ANY_SAMPLES_PASSED query against the depth already in the
+// framebuffer, and the batch is drawn inside glBeginConditionalRender, so
+// the GPU drops it if no sample of the box passed. Nothing is read back.
+class OcclusionCuller {
+public:
+    OcclusionCuller(int width, int height);
+    ~OcclusionCuller();
+    OcclusionCuller(const OcclusionCuller&) = delete;
+    OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+    bool isComplete() const { return complete; }
+
+    // HiZ: maps finished readbacks into meshVisibility(); call before submitting
+    void collect();
+    // HiZ: forgets pending results and marks everything visible
+    void reset();
+    // HiZ: binds and clears the occluder depth target; draw the occluders after this
+    void beginOccluders();
+    // HiZ: reduces the occluder depth, tests the candidates, starts their readback and restores the viewport
+    void testCandidates(const std::vector<OcclusionCandidate>& candidates, const GLint viewport[4]);
+    // per Mesh::id: 0 if the newest result found every tested instance occluded
+    const std::vector<uint8_t>& meshVisibility() const { return visibility; }
+
+    // ConditionalRender: draws the box with a query and returns it for glBeginConditionalRender
+    GLuint queryBox(const glm::vec3& boxMin, const glm::vec3& boxMax, bool restoreDepthWrites);
+    // ConditionalRender: retires the previous frame's queries; call once per frame
+    void beginQueryFrame();
+
+    const OcclusionStats& stats() const { return lastStats; }
+
+private:
+    struct Readback {
+        GLuint pbo = 0;
+        GLsync fence = nullptr;
+        std::vector<uint32_t> meshes; // candidate i -> Mesh::id
+        unsigned int frame = 0;
+    };
+
+    int width;
+    int height;
+    int levels;
+    bool complete = false;
+    unsigned int frameIndex = 0;
+
+    GLuint occluderBuffer = 0;  // depth-only FBO of the occluder pass
+    GLuint occluderDepth = 0;
+    GLuint pyramidBuffer = 0;   // FBO re-pointed at each pyramid level
+    GLuint pyramid = 0;         // R32F, max depth per texel, full mip chain
+    GLuint visibilityBuffer = 0;
+    GLuint visibilityTexture = 0; // R8, one texel per candidate
+    GLuint candidateVAO = 0;
+    GLuint candidateVBO = 0;
+    size_t candidateCapacity = 0;
+    GLuint emptyVAO = 0;
+    GLuint boxVAO = 0;
+    GLuint boxVBO = 0;
+    GLuint boxEBO = 0;
+
+    Shader* reduceShader = nullptr;
+    Shader* testShader = nullptr;
+    Shader* boxShader = nullptr;
+    UniformHandle reduceUniform;
+    UniformHandle boxMinUniform;
+    UniformHandle boxMaxUniform;
+
+    static const int READBACK_SLOTS = 3;
+    Readback readbacks[READBACK_SLOTS];
+    std::vector<uint8_t> visibility;
+    std::vector<float> candidateData;
+
+    // ConditionalRender query pools, one per frame parity
+    std::vector<GLuint> queries[2];
+    size_t queriesUsed[2] = {};
+    unsigned int queryFrame = 0;
+
+    OcclusionStats lastStats;
+
+    void createTargets();
+    void createBox();
+    void buildPyramid();
+};
+
+#endif
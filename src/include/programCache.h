@@ -0,0 +1,29 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <string>
+
+// Bump when the cache file layout changes.
+const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+// True if the context can save and restore program binaries.
+bool programBinaryCacheEnabled();
+
+// Identifies a linked program: its final sources (defines included) plus the
+// driver vendor, renderer and version, since binaries are only valid on the
+// exact driver that produced them.
+uint64_t programCacheKey(const std::string& vertexSource, const std::string& fragmentSource,
+                         const std::string& defines);
+
+// Restores a cached binary into program. Returns false (and leaves program
+// unlinked) if there is no cache entry or the driver rejects it.
+bool loadProgramBinary(uint64_t key, GLuint program);
+
+// Saves a linked program's binary. The program must have been linked with
+// GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+void storeProgramBinary(uint64_t key, GLuint program);
+
+#endif
@@ -0,0 +1,201 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <shader.h>
+#include <mesh.h>
+#include <model.h>
+#include <meshPool.h>
+#include <frustumCuller.h>
+#include <occlusionCuller.h>
+#include <streamBuffer.h>
+
+class ShaderVariantSet;
+struct ShaderVariantContext;
+
+// Submission order of the layers. The first-person overlay clears depth and
+// is drawn last so the held sword is never clipped by the level.
+enum class RenderLayer : uint8_t {
+    Opaque = 0,      // depth tested and written, no blending
+    Transparent = 1, // additive blending, depth tested but not written
+    Overlay = 2      // drawn over a cleared depth buffer
+};
+
+// A linked program and the small stable id used for it in sort keys.
+// Per-draw data reaches the program through instance attributes, not uniforms.
+struct RenderProgram {
+    Shader* shader = nullptr;
+    uint8_t sortId = 0;
+    // Depth-only program with a bit-identical vertex transform. Opaque draws
+    // of programs that have one take part in the depth pre-pass.
+    Shader* depthShader = nullptr;
+};
+
+// Per-instance vertex data read by the scene vertex shaders at
+// Mesh::INSTANCE_MODEL_LOCATION (four columns) and Mesh::INSTANCE_PARAMS_LOCATION.
+struct InstanceData {
+    glm::mat4 model;
+    glm::vec4 params; // x = alpha for blended programs, yzw unused
+};
+
+// A run of sorted draws that share mesh, program and layer, issued as one instanced call.
+struct DrawBatch {
+    const Mesh* mesh;
+    const RenderProgram* program;
+    RenderLayer layer;
+    uint32_t firstInstance;
+    uint32_t instanceCount;
+    glm::vec3 boundsMin; // world box around every instance, for occlusion queries
+    glm::vec3 boundsMax;
+};
+
+// One mesh draw collected for the frame.
+struct DrawItem {
+    const Mesh* mesh;
+    const RenderProgram* program;
+    glm::mat4 transform;
+    RenderLayer layer;
+    float depth;  // distance to the camera, filled in by submit
+    float alpha;  // per-instance alpha, only read by blended programs
+    uint64_t key;
+    uint32_t cullIndex; // bounds slot in the frustum culler
+    glm::vec3 center;   // world-space box
+    glm::vec3 halfExtent;
+};
+
+// Counters for the last executed frame.
+struct RenderQueueStats {
+    unsigned int items = 0;     // meshes submitted
+    unsigned int visible = 0;   // meshes inside the view frustum
+    unsigned int culled = 0;    // meshes outside it, never sorted or drawn
+    unsigned int fogCulled = 0; // meshes entirely past the fog, rejected at submit and not counted in items
+    unsigned int bvhCulled = 0; // meshes the caller's BVH query found outside the view, not counted in items
+    unsigned int occlusionCulled = 0;  // meshes inside the frustum skipped because Hi-Z found them hidden
+    unsigned int conditionalDraws = 0; // instanced draw calls gated on a box query (the GPU may skip them)
+    unsigned int draws = 0;     // instanced draw calls issued
+    unsigned int programBinds = 0;
+    unsigned int textureBinds = 0;     // material binds (maps and parameter range)
+    unsigned int layerChanges = 0;
+    unsigned int vertexArrayBinds = 0; // one per vertex format change
+    unsigned int prepassDraws = 0;     // instanced draw calls of the depth pre-pass
+};
+
+// Samples counted by occlusion queries around the opaque layer. Read back a
+// frame late, so measuring never stalls the pipeline.
+struct OverdrawStats {
+    bool prepass = false;           // whether the measured frame used the depth pre-pass
+    uint64_t depthSamples = 0;      // samples passing the pre-pass depth test: what the opaque
+                                    // layer would shade without the pre-pass (0 if it was off)
+    uint64_t shadedSamples = 0;     // samples the opaque layer's programs actually shaded, over the
+                                    // pre-passed batches only when the pre-pass was on
+
+    // shading invocations the pre-pass saved, as a fraction of what would have run
+    float savedFraction() const {
+        return depthSamples > shadedSamples ? float(depthSamples - shadedSamples) / float(depthSamples) : 0.0f;
+    }
+};
+
+// Collects the draws of a frame, drops the ones outside the view frustum,
+// orders the rest by a 64-bit sort key and submits
+// them with as few program, texture and blend/depth state changes as possible.
+// Adjacent draws of the same mesh with the same program and layer are merged
+// into one glDrawElementsInstanced call.
+//
+// Key layout, most significant bits first:
+//   opaque/overlay: layer(2) | program(8) | material(16) | mesh(14) | depth(24, front-to-back)
+//   transparent:    layer(2) | depth(24, back-to-front)  | program(8) | material(16) | mesh(14)
+//
+// With the depth pre-pass on, opaque draws whose program has a depthShader
+// are first drawn depth-only, then shaded with GL_EQUAL and depth writes off,
+// so each of their pixels runs the expensive fragment shader once.
+//
+// Occlusion culling (see occlusionCuller.h) works at two points: sort() drops
+// draws whose mesh the last Hi-Z result found hidden, and execute() can gate
+// every batch that is not pre-passed on a query of its bounding box.
+class RenderQueue {
+public:
+    RenderQueue() = default;
+    ~RenderQueue();
+    RenderQueue(const RenderQueue&) = delete;
+    RenderQueue& operator=(const RenderQueue&) = delete;
+
+    // viewProjection gives the frustum the queued meshes are culled against
+    void begin(const glm::vec3& cameraPosition, float farPlane, const glm::mat4& viewProjection);
+    void submit(const Model& model, const RenderProgram& program, const glm::mat4& transform,
+                RenderLayer layer, float alpha = 1.0f);
+    // picks the cheapest variant per mesh from its world-space bounds; meshes
+    // with a zero in visibleMeshes (indexed like model.meshes) are skipped
+    void submit(const Model& model, const ShaderVariantSet& variants, const ShaderVariantContext& context,
+                const glm::mat4& transform, RenderLayer layer, float alpha = 1.0f,
+                const std::vector<uint8_t>* visibleMeshes = nullptr);
+    void sort();
+    void execute(const MeshPool& meshPool);
+
+    void setDepthPrepass(bool enabled) { depthPrepass = enabled; }
+    bool depthPrepassEnabled() const { return depthPrepass; }
+
+    // Per Mesh::id verdicts from OcclusionCuller::meshVisibility(); null turns the Hi-Z test off
+    void setOcclusionVisibility(const std::vector<uint8_t>* visibility) { occlusionVisibility = visibility; }
+    // Box queries are issued through this culler; null turns conditional rendering off
+    void setConditionalRender(OcclusionCuller* culler) { conditionalCuller = culler; }
+    // Bounds of the opaque and transparent draws inside the frustum at the last sort(),
+    // including the ones Hi-Z dropped, so they get tested again
+    const std::vector<OcclusionCandidate>& occlusionCandidates() const { return candidates; }
+
+    const RenderQueueStats& stats() const { return lastStats; }
+    const OverdrawStats& overdraw() const { return lastOverdraw; }
+    const CullStats& cullStats() const { return culler.stats(); }
+    size_t size() const { return items.size(); }
+
+private:
+    std::vector<DrawItem> items;
+    std::vector<std::pair<uint64_t, uint32_t>> order;
+    std::vector<DrawBatch> batches;
+    std::vector<InstanceData> instances;
+    StreamBuffer instanceStream{ GL_ARRAY_BUFFER };
+    GLintptr instanceOffset = 0; // this frame's instances in instanceStream
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+    float farPlane = 1.0f;
+    FrustumCuller culler;
+    unsigned int fogCulledCount = 0;
+    unsigned int bvhCulledCount = 0;
+    RenderQueueStats lastStats;
+
+    const std::vector<uint8_t>* occlusionVisibility = nullptr;
+    OcclusionCuller* conditionalCuller = nullptr;
+    std::vector<OcclusionCandidate> candidates;
+    unsigned int occlusionCulledCount = 0;
+
+    bool depthPrepass = false;
+    // GL_SAMPLES_PASSED queries per frame parity. Only one can be active, so the
+    // shading count takes one query per run of measured batches, summed on readback.
+    GLuint prepassQueries[2] = {};
+    std::vector<GLuint> shadingQueries[2];
+    size_t shadingQueriesUsed[2] = {};
+    bool overdrawPending[2] = {};
+    bool overdrawPrepass[2] = {};
+    unsigned int frameIndex = 0;
+    OverdrawStats lastOverdraw;
+
+    void push(const Mesh& mesh, const RenderProgram& program, const glm::mat4& transform,
+              const glm::vec3& center, const glm::vec3& halfExtent, float radius, RenderLayer layer, float alpha);
+    uint64_t makeKey(const DrawItem& item) const;
+    void buildBatches();
+    void uploadInstances();
+    void bindInstanceAttributes(const DrawBatch& batch) const;
+    bool usesPrepass(const DrawBatch& batch) const;
+    void beginShadingQuery(unsigned int parity);
+    bool usesConditionalRender(const DrawBatch& batch) const;
+    void executeDepthPrepass(const MeshPool& meshPool, RenderQueueStats& frameStats);
+    void collectOverdraw();
+    void applyLayerState(RenderLayer layer);
+    void restoreDefaultState();
+};
+
+#endif
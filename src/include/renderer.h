@@ -6,13 +6,63 @@
 #include <vector>
 #include <AL/al.h>
 #include "gameState.h"
+#include "config.h"
+#include "frameConstants.h"
+#include "renderQueue.h"
+#include "shaderVariants.h"
+#include "lightClusters.h"
+#include "deferredRenderer.h"
+#include "occlusionCuller.h"
+#include "indirectScene.h"
+#include "streamBuffer.h"
+#include "glState.h"
 
 class Renderer {
 private:
-    // Shaders
-    Shader* levelShader;
-    Shader* bonfireShader;
-    Shader* swordShader;
+    // Shader variants, one program per combination of optional features
+    ShaderVariantSet* levelShaders;
+    ShaderVariantSet* bonfireShaders;
+    ShaderVariantSet* swordShaders;
+    ShaderVariantSet* lightBeamShaders;
+    ShaderVariantSet* gbufferShaders;
+    Shader* depthShader; // depth pre-pass program of the level variants
+
+    // Camera and light reach used to pick a variant per draw
+    ShaderVariantContext variantContext;
+
+    // Point lights of the current frame, binned into view-space clusters
+    std::vector<ScenePointLight> pointLights;
+    std::vector<ScenePointLight> dynamicLights;
+    LightClusters lightClusters;
+
+    // Draws collected for the current frame
+    RenderQueue renderQueue;
+
+    // Deferred path: the level goes to the G-buffer queue, everything else stays forward
+    DeferredRenderer* deferredRenderer;
+    RenderQueue geometryQueue;
+
+    // Occlusion culling: the level drawn depth-only into the Hi-Z occluder target,
+    // and the bounds of both scene queues tested against it
+    OcclusionCuller* occlusionCuller;
+    RenderQueue occluderQueue;
+    RenderProgram occluderProgram;
+    std::vector<OcclusionCandidate> occlusionCandidates;
+
+    // GPU-driven path (GL 4.3): the level culled by a compute pass and drawn
+    // with one multi-draw per material instead of through the queues
+    IndirectScene* indirectScene;
+
+    // GPU time of the scene passes, double-buffered so reading never stalls
+    GLuint sceneTimeQueries[2];
+    unsigned int frameIndex;
+    float sceneGpuMilliseconds;
+
+    // Per-frame constants shared by all scene shaders, streamed into a fresh
+    // region every frame and bound as a range
+    FrameConstants frameConstants;
+    StreamBuffer frameConstantsStream{ GL_UNIFORM_BUFFER };
+    GLint uniformOffsetAlignment;
     
     // Models
     Model* level;
@@ -22,23 +72,78 @@ private:
     Model* brokenSword;
     Model* lightBeam;
     
+    // Shared vertex/index storage for every loaded model
+    MeshPool meshPool;
+    // Materials of every loaded model and their parameter buffer
+    MaterialLibrary materials;
+
+    // Per-mesh frustum visibility of the level from its BVH, reused every frame
+    std::vector<uint8_t> levelVisibility;
+
+    // Rooms of the level seen through portals this frame, and per-mesh verdicts
+    // of the frustum narrowed through each room's portal rectangle
+    SectorVisibility sectorVisibility;
+    std::vector<uint8_t> sectorMeshVisibility;
+    FrustumCuller sectorCuller;
+
     GameState* gameState;
+    TextureLoader* textureLoader;
     
 public:
-    Renderer(GameState* state);
+    Renderer(GameState* state, TextureLoader* loader);
     ~Renderer();
     
     bool initializeShaders();
     bool loadModels();
     
-    void setupLighting(Shader& shader, float time);
-    void setupTorchLighting(Shader& shader, float time);
+    void configurePrograms();
+    void configureReadyPrograms();
+    void updateLights(float time);
+    void updateSectors(const glm::mat4& viewProjection);
+    void updateFrameConstants(float time);
     
-    void renderLevel();
-    void renderSword(std::string type);
-    void renderBonfire(bool hasBrokenSword);
-    void renderLightBeam();
+    void submitLevel();
+    void submitSword(const std::string& type);
+    void submitBonfire(bool hasBrokenSword);
+    void submitLightBeam();
+    void renderOccluders(const glm::mat4& viewProjection, float farPlane, const GLint viewport[4]);
     void render();
+
+    bool useDeferred() const;
+    bool useGpuDriven() const;
+
+    const RenderQueueStats& getQueueStats() const { return renderQueue.stats(); }
+    const OverdrawStats& getOverdrawStats() const { return renderQueue.overdraw(); }
+    // frustum culling of the forward queue (the deferred G-buffer queue keeps its own)
+    const CullStats& getCullStats() const { return renderQueue.cullStats(); }
+    const CullStats& getGeometryCullStats() const { return geometryQueue.cullStats(); }
+    const LightClusterStats& getLightClusterStats() const { return lightClusters.stats(); }
+    // issued and elided state calls of the last complete frame, GUI included
+    const GLStateStats& getStateStats() const { return glState().stats(); }
+    // draws skipped per queue are in RenderQueueStats::occlusionCulled; these are the culler's own counts
+    const OcclusionStats* getOcclusionStats() const { return occlusionCuller ? &occlusionCuller->stats() : nullptr; }
+    // scene GPU time of the frame before last, for comparing the render paths
+    float getSceneGpuMilliseconds() const { return sceneGpuMilliseconds; }
+
+    // The level's triangle hierarchy in world space (levelTransform() is baked
+    // in at load), for collision and interaction queries.
+    const TriangleBVH* getLevelBvh() const { return level ? &level->bvh : nullptr; }
+    static glm::mat4 levelTransform();
+    static glm::mat4 bonfireTransform();
+
+    // Room-and-portal queries on world positions. Without sectors everything is
+    // reachable and walkability is left to BOUNDARY_LIMIT.
+    bool hasLevelSectors() const { return level && !level->sectors.empty(); }
+    // in a room seen this frame, or outside every room
+    bool isReachable(const glm::vec3& position) const;
+    // isReachable for a sphere: it touches a room seen this frame, or its center is outside every room
+    bool isReachable(const glm::vec3& center, float radius) const;
+    // inside some room and at least PLAYER_RADIUS from its walls
+    bool isWalkable(const glm::vec3& position) const;
+    const SectorVisibility& getSectorVisibility() const { return sectorVisibility; }
+
+    // Lights added by gameplay (torches, braziers, spell effects), shaded on top of the config lights
+    std::vector<ScenePointLight>& getDynamicLights() { return dynamicLights; }
 };
 
 #endif
\ No newline at end of file
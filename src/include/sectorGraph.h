@@ -0,0 +1,108 @@
+#ifndef SECTOR_GRAPH_H
+#define SECTOR_GRAPH_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A room of the level: the meshes tagged with its name and the box around them.
+struct Sector {
+    std::string name;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    std::vector<uint32_t> meshes;  // indices into Model::meshes
+    std::vector<uint32_t> portals; // indices into SectorGraph::portals()
+};
+
+// An opening between two sectors, kept as the triangles of its polygon.
+struct SectorPortal {
+    uint32_t sectors[2] = { 0, 0 };
+    std::vector<glm::vec3> triangles; // three corners per triangle
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+
+    uint32_t other(uint32_t sector) const { return sectors[0] == sector ? sectors[1] : sectors[0]; }
+};
+
+// Result of one traversal. rects holds, per visible sector, the union of the
+// NDC rectangles (xy = min, zw = max) it was seen through.
+struct SectorVisibility {
+    std::vector<uint8_t> sectors;
+    std::vector<glm::vec4> rects;
+    int cameraSector = -1;       // -1: the camera is outside every sector and all of them count as visible
+    unsigned int portalsTested = 0;
+    unsigned int portalsPassed = 0;
+    unsigned int visibleSectors = 0;
+};
+
+// Rooms and portals of a level, read from the object names of the model:
+//
+//   sector_<room>                geometry of room <room>
+//   portal_<roomA>_<roomB>       a polygon joining the two rooms; not drawn
+//
+// Room names end at the next '_' or '.', so exporter suffixes such as
+// "sector_hall_Cube.001" are fine. Untagged meshes belong to no sector and
+// are always drawn. All positions are in model space.
+//
+// Each frame the graph is walked from the camera's sector. A portal is
+// projected to the screen and intersected with the rectangle the current
+// sector is seen through; if anything is left, the sector behind it is
+// visible through that smaller rectangle, which narrows the frustum its
+// meshes are culled against.
+class SectorGraph {
+public:
+    static bool isTagged(const std::string& name);
+
+    // Files one imported mesh. Returns true if it was a portal, which the
+    // caller drops; mesh is the index the mesh keeps otherwise.
+    bool addMesh(const std::string& name, const std::vector<glm::vec3>& positions,
+                 const std::vector<unsigned int>& indices, uint32_t mesh);
+    // Resolves the portals' room names; call after the last addMesh.
+    void finalize();
+    // Renumbers the meshes after the caller merged them; meshMap[old] = new.
+    // Merged meshes must share their sector.
+    void remapMeshes(const std::vector<uint32_t>& meshMap);
+    void clear();
+
+    bool empty() const { return sectorList.empty(); }
+    const std::vector<Sector>& sectors() const { return sectorList; }
+    const std::vector<SectorPortal>& portals() const { return portalList; }
+    // sector of a mesh, -1 for untagged meshes
+    int meshSector(uint32_t mesh) const;
+
+    // The smallest sector whose box contains the point, or -1.
+    int findSector(const glm::vec3& point) const;
+
+    // clip = projection * view * model. nearMargin is how close (in model
+    // units) the eye may get to a portal before it counts as stepping through.
+    void traverse(const glm::mat4& clip, const glm::vec3& eye, float nearMargin, SectorVisibility& out) const;
+
+    // Maps the NDC rectangle onto the whole clip volume, so frustum planes
+    // taken from the result are the ones through the rectangle's edges.
+    static glm::mat4 narrowToRect(const glm::mat4& clip, const glm::vec4& rect);
+
+    // Flat little-endian image for the mesh cache. deserialize rejects images
+    // that index past meshCount meshes.
+    void serialize(std::vector<uint8_t>& out) const;
+    bool deserialize(const uint8_t* data, size_t size, size_t meshCount);
+
+private:
+    struct PendingPortal {
+        std::string first;
+        std::string second;
+        SectorPortal portal;
+    };
+
+    std::vector<Sector> sectorList;
+    std::vector<SectorPortal> portalList;
+    std::vector<PendingPortal> pending;
+    std::vector<int32_t> meshSectors;
+
+    uint32_t sectorIndex(const std::string& name);
+    bool projectPortal(const SectorPortal& portal, const glm::mat4& clip, glm::vec4& rect) const;
+};
+
+#endif
@@ -8,13 +8,32 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <regex>
+#include <cstdint>
+
+#include <glCaps.h>
+#include <glState.h>
+#include <programCache.h>
+
+// Location and type of an active uniform, resolved once from the program's reflection table.
+// Setting an invalid handle is a no-op, the same as glUniform* with location -1.
+struct UniformHandle
+{
+    GLint location = -1;
+    GLenum type = GL_NONE;
+    GLint size = 0;
+
+    bool valid() const { return location >= 0; }
+};
 
 class Shader
 {
 public:
     unsigned int ID;
     
-    Shader(const char* vertexPath, const char* fragmentPath)
+    // defines are injected after the #version line of both stages, e.g. "#define FOG 1\n"
+    Shader(const char* vertexPath, const char* fragmentPath, const std::string &defines = "")
     {
         std::string vertexCode;
         std::string fragmentCode;
@@ -38,93 +57,382 @@ public:
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
         }
+        vertexCode = injectDefines(vertexCode, defines);
+        fragmentCode = injectDefines(fragmentCode, defines);
+        declaredAttributes = parseAttributeLocations(vertexCode);
+
+        // a binary saved by an earlier run skips compiling and linking entirely
+        cacheKey = programCacheKey(vertexCode, fragmentCode, defines);
+        ID = glCreateProgram();
+        if (loadProgramBinary(cacheKey, ID))
+        {
+            finalized = true;
+            reflectUniforms();
+            reflectAttributes();
+            return;
+        }
+
+        // Only submit the work here. Status queries block until the driver is
+        // done, so they wait for finalize(), which runs when the program is
+        // first needed; meanwhile every other program gets submitted too, and
+        // drivers with KHR_parallel_shader_compile build them concurrently.
         const char* vShaderCode = vertexCode.c_str();
         const char * fShaderCode = fragmentCode.c_str();
         
-        unsigned int vertex, fragment;
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
+        vertexStage = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vertexStage, 1, &vShaderCode, NULL);
+        glCompileShader(vertexStage);
         
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
+        fragmentStage = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(fragmentStage, 1, &fShaderCode, NULL);
+        glCompileShader(fragmentStage);
         
+        glAttachShader(ID, vertexStage);
+        glAttachShader(ID, fragmentStage);
+        if (programBinaryCacheEnabled())
+            glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(ID);
+    }
+
+    // compute program (GL 4.3); only construct one after checking glCaps().atLeast(4, 3)
+    explicit Shader(const char* computePath, const std::string &defines)
+    {
+        std::string computeCode;
+        std::ifstream cShaderFile;
+        cShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
+        try
+        {
+            cShaderFile.open(computePath);
+            std::stringstream cShaderStream;
+            cShaderStream << cShaderFile.rdbuf();
+            cShaderFile.close();
+            computeCode = cShaderStream.str();
+        }
+        catch (std::ifstream::failure& e)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
+        }
+        computeCode = injectDefines(computeCode, defines);
+
+        cacheKey = programCacheKey(computeCode, "", defines);
         ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
+        if (loadProgramBinary(cacheKey, ID))
+        {
+            finalized = true;
+            reflectUniforms();
+            return;
+        }
+
+        const char* cShaderCode = computeCode.c_str();
+        computeStage = glCreateShader(GL_COMPUTE_SHADER);
+        glShaderSource(computeStage, 1, &cShaderCode, NULL);
+        glCompileShader(computeStage);
+
+        glAttachShader(ID, computeStage);
+        if (programBinaryCacheEnabled())
+            glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
         glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
+    }
+
+    // true once finalize() would not block. Without KHR_parallel_shader_compile
+    // the driver cannot be asked, so this is always true and finalize() waits.
+    bool isReady() const
+    {
+        if (finalized || !glCaps().parallelShaderCompile)
+            return true;
+        GLint complete = GL_FALSE;
+        glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &complete);
+        return complete == GL_TRUE;
+    }
+
+    // waits for the build, reports errors, saves the binary and reflects the
+    // program; every accessor below calls it, so explicit calls are optional
+    void finalize() const
+    {
+        if (finalized)
+            return;
+        finalized = true;
+
+        if (vertexStage)
+            checkCompileErrors(vertexStage, "VERTEX");
+        if (fragmentStage)
+            checkCompileErrors(fragmentStage, "FRAGMENT");
+        if (computeStage)
+            checkCompileErrors(computeStage, "COMPUTE");
+        bool linked = checkCompileErrors(ID, "PROGRAM");
+
+        for (GLuint* stage : { &vertexStage, &fragmentStage, &computeStage })
+        {
+            if (!*stage)
+                continue;
+            glDetachShader(ID, *stage);
+            glDeleteShader(*stage);
+            *stage = 0;
+        }
+
+        if (linked)
+            storeProgramBinary(cacheKey, ID);
+
+        reflectUniforms();
+        reflectAttributes();
+    }
+
+    // looks up a uniform in the reflection table; resolve once and keep the handle
+    UniformHandle uniform(const std::string &name) const
+    {
+        finalize();
+        auto it = uniforms.find(name);
+        return it != uniforms.end() ? it->second : UniformHandle{};
+    }
+    
+    // bit i is set if the vertex shader reads the attribute at location i
+    uint32_t activeAttributeMask() const
+    {
+        finalize();
+        return attributeMask;
+    }
+
+    // bit i is set if the vertex source declares an input at location i; a
+    // superset of activeAttributeMask() that is known without waiting for the link
+    uint32_t declaredAttributeMask() const
+    {
+        return declaredAttributes;
     }
     
     void use() const
     { 
-        glUseProgram(ID); 
+        finalize();
+        glState().useProgram(ID); 
+    }
+
+    // attaches a uniform block to a buffer binding point; ignored if the program does not declare it
+    void bindUniformBlock(const char* blockName, GLuint binding) const
+    {
+        finalize();
+        GLuint index = glGetUniformBlockIndex(ID, blockName);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
     }
     void setBool(const std::string &name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        glUniform1i(uniform(name).location, (int)value); 
     }
     
     void setInt(const std::string &name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1i(uniform(name).location, value); 
     }
     
     void setFloat(const std::string &name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1f(uniform(name).location, value); 
     }
     
     void setVec2(const std::string &name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform2fv(uniform(name).location, 1, &value[0]); 
     }
     void setVec2(const std::string &name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        glUniform2f(uniform(name).location, x, y); 
     }
     
     void setVec3(const std::string &name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform3fv(uniform(name).location, 1, &value[0]); 
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        glUniform3f(uniform(name).location, x, y, z); 
     }
     
     void setVec4(const std::string &name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform4fv(uniform(name).location, 1, &value[0]); 
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) const
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        glUniform4f(uniform(name).location, x, y, z, w); 
     }
     
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(uniform(name).location, 1, GL_FALSE, &mat[0][0]);
     }
     
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(uniform(name).location, 1, GL_FALSE, &mat[0][0]);
     }
     
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(uniform(name).location, 1, GL_FALSE, &mat[0][0]);
+    }
+
+    // handle based setters, no string building and no driver lookup
+    void setBool(const UniformHandle &handle, bool value) const
+    {
+        glUniform1i(handle.location, (int)value);
+    }
+
+    void setInt(const UniformHandle &handle, int value) const
+    {
+        glUniform1i(handle.location, value);
+    }
+
+    void setFloat(const UniformHandle &handle, float value) const
+    {
+        glUniform1f(handle.location, value);
+    }
+
+    void setVec2(const UniformHandle &handle, const glm::vec2 &value) const
+    {
+        glUniform2fv(handle.location, 1, &value[0]);
+    }
+
+    void setVec3(const UniformHandle &handle, const glm::vec3 &value) const
+    {
+        glUniform3fv(handle.location, 1, &value[0]);
+    }
+    void setVec3(const UniformHandle &handle, float x, float y, float z) const
+    {
+        glUniform3f(handle.location, x, y, z);
+    }
+
+    void setVec4(const UniformHandle &handle, const glm::vec4 &value) const
+    {
+        glUniform4fv(handle.location, 1, &value[0]);
+    }
+
+    void setMat3(const UniformHandle &handle, const glm::mat3 &mat) const
+    {
+        glUniformMatrix3fv(handle.location, 1, GL_FALSE, &mat[0][0]);
+    }
+
+    void setMat4(const UniformHandle &handle, const glm::mat4 &mat) const
+    {
+        glUniformMatrix4fv(handle.location, 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
-    void checkCompileErrors(GLuint shader, std::string type)
+    // build state; mutable because finalizing happens lazily inside const accessors
+    mutable bool finalized = false;
+    mutable GLuint vertexStage = 0;
+    mutable GLuint fragmentStage = 0;
+    mutable GLuint computeStage = 0;
+    uint64_t cacheKey = 0;
+
+    mutable std::unordered_map<std::string, UniformHandle> uniforms;
+
+    // inserts defines right after the #version directive (which must stay first)
+    static std::string injectDefines(const std::string &source, const std::string &defines)
+    {
+        if (defines.empty())
+            return source;
+        size_t version = source.find("#version");
+        if (version == std::string::npos)
+            return defines + source;
+        size_t lineEnd = source.find('\n', version);
+        if (lineEnd == std::string::npos)
+            return source + "\n" + defines;
+        return source.substr(0, lineEnd + 1) + defines + source.substr(lineEnd + 1);
+    }
+    mutable uint32_t attributeMask = 0;
+    uint32_t declaredAttributes = 0;
+
+    // scans "layout (location = N) in type name;" declarations of a vertex source
+    static uint32_t parseAttributeLocations(const std::string &source)
+    {
+        static const std::regex declaration(
+            R"(layout\s*\(\s*location\s*=\s*(\d+)\s*\)\s*in\s+(\w+))");
+        uint32_t mask = 0;
+        for (std::sregex_iterator it(source.begin(), source.end(), declaration), end; it != end; ++it)
+        {
+            int location = std::stoi((*it)[1].str());
+            std::string type = (*it)[2].str();
+            int columns = type == "mat4" ? 4 : type == "mat3" ? 3 : type == "mat2" ? 2 : 1;
+            for (int slot = 0; slot < columns && location + slot < 32; slot++)
+                mask |= 1u << (location + slot);
+        }
+        return mask;
+    }
+
+    // records which vertex attribute locations the program actually reads;
+    // matrix attributes occupy one location per column
+    void reflectAttributes() const
+    {
+        GLint count = 0;
+        GLint maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_ATTRIBUTES, &count);
+        glGetProgramiv(ID, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+
+        std::string buffer(maxLength > 0 ? maxLength : 1, '\0');
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = GL_NONE;
+            glGetActiveAttrib(ID, (GLuint)i, maxLength, &length, &size, &type, &buffer[0]);
+            std::string name(buffer.data(), length);
+
+            GLint location = glGetAttribLocation(ID, name.c_str());
+            if (location < 0)
+                continue;
+
+            GLint columns = type == GL_FLOAT_MAT4 ? 4 : type == GL_FLOAT_MAT3 ? 3 : type == GL_FLOAT_MAT2 ? 2 : 1;
+            for (GLint slot = 0; slot < columns * size && location + slot < 32; slot++)
+                attributeMask |= 1u << (location + slot);
+        }
+    }
+
+    // builds the name -> handle table for every active uniform after linking.
+    // array uniforms are reported once as "name[0]", so each element is registered
+    // under its own name, and the first element also under the bare array name.
+    void reflectUniforms() const
+    {
+        GLint count = 0;
+        GLint maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+        std::string buffer(maxLength > 0 ? maxLength : 1, '\0');
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = GL_NONE;
+            glGetActiveUniform(ID, (GLuint)i, maxLength, &length, &size, &type, &buffer[0]);
+            std::string name(buffer.data(), length);
+
+            UniformHandle handle;
+            handle.location = glGetUniformLocation(ID, name.c_str());
+            handle.type = type;
+            handle.size = size;
+            // uniforms inside blocks have no location
+            if (handle.location < 0)
+                continue;
+
+            uniforms[name] = handle;
+
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+            {
+                std::string base = name.substr(0, name.size() - 3);
+                uniforms[base] = handle;
+                for (GLint element = 1; element < size; element++)
+                {
+                    std::string elementName = base + "[" + std::to_string(element) + "]";
+                    UniformHandle elementHandle = handle;
+                    elementHandle.location = glGetUniformLocation(ID, elementName.c_str());
+                    elementHandle.size = size - element;
+                    uniforms[elementName] = elementHandle;
+                }
+            }
+        }
+    }
+
+    // prints the info log on failure; returns true if the compile or link succeeded
+    bool checkCompileErrors(GLuint shader, std::string type) const
     {
         GLint success;
         GLchar infoLog[1024];
@@ -146,6 +454,7 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success == GL_TRUE;
     }
 };
 #endif
\ No newline at end of file
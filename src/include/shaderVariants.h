@@ -0,0 +1,101 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <shader.h>
+#include <renderQueue.h>
+#include <lightClusters.h>
+#include "config.h"
+
+// Optional parts of the scene shaders. Each set bit becomes a #define in the
+// generated header, and the GLSL wraps the matching code in #ifdef blocks.
+enum ShaderFeature : uint32_t {
+    SHADER_FEATURE_POINT_LIGHTS = 1u << 0, // clustered point lights (POINT_LIGHTS)
+    SHADER_FEATURE_FOG = 1u << 1,          // distance fog (FOG)
+    SHADER_FEATURE_QUANTIZE = 1u << 2,     // PS1 color quantization and dithering (QUANTIZE)
+    SHADER_FEATURE_EMISSIVE = 1u << 3      // flickering self-illumination (EMISSIVE)
+};
+
+// Features the config allows at all; variants never include the others.
+uint32_t enabledShaderFeatures();
+
+// Source injected after #version in both stages of a variant: the feature
+// defines, the cluster grid constants, the DirLight/PointLight/FrameConstants
+// declarations, the MaterialParams block and diffuseMap sampler, and the light
+// cluster lookups, all generated from the C++ side. Each shader notes the
+// parts it relies on.
+std::string shaderVariantHeader(uint32_t features);
+
+// Distance from the camera past which fog leaves nothing but FOG_COLOR.
+float fogHiddenDistance();
+
+// Per-frame state the per-draw variant choice depends on.
+struct ShaderVariantContext {
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+    float fogNear = 0.0f;
+    float fogHidden = 0.0f; // fogHiddenDistance()
+    std::vector<glm::vec4> lights; // xyz position, w range
+
+    void update(const glm::vec3& camera, const std::vector<ScenePointLight>& pointLights);
+    // features a draw covering the world-space sphere (center, radius) cannot do without
+    uint32_t requiredFeatures(const glm::vec3& center, float radius) const;
+    // true if every point of the sphere lies where fog leaves only FOG_COLOR
+    bool hiddenByFog(const glm::vec3& center, float radius) const;
+};
+
+// Every variant of one scene program, built up front from the same sources.
+// Features in fixedFeatures are always compiled in; each subset of
+// optionalFeatures gets its own program, so a draw that does not need an
+// optional feature can skip its cost entirely.
+//
+// Once setConfigure() is called, a variant is only handed out after its
+// program state was set, which configureReady() does as builds finish. Until
+// then select() falls back to a finished variant with more features, and only
+// waits for a build when there is none.
+class ShaderVariantSet {
+public:
+    // sort ids firstSortId .. firstSortId + size() - 1 are taken
+    ShaderVariantSet(const char* vertexPath, const char* fragmentPath, uint32_t fixedFeatures,
+                     uint32_t optionalFeatures, uint8_t firstSortId);
+    ~ShaderVariantSet();
+    ShaderVariantSet(const ShaderVariantSet&) = delete;
+    ShaderVariantSet& operator=(const ShaderVariantSet&) = delete;
+
+    // the cheapest usable variant that provides every feature of required it supports
+    const RenderProgram& select(uint32_t required) const;
+    // the variant with every supported feature
+    const RenderProgram& full() const { return select(~0u); }
+
+    size_t size() const { return variants.size(); }
+    uint8_t nextSortId() const { return static_cast<uint8_t>(firstSortId + variants.size()); }
+    const std::vector<std::pair<uint32_t, RenderProgram>>& all() const { return variants; }
+    // whether draws fully inside the fog can be skipped
+    bool fadesOutInFog() const;
+
+    // enables the depth pre-pass for every variant; the caller keeps ownership of shader
+    void setDepthShader(Shader* shader);
+
+    // sets the program state of one variant (uniform blocks, samplers, constants)
+    void setConfigure(std::function<void(const Shader&)> configureVariant);
+    // configures the variants whose build has finished; never blocks, call once per frame
+    void configureReady();
+
+private:
+    uint32_t fixedFeatures;
+    uint32_t optionalFeatures;
+    uint8_t firstSortId;
+    std::vector<std::pair<uint32_t, RenderProgram>> variants; // features -> program; never resized after construction
+    std::function<void(const Shader&)> configure;
+    mutable std::vector<uint8_t> configured; // per variant
+
+    void configureVariant(size_t index) const;
+};
+
+#endif
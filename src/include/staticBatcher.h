@@ -0,0 +1,34 @@
+#ifndef STATIC_BATCHER_H
+#define STATIC_BATCHER_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <mesh.h>
+
+// Numbers of one batching pass.
+struct StaticBatchStats {
+    size_t meshesBefore = 0;
+    size_t batches = 0;
+    size_t vertices = 0;
+    size_t triangles = 0;
+};
+
+// Moves CPU-side meshes into the space of transform: positions, normals and
+// the tangent frame. A mirroring transform also flips the triangle winding.
+// Bounds are recomputed, so the meshes come back as new Mesh objects.
+void bakeStaticTransform(std::vector<Mesh>& meshes, const glm::mat4& transform);
+
+// Merges meshes that never move and share a material into one mesh per
+// material, so they draw as one call; each result gets the bounds of
+// its merged geometry. groups (optional, indexed like meshes) adds a key that
+// must match as well, e.g. the sector a mesh belongs to, so merging never
+// spans what culling has to tell apart. Batches keep the order in which their
+// first mesh appears. meshMap receives the new index of every old mesh.
+StaticBatchStats batchStaticMeshes(std::vector<Mesh>& meshes, const std::vector<int>& groups,
+                                   std::vector<uint32_t>& meshMap);
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// Buffer for data rewritten every frame (instance transforms, frame
+// constants, light lists), split into one region per frame in flight.
+//
+// Where the context has glBufferStorage the whole buffer is mapped once,
+// persistent and coherent: a write is a memcpy into the current region, and
+// a fence set by end() tells begin() when the GPU is done with a region three
+// uses later, so there is no implicit sync and no map/unmap. Elsewhere (GL 3.3)
+// begin() orphans the store with glBufferData and writes go through
+// glBufferSubData, with offsets starting at zero each time.
+//
+// Offsets returned by write() are absolute in buffer(); bind ranges or point
+// attributes with them. The buffer name changes when it has to grow.
+class StreamBuffer {
+public:
+    static const unsigned int REGIONS = 3;
+
+    // target is what the buffer will be bound as; texture buffers only map
+    // persistently where glTexBufferRange can address a region
+    explicit StreamBuffer(GLenum target) : target(target) {}
+    ~StreamBuffer();
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    // starts the next region with room for bytes (plus alignment padding),
+    // growing the buffer if needed; waits only if the GPU is still reading it
+    void begin(size_t bytes);
+    // copies bytes into the current region at a multiple of alignment (at most 256);
+    // returns the offset in buffer(), or -1 if the region is full
+    GLintptr write(const void* data, size_t bytes, size_t alignment = 16);
+    // fences the region; call after the commands reading it are issued
+    void end();
+
+    GLuint buffer() const { return name; }
+    bool persistent() const { return mapped != nullptr; }
+    // begin() calls that found their region still in use and had to block
+    unsigned int stalls() const { return stallCount; }
+
+private:
+    GLenum target;
+    GLuint name = 0;
+    uint8_t* mapped = nullptr;
+    size_t regionSize = 0;
+    unsigned int region = 0;
+    size_t cursor = 0;
+    GLsync fences[REGIONS] = {};
+    unsigned int stallCount = 0;
+
+    void allocate(size_t size);
+    void release();
+};
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// How a loaded texture is sampled.
+struct TextureSampling {
+    bool mipmaps = true;
+    GLint minFilter = GL_LINEAR_MIPMAP_LINEAR;
+    GLint magFilter = GL_NEAREST;
+    GLint wrap = GL_REPEAT;
+};
+
+// GUI images: no mipmaps, smooth, clamped.
+const TextureSampling GUI_TEXTURE_SAMPLING = { false, GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE };
+
+// Decodes image files on worker threads and uploads them on the GL thread
+// through a ring of pixel buffer objects.
+//
+// load() returns a texture name immediately. Until the decoded pixels have
+// been uploaded by update(), the name holds a 1x1 placeholder; the upload
+// respecifies the same name, so meshes and GUI widgets can keep it.
+// All methods except the workers' internals must be called on the GL thread.
+class TextureLoader {
+public:
+    // workerCount 0 uses one thread per core, leaving one for the GL thread
+    explicit TextureLoader(unsigned int workerCount = 0);
+    ~TextureLoader();
+    TextureLoader(const TextureLoader&) = delete;
+    TextureLoader& operator=(const TextureLoader&) = delete;
+
+    GLuint load(const std::string& path, const TextureSampling& sampling = TextureSampling());
+    void release(GLuint texture);
+
+    // Uploads finished decodes, at most maxUploads per call (0 = no limit).
+    void update(unsigned int maxUploads = 0);
+    // Blocks until every queued texture has been decoded and uploaded.
+    void finish();
+
+    size_t pendingCount() const;
+    unsigned int workerCount() const { return static_cast<unsigned int>(workers.size()); }
+
+private:
+    struct Job {
+        GLuint texture;
+        std::string path;
+        TextureSampling sampling;
+    };
+
+    struct DecodedImage {
+        GLuint texture;
+        std::string path;
+        TextureSampling sampling;
+        unsigned char* pixels; // stbi allocation, null if decoding failed
+        int width;
+        int height;
+        int channels;
+    };
+
+    struct PixelBuffer {
+        GLuint buffer = 0;
+        size_t capacity = 0;
+        GLsync fence = nullptr;
+    };
+
+    static const size_t PIXEL_BUFFER_COUNT = 3;
+
+    std::vector<std::thread> workers;
+    mutable std::mutex mutex;
+    std::condition_variable jobReady;
+    std::condition_variable imageReady;
+    std::deque<Job> jobs;
+    std::deque<DecodedImage> decoded;
+    bool stopping = false;
+
+    std::unordered_map<std::string, GLuint> loaded; // path -> texture, shared between users
+    std::unordered_set<GLuint> pending;             // placeholders still waiting for pixels
+    std::unordered_set<GLuint> released;            // released while pending; deleted when their decode returns
+    PixelBuffer pixelBuffers[PIXEL_BUFFER_COUNT];
+    size_t nextPixelBuffer = 0;
+
+    void workerLoop();
+    bool upload(DecodedImage& image);
+    static void createPlaceholder(GLuint texture);
+};
+
+#endif
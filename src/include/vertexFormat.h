@@ -0,0 +1,82 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define MAX_BONE_INFLUENCE 4
+
+// Import-time vertex, kept until the mesh is encoded into one of the GPU formats below.
+struct Vertex {
+    // position
+    glm::vec3 Position;
+    // normal
+    glm::vec3 Normal;
+    // texCoords
+    glm::vec2 TexCoords;
+    // tangent
+    glm::vec3 Tangent;
+    // bitangent
+    glm::vec3 Bitangent;
+	//bone indexes which will influence this vertex
+	int m_BoneIDs[MAX_BONE_INFLUENCE];
+	//weights from each bone
+	float m_Weights[MAX_BONE_INFLUENCE];
+};
+
+// GPU vertex layouts. All of them feed the same attribute locations
+// (0 position, 1 normal, 2 uv, 3-6 tangent space and bones), so a shader
+// works with any format that provides the attributes it reads.
+enum class VertexFormat : uint8_t {
+    Full = 0,     // Vertex as is, 88 bytes; only for shaders reading tangents or bones
+    Standard = 1, // float3 position, float3 normal, float2 uv, 32 bytes
+    Packed = 2,   // int16x4 position, 10:10:10:2 normal, half2 uv, 16 bytes
+    Count
+};
+
+const size_t VERTEX_FORMAT_COUNT = static_cast<size_t>(VertexFormat::Count);
+
+// Attribute locations beyond position/normal/uv; a shader reading any of these needs VertexFormat::Full.
+const uint32_t TANGENT_SPACE_ATTRIBUTE_MASK = (1u << 3) | (1u << 4) | (1u << 5) | (1u << 6);
+
+struct StandardVertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 texCoords;
+};
+
+// Positions are stored as integers in [-32767, 32767] relative to the mesh bounds;
+// the mesh's positionDecode matrix maps them back to model space.
+struct PackedVertex {
+    int16_t position[4];
+    uint32_t normal;       // GL_INT_2_10_10_10_REV
+    uint16_t texCoords[2]; // GL_HALF_FLOAT
+};
+
+static_assert(sizeof(StandardVertex) == 32, "StandardVertex must be tightly packed");
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex must be tightly packed");
+
+// Largest |uv| stored as half floats; beyond this half precision drops below 1/256.
+const float PACKED_UV_LIMIT = 8.0f;
+
+size_t vertexFormatStride(VertexFormat format);
+const char* vertexFormatName(VertexFormat format);
+
+// Picks the smallest format that provides what the shader reads and still
+// represents the mesh faithfully.
+VertexFormat chooseVertexFormat(uint32_t shaderAttributeMask, const std::vector<Vertex>& vertices);
+
+// Converts vertices into the given format. positionDecode receives the matrix
+// that maps stored positions back to model space (identity unless Packed).
+std::vector<uint8_t> encodeVertices(const std::vector<Vertex>& vertices, VertexFormat format,
+                                    const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+                                    glm::mat4& positionDecode);
+
+// Sets the attribute pointers of the format on the bound VAO, reading from the bound GL_ARRAY_BUFFER.
+void describeVertexFormat(VertexFormat format);
+
+#endif
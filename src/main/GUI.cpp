@@ -7,14 +7,17 @@
  */
 
 #include "GUI.h"
-#include "stb_image.h"
+#include "glState.h"
 
 /**
  * @brief Initializes ImGui, its backends (GLFW, OpenGL3), and loads custom fonts.
  * @param window The main GLFW window.
+ * @param loader The texture loader used for item images.
  * @return True on successful initialization, false otherwise.
  */
-bool GUI::Initialize(GLFWwindow* window) {
+bool GUI::Initialize(GLFWwindow* window, TextureLoader* loader) {
+    textureLoader = loader;
+
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
     ImGuiIO& io = ImGui::GetIO();
@@ -87,6 +90,17 @@ void GUI::RenderMenu(GameState* gameState) {
     if (ImGui::Button("Options")) {
         // Placeholder for options logic.
     }
+    bool deferred = gameState->renderPath == RenderPath::Deferred;
+    if (ImGui::Checkbox("Deferred shading (F2)", &deferred)) {
+        gameState->renderPath = deferred ? RenderPath::Deferred : RenderPath::Forward;
+    }
+    ImGui::Checkbox("Depth pre-pass (F3)", &gameState->depthPrepass);
+    int occlusion = static_cast<int>(gameState->occlusionMode);
+    const char* occlusionModes[] = { "Off", "Hi-Z", "Conditional render" };
+    if (ImGui::Combo("Occlusion culling (F4)", &occlusion, occlusionModes, 3)) {
+        gameState->occlusionMode = static_cast<OcclusionMode>(occlusion);
+    }
+    ImGui::Checkbox("GPU-driven level (F5)", &gameState->gpuDriven);
     if (ImGui::Button("Quit")) {
         // Placeholder for quit logic.
     }
@@ -310,6 +324,8 @@ void GUI::Render(GameState* gameState) {
     // Finalize the ImGui frame and render its draw data.
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    // The backend sets its own state and restores it behind the cache's back.
+    glState().invalidate();
 }
 
 /**
@@ -331,44 +347,13 @@ GLuint GUI::LoadImageTexture(const std::string& imagePath) {
         return it->second;
     }
 
-    GLuint textureID = 0;
-    int width, height, channels;
-    
-    // Load image data using stb_image
-    unsigned char* data = stbi_load(imagePath.c_str(), &width, &height, &channels, 0);
-    if (!data) {
-        std::cerr << "Failed to load image: " << imagePath << std::endl;
-        return 0;
-    }
-
-    // Generate OpenGL texture
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-
-    // Set texture parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    // Upload texture data
-    GLenum format = GL_RGB;
-    if (channels == 1)
-        format = GL_RED;
-    else if (channels == 3)
-        format = GL_RGB;
-    else if (channels == 4)
-        format = GL_RGBA;
-
-    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-
-    // Free image data
-    stbi_image_free(data);
+    // Decoded in the background; the button shows a placeholder for the first frames.
+    GLuint textureID = textureLoader->load(imagePath, GUI_TEXTURE_SAMPLING);
 
     // Cache the texture
     imageTextures[imagePath] = textureID;
 
-    std::cout << "Loaded texture: " << imagePath << " (ID: " << textureID << ")" << std::endl;
+    std::cout << "Queued texture: " << imagePath << " (ID: " << textureID << ")" << std::endl;
     return textureID;
 }
 
@@ -377,7 +362,7 @@ GLuint GUI::LoadImageTexture(const std::string& imagePath) {
  */
 void GUI::FreeImageTextures() {
     for (auto& pair : imageTextures) {
-        glDeleteTextures(1, &pair.second);
+        textureLoader->release(pair.second);
     }
     imageTextures.clear();
 }
@@ -0,0 +1,582 @@
+/**
+ * @file bvh.cpp
+ * @brief Builds, queries and serializes the triangle BVH of static models.
+ *
+ * Splits are chosen with the surface area heuristic evaluated over a fixed
+ * number of centroid bins per axis, which costs O(n) per level instead of
+ * sorting. Large subtrees are handed to worker threads; since they work on
+ * disjoint ranges of the triangle order and take node pairs from an atomic
+ * counter, they need no other synchronization. A final pass compacts the
+ * nodes into depth-first order.
+ */
+
+#include "bvh.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <limits>
+
+namespace {
+    const int SAH_BINS = 12;
+    const uint32_t MIN_SPLIT_TRIANGLES = 3;    // smaller nodes are always leaves
+    const uint32_t FORCE_SPLIT_TRIANGLES = 16; // split above this even when SAH prefers a leaf
+    const unsigned int MAX_DEPTH = 48;         // keeps the fixed traversal stacks below safe
+    const int TRAVERSAL_STACK_SIZE = 64;       // entries of those stacks; bounds the depth of loaded images
+    const uint32_t PARALLEL_TRIANGLES = 4096;  // subtrees at least this big go to a worker
+    const unsigned int PARALLEL_DEPTH = 4;     // at most 2^4 concurrent subtrees
+    const float TRAVERSAL_COST = 1.0f;         // relative to one triangle test
+
+    const char BVH_MAGIC[4] = { 'B', 'V', 'H', '1' };
+
+    struct SerializedHeader {
+        char magic[4];
+        uint32_t nodeCount;
+        uint32_t triangleCount;
+        uint32_t meshCount;
+    };
+
+    struct Bounds {
+        glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+        glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+        void grow(const glm::vec3& p) {
+            min = glm::min(min, p);
+            max = glm::max(max, p);
+        }
+        void grow(const Bounds& b) {
+            min = glm::min(min, b.min);
+            max = glm::max(max, b.max);
+        }
+        float area() const {
+            glm::vec3 e = max - min;
+            return (e.x < 0.0f) ? 0.0f : 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+        }
+    };
+
+    // Shared state of one build.
+    struct Builder {
+        const std::vector<BVHTriangle>& triangles;
+        std::vector<Bounds> triangleBounds;
+        std::vector<glm::vec3> centroids;
+        std::vector<uint32_t> order;
+        std::vector<BVHNode> nodes;
+        std::atomic<uint32_t> nodeCount{ 1 };
+
+        explicit Builder(const std::vector<BVHTriangle>& tris) : triangles(tris) {}
+
+        void buildNode(uint32_t nodeIndex, uint32_t first, uint32_t count, unsigned int depth);
+    };
+
+    /**
+     * @brief Builds the subtree over order[first, first + count) into nodes[nodeIndex].
+     */
+    void Builder::buildNode(uint32_t nodeIndex, uint32_t first, uint32_t count, unsigned int depth) {
+        Bounds bounds, centroidBounds;
+        for (uint32_t i = first; i < first + count; i++) {
+            bounds.grow(triangleBounds[order[i]]);
+            centroidBounds.grow(centroids[order[i]]);
+        }
+
+        BVHNode& node = nodes[nodeIndex];
+        node.boundsMin = bounds.min;
+        node.boundsMax = bounds.max;
+        node.leftOrFirst = first;
+        node.count = count;
+        if (count < MIN_SPLIT_TRIANGLES || depth >= MAX_DEPTH) {
+            return;
+        }
+
+        // Evaluate every bin boundary on every axis.
+        float bestCost = std::numeric_limits<float>::max();
+        int bestAxis = -1;
+        int bestSplit = 0;
+        glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+        for (int axis = 0; axis < 3; axis++) {
+            if (extent[axis] <= 0.0f) continue;
+
+            Bounds binBounds[SAH_BINS];
+            uint32_t binCounts[SAH_BINS] = {};
+            float scale = SAH_BINS / extent[axis];
+            for (uint32_t i = first; i < first + count; i++) {
+                uint32_t t = order[i];
+                int bin = std::min(SAH_BINS - 1, static_cast<int>((centroids[t][axis] - centroidBounds.min[axis]) * scale));
+                binCounts[bin]++;
+                binBounds[bin].grow(triangleBounds[t]);
+            }
+
+            // Sweep from both sides to get the area and count left and right of each boundary.
+            float leftArea[SAH_BINS - 1], rightArea[SAH_BINS - 1];
+            uint32_t leftCount[SAH_BINS - 1], rightCount[SAH_BINS - 1];
+            Bounds leftBox, rightBox;
+            uint32_t leftSum = 0, rightSum = 0;
+            for (int i = 0; i < SAH_BINS - 1; i++) {
+                leftSum += binCounts[i];
+                leftBox.grow(binBounds[i]);
+                leftCount[i] = leftSum;
+                leftArea[i] = leftBox.area();
+
+                rightSum += binCounts[SAH_BINS - 1 - i];
+                rightBox.grow(binBounds[SAH_BINS - 1 - i]);
+                rightCount[SAH_BINS - 2 - i] = rightSum;
+                rightArea[SAH_BINS - 2 - i] = rightBox.area();
+            }
+            for (int i = 0; i < SAH_BINS - 1; i++) {
+                if (leftCount[i] == 0 || rightCount[i] == 0) continue;
+                float cost = leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = i;
+                }
+            }
+        }
+
+        // Compare against keeping a leaf, both scaled by the node's area.
+        float leafCost = count * bounds.area();
+        bool splitPays = bestAxis >= 0 && TRAVERSAL_COST * bounds.area() + bestCost < leafCost;
+        if (!splitPays && count <= FORCE_SPLIT_TRIANGLES) {
+            return;
+        }
+
+        uint32_t middle;
+        if (bestAxis >= 0) {
+            float scale = SAH_BINS / extent[bestAxis];
+            float minimum = centroidBounds.min[bestAxis];
+            auto split = std::partition(order.begin() + first, order.begin() + first + count, [&](uint32_t t) {
+                int bin = std::min(SAH_BINS - 1, static_cast<int>((centroids[t][bestAxis] - minimum) * scale));
+                return bin <= bestSplit;
+            });
+            middle = static_cast<uint32_t>(split - order.begin());
+        } else {
+            // Every centroid coincides; halving still bounds the leaf size.
+            middle = first + count / 2;
+        }
+
+        uint32_t left = nodeCount.fetch_add(2);
+        node.leftOrFirst = left;
+        node.count = 0;
+
+        uint32_t leftCount = middle - first;
+        uint32_t rightCount = count - leftCount;
+        if (depth < PARALLEL_DEPTH && leftCount >= PARALLEL_TRIANGLES && rightCount >= PARALLEL_TRIANGLES) {
+            auto worker = std::async(std::launch::async, [this, left, first, leftCount, depth] {
+                buildNode(left, first, leftCount, depth + 1);
+            });
+            buildNode(left + 1, middle, rightCount, depth + 1);
+            worker.get();
+        } else {
+            buildNode(left, first, leftCount, depth + 1);
+            buildNode(left + 1, middle, rightCount, depth + 1);
+        }
+    }
+
+    /**
+     * @brief Tests an axis-aligned box against six planes; false if it is fully outside one.
+     */
+    bool boxInFrustum(const glm::vec4 planes[6], const glm::vec3& boxMin, const glm::vec3& boxMax) {
+        for (int p = 0; p < 6; p++) {
+            // The corner farthest along the normal decides.
+            glm::vec3 corner(planes[p].x >= 0.0f ? boxMax.x : boxMin.x,
+                             planes[p].y >= 0.0f ? boxMax.y : boxMin.y,
+                             planes[p].z >= 0.0f ? boxMax.z : boxMin.z);
+            if (glm::dot(glm::vec3(planes[p]), corner) + planes[p].w < 0.0f) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Slab test; returns the entry distance, or infinity on a miss.
+     */
+    float rayBox(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance,
+                 const glm::vec3& boxMin, const glm::vec3& boxMax) {
+        glm::vec3 t0 = (boxMin - origin) * inverseDirection;
+        glm::vec3 t1 = (boxMax - origin) * inverseDirection;
+        glm::vec3 tNear = glm::min(t0, t1);
+        glm::vec3 tFar = glm::max(t0, t1);
+        float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+        float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+        return enter <= exit ? enter : std::numeric_limits<float>::infinity();
+    }
+
+    /**
+     * @brief Moller-Trumbore ray/triangle intersection, both sides.
+     */
+    bool rayTriangle(const glm::vec3& origin, const glm::vec3& direction, const BVHTriangle& tri, float& distance) {
+        const float epsilon = 1e-7f;
+        glm::vec3 edge1 = tri.v1 - tri.v0;
+        glm::vec3 edge2 = tri.v2 - tri.v0;
+        glm::vec3 p = glm::cross(direction, edge2);
+        float determinant = glm::dot(edge1, p);
+        if (std::abs(determinant) < epsilon) return false;
+
+        float inverse = 1.0f / determinant;
+        glm::vec3 s = origin - tri.v0;
+        float u = glm::dot(s, p) * inverse;
+        if (u < 0.0f || u > 1.0f) return false;
+        glm::vec3 q = glm::cross(s, edge1);
+        float v = glm::dot(direction, q) * inverse;
+        if (v < 0.0f || u + v > 1.0f) return false;
+
+        distance = glm::dot(edge2, q) * inverse;
+        return distance >= 0.0f;
+    }
+
+    /**
+     * @brief Closest point of a triangle to p (Ericson, Real-Time Collision Detection 5.1.5).
+     */
+    glm::vec3 closestPointOnTriangle(const glm::vec3& p, const BVHTriangle& tri) {
+        const glm::vec3& a = tri.v0;
+        const glm::vec3& b = tri.v1;
+        const glm::vec3& c = tri.v2;
+        glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+        float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+        if (d1 <= 0.0f && d2 <= 0.0f) return a;
+
+        glm::vec3 bp = p - b;
+        float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+        if (d3 >= 0.0f && d4 <= d3) return b;
+
+        float vc = d1 * d4 - d3 * d2;
+        if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return a + ab * (d1 / (d1 - d3));
+
+        glm::vec3 cp = p - c;
+        float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+        if (d6 >= 0.0f && d5 <= d6) return c;
+
+        float vb = d5 * d2 - d1 * d6;
+        if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return a + ac * (d2 / (d2 - d6));
+
+        float va = d3 * d6 - d5 * d4;
+        if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+            return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+        float denominator = 1.0f / (va + vb + vc);
+        return a + ab * (vb * denominator) + ac * (vc * denominator);
+    }
+}
+
+/**
+ * @brief Appends the triangles of one indexed mesh.
+ * @param positions Model-space vertex positions.
+ * @param indices Triangle list indices into positions.
+ * @param mesh The id queries report for these triangles.
+ */
+void TriangleBVH::addMesh(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices,
+                          uint32_t mesh) {
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        tris.push_back({ positions[indices[i]], positions[indices[i + 1]], positions[indices[i + 2]] });
+        triMeshes.push_back(mesh);
+    }
+    meshTotal = std::max(meshTotal, mesh + 1);
+}
+
+/**
+ * @brief Drops the hierarchy and the triangles.
+ */
+void TriangleBVH::clear() {
+    nodes.clear();
+    tris.clear();
+    triMeshes.clear();
+    meshTotal = 0;
+    buildStats = BVHBuildStats();
+}
+
+/**
+ * @brief Builds the hierarchy over every added triangle.
+ */
+void TriangleBVH::build() {
+    auto start = std::chrono::steady_clock::now();
+    nodes.clear();
+    BVHBuildStats result;
+    result.triangles = static_cast<unsigned int>(tris.size());
+    if (tris.empty()) {
+        buildStats = result;
+        return;
+    }
+
+    uint32_t count = static_cast<uint32_t>(tris.size());
+    Builder builder(tris);
+    builder.triangleBounds.resize(count);
+    builder.centroids.resize(count);
+    builder.order.resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+        Bounds bounds;
+        bounds.grow(tris[i].v0);
+        bounds.grow(tris[i].v1);
+        bounds.grow(tris[i].v2);
+        builder.triangleBounds[i] = bounds;
+        builder.centroids[i] = (tris[i].v0 + tris[i].v1 + tris[i].v2) / 3.0f;
+        builder.order[i] = i;
+    }
+    // A binary tree over n leaves of at least one triangle has at most 2n - 1 nodes.
+    builder.nodes.resize(2 * static_cast<size_t>(count));
+    builder.buildNode(0, 0, count, 0);
+
+    // Workers took node pairs in whatever order they ran; lay the tree out
+    // depth-first, left child first, so a traversal mostly walks forward.
+    nodes.reserve(builder.nodeCount.load());
+    nodes.push_back(builder.nodes[0]);
+    struct Pending { uint32_t source; uint32_t target; unsigned int depth; };
+    std::vector<Pending> stack = { { 0, 0, 0 } };
+    while (!stack.empty()) {
+        Pending item = stack.back();
+        stack.pop_back();
+        result.maxDepth = std::max(result.maxDepth, item.depth);
+
+        const BVHNode& source = builder.nodes[item.source];
+        if (source.isLeaf()) {
+            result.leaves++;
+            continue;
+        }
+        uint32_t pair = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(builder.nodes[source.leftOrFirst]);
+        nodes.push_back(builder.nodes[source.leftOrFirst + 1]);
+        nodes[item.target].leftOrFirst = pair;
+        stack.push_back({ source.leftOrFirst + 1, pair + 1, item.depth + 1 });
+        stack.push_back({ source.leftOrFirst, pair, item.depth + 1 });
+    }
+    result.nodes = static_cast<unsigned int>(nodes.size());
+
+    // Store the triangles in leaf order.
+    std::vector<BVHTriangle> orderedTriangles(count);
+    std::vector<uint32_t> orderedMeshes(count);
+    for (uint32_t i = 0; i < count; i++) {
+        orderedTriangles[i] = tris[builder.order[i]];
+        orderedMeshes[i] = triMeshes[builder.order[i]];
+    }
+    tris.swap(orderedTriangles);
+    triMeshes.swap(orderedMeshes);
+
+    result.milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    buildStats = result;
+}
+
+/**
+ * @brief Marks the meshes that have geometry inside a frustum.
+ * @param viewProjectionModel Clip transform of the model's space; its planes are extracted as in FrustumCuller.
+ * @param visible Receives one flag per mesh.
+ */
+void TriangleBVH::queryFrustum(const glm::mat4& viewProjectionModel, std::vector<uint8_t>& visible) const {
+    visible.assign(meshTotal, 0);
+    if (nodes.empty()) return;
+
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(viewProjectionModel[0][i], viewProjectionModel[1][i], viewProjectionModel[2][i],
+                            viewProjectionModel[3][i]);
+    }
+    const glm::vec4 planes[6] = { rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1],
+                                  rows[3] - rows[1], rows[3] + rows[2], rows[3] - rows[2] };
+
+    uint32_t stack[TRAVERSAL_STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const BVHNode& node = nodes[stack[--top]];
+        if (!boxInFrustum(planes, node.boundsMin, node.boundsMax)) continue;
+
+        if (node.isLeaf()) {
+            for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++) {
+                visible[triMeshes[i]] = 1;
+            }
+        } else {
+            stack[top++] = node.leftOrFirst + 1;
+            stack[top++] = node.leftOrFirst;
+        }
+    }
+}
+
+/**
+ * @brief Finds the nearest triangle along a ray.
+ * @param origin Ray start in model space.
+ * @param direction Normalized ray direction.
+ * @param maxDistance Hits farther than this are ignored.
+ * @param hit Receives the nearest hit.
+ * @return True if anything was hit.
+ */
+bool TriangleBVH::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+                          BVHRayHit& hit) const {
+    if (nodes.empty()) return false;
+
+    glm::vec3 inverseDirection = 1.0f / direction;
+    float nearest = maxDistance;
+    bool found = false;
+
+    uint32_t stack[TRAVERSAL_STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const BVHNode& node = nodes[stack[--top]];
+        if (rayBox(origin, inverseDirection, nearest, node.boundsMin, node.boundsMax) == std::numeric_limits<float>::infinity()) {
+            continue;
+        }
+
+        if (node.isLeaf()) {
+            for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++) {
+                float distance;
+                if (rayTriangle(origin, direction, tris[i], distance) && distance < nearest) {
+                    nearest = distance;
+                    hit.distance = distance;
+                    hit.triangle = i;
+                    hit.mesh = triMeshes[i];
+                    found = true;
+                }
+            }
+            continue;
+        }
+
+        // Visit the nearer child first so its hits shrink the search for the other.
+        uint32_t left = node.leftOrFirst;
+        float leftEnter = rayBox(origin, inverseDirection, nearest, nodes[left].boundsMin, nodes[left].boundsMax);
+        float rightEnter = rayBox(origin, inverseDirection, nearest, nodes[left + 1].boundsMin, nodes[left + 1].boundsMax);
+        bool leftFirst = leftEnter <= rightEnter;
+        float firstEnter = leftFirst ? leftEnter : rightEnter;
+        float secondEnter = leftFirst ? rightEnter : leftEnter;
+        if (secondEnter != std::numeric_limits<float>::infinity()) stack[top++] = leftFirst ? left + 1 : left;
+        if (firstEnter != std::numeric_limits<float>::infinity()) stack[top++] = leftFirst ? left : left + 1;
+    }
+    return found;
+}
+
+/**
+ * @brief Collects the triangles that touch a sphere.
+ * @param center Sphere center in model space.
+ * @param radius Sphere radius.
+ * @param out Receives indices into triangles().
+ * @return True if at least one triangle overlaps.
+ */
+bool TriangleBVH::overlapSphere(const glm::vec3& center, float radius, std::vector<uint32_t>& out) const {
+    if (nodes.empty()) return false;
+
+    float radiusSquared = radius * radius;
+    size_t before = out.size();
+
+    uint32_t stack[TRAVERSAL_STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const BVHNode& node = nodes[stack[--top]];
+        glm::vec3 closest = glm::clamp(center, node.boundsMin, node.boundsMax);
+        glm::vec3 offset = closest - center;
+        if (glm::dot(offset, offset) > radiusSquared) continue;
+
+        if (node.isLeaf()) {
+            for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++) {
+                glm::vec3 d = closestPointOnTriangle(center, tris[i]) - center;
+                if (glm::dot(d, d) <= radiusSquared) {
+                    out.push_back(i);
+                }
+            }
+        } else {
+            stack[top++] = node.leftOrFirst + 1;
+            stack[top++] = node.leftOrFirst;
+        }
+    }
+    return out.size() > before;
+}
+
+/**
+ * @brief Writes the hierarchy, the ordered triangles and their mesh ids.
+ */
+void TriangleBVH::serialize(std::vector<uint8_t>& out) const {
+    SerializedHeader header;
+    std::memcpy(header.magic, BVH_MAGIC, sizeof(header.magic));
+    header.nodeCount = static_cast<uint32_t>(nodes.size());
+    header.triangleCount = static_cast<uint32_t>(tris.size());
+    header.meshCount = meshTotal;
+
+    size_t nodeBytes = nodes.size() * sizeof(BVHNode);
+    size_t triangleBytes = tris.size() * sizeof(BVHTriangle);
+    size_t meshBytes = triMeshes.size() * sizeof(uint32_t);
+    out.resize(sizeof(header) + nodeBytes + triangleBytes + meshBytes);
+
+    uint8_t* cursor = out.data();
+    std::memcpy(cursor, &header, sizeof(header));
+    cursor += sizeof(header);
+    std::memcpy(cursor, nodes.data(), nodeBytes);
+    cursor += nodeBytes;
+    std::memcpy(cursor, tris.data(), triangleBytes);
+    cursor += triangleBytes;
+    std::memcpy(cursor, triMeshes.data(), meshBytes);
+}
+
+/**
+ * @brief Restores a hierarchy written by serialize.
+ *
+ * The queries index triangles and meshes and push onto fixed stacks without
+ * checks, so every node of the image is validated before it is accepted.
+ *
+ * @return False if the data is truncated, not a BVH image or inconsistent.
+ */
+bool TriangleBVH::deserialize(const uint8_t* data, size_t size) {
+    clear();
+    SerializedHeader header;
+    if (size < sizeof(header)) return false;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, BVH_MAGIC, sizeof(header.magic)) != 0) return false;
+
+    size_t nodeBytes = static_cast<size_t>(header.nodeCount) * sizeof(BVHNode);
+    size_t triangleBytes = static_cast<size_t>(header.triangleCount) * sizeof(BVHTriangle);
+    size_t meshBytes = static_cast<size_t>(header.triangleCount) * sizeof(uint32_t);
+    if (sizeof(header) + nodeBytes + triangleBytes + meshBytes != size) return false;
+
+    const uint8_t* cursor = data + sizeof(header);
+    nodes.resize(header.nodeCount);
+    std::memcpy(nodes.data(), cursor, nodeBytes);
+    cursor += nodeBytes;
+    tris.resize(header.triangleCount);
+    std::memcpy(tris.data(), cursor, triangleBytes);
+    cursor += triangleBytes;
+    triMeshes.resize(header.triangleCount);
+    std::memcpy(triMeshes.data(), cursor, meshBytes);
+    meshTotal = header.meshCount;
+
+    for (uint32_t mesh : triMeshes) {
+        if (mesh >= meshTotal) {
+            clear();
+            return false;
+        }
+    }
+
+    // Walk the hierarchy the way the queries do; the root is depth 1, and a
+    // leaf at depth n needs n stack entries.
+    struct Pending { uint32_t node; unsigned int depth; };
+    std::vector<Pending> pending;
+    std::vector<uint8_t> reached(nodes.size(), 0);
+    if (!nodes.empty()) {
+        pending.push_back({ 0, 1 });
+        reached[0] = 1;
+    }
+    while (!pending.empty()) {
+        Pending item = pending.back();
+        pending.pop_back();
+        const BVHNode& node = nodes[item.node];
+        bool valid = item.depth <= static_cast<unsigned int>(TRAVERSAL_STACK_SIZE);
+        if (valid && node.isLeaf()) {
+            valid = node.leftOrFirst <= header.triangleCount && node.count <= header.triangleCount - node.leftOrFirst;
+        } else if (valid) {
+            // Both children exist and each node has a single parent, which also rules out cycles.
+            uint32_t left = node.leftOrFirst;
+            valid = left < nodes.size() - 1 && !reached[left] && !reached[left + 1];
+            if (valid) {
+                reached[left] = reached[left + 1] = 1;
+                pending.push_back({ left, item.depth + 1 });
+                pending.push_back({ left + 1, item.depth + 1 });
+            }
+        }
+        if (!valid) {
+            clear();
+            return false;
+        }
+    }
+
+    buildStats.triangles = header.triangleCount;
+    buildStats.nodes = header.nodeCount;
+    buildStats.fromCache = true;
+    return true;
+}
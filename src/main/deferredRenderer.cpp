@@ -0,0 +1,256 @@
+/**
+ * @file deferredRenderer.cpp
+ * @brief G-buffer, light volume accumulation and resolve of the deferred path.
+ *
+ * The forward level shader loops over the cluster list of every fragment it
+ * shades, including the ones later overdrawn. Here the geometry pass only
+ * stores surface attributes, and each light is rasterized once as a sphere
+ * over the pixels it can reach, so lighting cost follows visible pixels times
+ * local lights instead of shaded fragments times local lights.
+ */
+
+#include "deferredRenderer.h"
+#include "shaderVariants.h"
+#include "frameConstants.h"
+#include "glState.h"
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+/**
+ * @brief Creates the render targets, the light volume mesh and the pass programs.
+ * @param width Internal render width in pixels.
+ * @param height Internal render height in pixels.
+ */
+DeferredRenderer::DeferredRenderer(int width, int height)
+    : width(width), height(height) {
+    createTargets();
+    createSphere(8, 12);
+
+    glGenVertexArrays(1, &emptyVAO);
+
+    lightVolumeShader = new Shader("shaders/deferred/lightVolumeVs.glsl", "shaders/deferred/lightVolumeFs.glsl",
+                                   shaderVariantHeader(SHADER_FEATURE_POINT_LIGHTS));
+    resolveShader = new Shader("shaders/deferred/resolveVs.glsl", "shaders/deferred/resolveFs.glsl",
+                               shaderVariantHeader(SHADER_FEATURE_QUANTIZE | SHADER_FEATURE_FOG));
+
+    // Sampler units never change, so they are program state set once.
+    for (Shader* shader : { lightVolumeShader, resolveShader }) {
+        shader->bindUniformBlock("FrameConstants", FRAME_CONSTANTS_BINDING);
+        shader->use();
+        shader->setInt("gAlbedo", GBUFFER_ALBEDO_TEXTURE_UNIT);
+        shader->setInt("gNormal", GBUFFER_NORMAL_TEXTURE_UNIT);
+        shader->setInt("gDepth", GBUFFER_DEPTH_TEXTURE_UNIT);
+    }
+    lightVolumeShader->setInt("lightData", LIGHT_DATA_TEXTURE_UNIT);
+    lightVolumeShader->setFloat("volumeScale", sphereScale);
+    resolveShader->use();
+    resolveShader->setInt("lightAccumulation", LIGHT_ACCUMULATION_TEXTURE_UNIT);
+    volumeInverseViewProjection = lightVolumeShader->uniform("inverseViewProjection");
+    volumeMaxRange = lightVolumeShader->uniform("maxRange");
+    resolveInverseViewProjection = resolveShader->uniform("inverseViewProjection");
+    resolveViewportSize = resolveShader->uniform("viewportSize");
+    glState().useProgram(0);
+}
+
+/**
+ * @brief Releases the framebuffers, textures, buffers and programs.
+ */
+DeferredRenderer::~DeferredRenderer() {
+    delete lightVolumeShader;
+    delete resolveShader;
+
+    GLuint framebuffers[] = { gBuffer, lightBuffer };
+    glDeleteFramebuffers(2, framebuffers);
+    GLuint textures[] = { albedoTexture, normalTexture, depthTexture, lightTexture };
+    glDeleteTextures(4, textures);
+    glDeleteRenderbuffers(1, &lightDepth);
+    GLuint buffers[] = { sphereVBO, sphereEBO };
+    glDeleteBuffers(2, buffers);
+    GLuint vertexArrays[] = { sphereVAO, emptyVAO };
+    glDeleteVertexArrays(2, vertexArrays);
+}
+
+/**
+ * @brief Allocates one nearest-filtered, edge-clamped 2D texture.
+ */
+GLuint DeferredRenderer::createTexture(GLenum internalFormat, GLenum format, GLenum type, int width, int height) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+/**
+ * @brief Creates the G-buffer and the light accumulation framebuffer.
+ *
+ * The light pass samples the G-buffer depth, so it cannot also have that
+ * texture attached; it depth tests against a renderbuffer of the same format
+ * that the geometry depth is blitted into.
+ */
+void DeferredRenderer::createTargets() {
+    albedoTexture = createTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+    normalTexture = createTexture(GL_RGB10_A2, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV, width, height);
+    depthTexture = createTexture(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, width, height);
+    lightTexture = createTexture(GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, width, height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &gBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+    const GLenum attachments[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, attachments);
+    bool gBufferComplete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+    glGenFramebuffers(1, &lightBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, lightBuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, lightTexture, 0);
+    glGenRenderbuffers(1, &lightDepth);
+    glBindRenderbuffer(GL_RENDERBUFFER, lightDepth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, lightDepth);
+    bool lightBufferComplete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    complete = gBufferComplete && lightBufferComplete;
+    if (!complete) {
+        std::cerr << "ERROR::DEFERRED::FRAMEBUFFER_INCOMPLETE" << std::endl;
+    }
+}
+
+/**
+ * @brief Builds a unit UV sphere used as the volume of every point light.
+ * @param rings Latitude bands.
+ * @param segments Longitude slices.
+ */
+void DeferredRenderer::createSphere(int rings, int segments) {
+    const float pi = 3.14159265358979f;
+
+    std::vector<glm::vec3> vertices;
+    for (int ring = 0; ring <= rings; ring++) {
+        float phi = pi * ring / rings;
+        for (int segment = 0; segment <= segments; segment++) {
+            float theta = 2.0f * pi * segment / segments;
+            vertices.emplace_back(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta));
+        }
+    }
+
+    // Counter-clockwise seen from outside, so culling front faces keeps the far side.
+    std::vector<unsigned int> indices;
+    for (int ring = 0; ring < rings; ring++) {
+        for (int segment = 0; segment < segments; segment++) {
+            unsigned int a = ring * (segments + 1) + segment;
+            unsigned int b = a + segments + 1;
+            indices.insert(indices.end(), { a, a + 1, b, b, a + 1, b + 1 });
+        }
+    }
+    sphereIndexCount = static_cast<GLsizei>(indices.size());
+
+    // The flat faces sit inside the sphere through their vertices; scaling by
+    // the inverse cosine of half the angular step along both axes moves every
+    // face out past it.
+    sphereScale = 1.0f / (std::cos(pi / segments) * std::cos(pi / (2.0f * rings)));
+
+    glGenVertexArrays(1, &sphereVAO);
+    glGenBuffers(1, &sphereVBO);
+    glGenBuffers(1, &sphereEBO);
+
+    glBindVertexArray(sphereVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, sphereVBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphereEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/**
+ * @brief Binds the G-buffer at the internal resolution and clears it.
+ */
+void DeferredRenderer::beginGeometry() {
+    glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+    glViewport(0, 0, width, height);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+/**
+ * @brief Accumulates the point lights, then composes the frame into the default framebuffer.
+ * @param clusters The clusters built this frame; their light data holds the visible lights in order.
+ * @param view The camera view matrix.
+ * @param projection The camera projection matrix.
+ * @param farPlane Range cap for lights that never fall off.
+ * @param viewport The window viewport to restore for the resolve.
+ */
+void DeferredRenderer::lightAndResolve(const LightClusters& clusters, const glm::mat4& view,
+                                       const glm::mat4& projection, float farPlane, const GLint viewport[4]) {
+    glm::mat4 inverseViewProjection = glm::inverse(projection * view);
+
+    GLStateCache& state = glState();
+    state.bindTexture(GBUFFER_ALBEDO_TEXTURE_UNIT, GL_TEXTURE_2D, albedoTexture);
+    state.bindTexture(GBUFFER_NORMAL_TEXTURE_UNIT, GL_TEXTURE_2D, normalTexture);
+    state.bindTexture(GBUFFER_DEPTH_TEXTURE_UNIT, GL_TEXTURE_2D, depthTexture);
+
+    // Light pass: back faces that lie behind the stored surface cover exactly
+    // the pixels inside the volume, whether or not the camera is inside it.
+    glBindFramebuffer(GL_FRAMEBUFFER, lightBuffer);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    GLsizei lightCount = static_cast<GLsizei>(clusters.stats().visibleLights);
+    if (lightCount > 0) {
+        // The volumes test against a copy: attaching the sampled depth texture would be a feedback loop.
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, gBuffer);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, lightBuffer);
+
+        state.depthMask(false);
+        state.depthFunc(GL_GREATER);
+        state.setCapability(GL_CULL_FACE, true);
+        state.cullFace(GL_FRONT);
+        state.setCapability(GL_BLEND, true);
+        state.blendFunc(GL_ONE, GL_ONE);
+        // Volumes poking through the far plane still need their back faces.
+        state.setCapability(GL_DEPTH_CLAMP, true);
+
+        lightVolumeShader->use();
+        lightVolumeShader->setMat4(volumeInverseViewProjection, inverseViewProjection);
+        lightVolumeShader->setFloat(volumeMaxRange, farPlane);
+        state.bindVertexArray(sphereVAO);
+        glDrawElementsInstanced(GL_TRIANGLES, sphereIndexCount, GL_UNSIGNED_INT, 0, lightCount);
+
+        state.setCapability(GL_DEPTH_CLAMP, false);
+        state.setCapability(GL_BLEND, false);
+        state.cullFace(GL_BACK);
+        state.setCapability(GL_CULL_FACE, false);
+        state.depthMask(true);
+    }
+
+    // Resolve: every covered window pixel is shaded once and takes the
+    // G-buffer depth, so forward passes drawn next are occluded by the level.
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    state.bindTexture(LIGHT_ACCUMULATION_TEXTURE_UNIT, GL_TEXTURE_2D, lightTexture);
+    state.depthFunc(GL_ALWAYS);
+
+    resolveShader->use();
+    resolveShader->setMat4(resolveInverseViewProjection, inverseViewProjection);
+    resolveShader->setVec2(resolveViewportSize, glm::vec2(viewport[2], viewport[3]));
+    state.bindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    state.depthFunc(GL_LESS);
+    state.bindVertexArray(0);
+}
@@ -0,0 +1,146 @@
+/**
+ * @file frustumCuller.cpp
+ * @brief Tests batches of world-space bounds against the view frustum.
+ *
+ * The planes come straight from the rows of the view-projection matrix, so
+ * the culler needs nothing from the camera beyond what the shaders use.
+ */
+
+#include "frustumCuller.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRUSTUM_CULLER_SSE 1
+#endif
+
+/**
+ * @brief Extracts the six normalized planes of a view-projection matrix.
+ * @param viewProjection The projection times the view matrix.
+ * @param planes Receives left, right, bottom, top, near and far; xyz points inward.
+ */
+void extractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]) {
+    // glm is column-major: row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i]).
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    }
+    planes[0] = rows[3] + rows[0]; // left
+    planes[1] = rows[3] - rows[0]; // right
+    planes[2] = rows[3] + rows[1]; // bottom
+    planes[3] = rows[3] - rows[1]; // top
+    planes[4] = rows[3] + rows[2]; // near
+    planes[5] = rows[3] - rows[2]; // far
+    for (int i = 0; i < 6; i++) {
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+    }
+}
+
+/**
+ * @brief Extracts the frustum planes of this frame and drops the previous bounds.
+ * @param viewProjection The projection times the view matrix.
+ */
+void FrustumCuller::begin(const glm::mat4& viewProjection) {
+    extractFrustumPlanes(viewProjection, planes);
+
+    centerX.clear();
+    centerY.clear();
+    centerZ.clear();
+    extentX.clear();
+    extentY.clear();
+    extentZ.clear();
+    radius.clear();
+    count = 0;
+}
+
+/**
+ * @brief Appends the world-space bounds of one draw.
+ * @return The index to query with visible() after cull().
+ */
+uint32_t FrustumCuller::add(const glm::vec3& center, const glm::vec3& halfExtent, float sphereRadius) {
+    centerX.push_back(center.x);
+    centerY.push_back(center.y);
+    centerZ.push_back(center.z);
+    extentX.push_back(halfExtent.x);
+    extentY.push_back(halfExtent.y);
+    extentZ.push_back(halfExtent.z);
+    radius.push_back(sphereRadius);
+    return static_cast<uint32_t>(count++);
+}
+
+/**
+ * @brief Classifies every added bound as visible or culled.
+ */
+void FrustumCuller::cull() {
+    CullStats frameStats;
+    frameStats.tested = static_cast<unsigned int>(count);
+
+    // Pad to whole SIMD groups; padding lanes are never read back.
+    size_t padded = (count + 3) & ~size_t(3);
+    for (std::vector<float>* column : { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ, &radius }) {
+        column->resize(padded, 0.0f);
+    }
+    visibility.assign(padded, 0);
+
+#ifdef FRUSTUM_CULLER_SSE
+    const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    __m128 nx[6], ny[6], nz[6], nw[6], ax[6], ay[6], az[6];
+    for (int p = 0; p < 6; p++) {
+        nx[p] = _mm_set1_ps(planes[p].x);
+        ny[p] = _mm_set1_ps(planes[p].y);
+        nz[p] = _mm_set1_ps(planes[p].z);
+        nw[p] = _mm_set1_ps(planes[p].w);
+        ax[p] = _mm_and_ps(nx[p], signMask);
+        ay[p] = _mm_and_ps(ny[p], signMask);
+        az[p] = _mm_and_ps(nz[p], signMask);
+    }
+
+    for (size_t i = 0; i < padded; i += 4) {
+        __m128 cx = _mm_loadu_ps(&centerX[i]);
+        __m128 cy = _mm_loadu_ps(&centerY[i]);
+        __m128 cz = _mm_loadu_ps(&centerZ[i]);
+        __m128 ex = _mm_loadu_ps(&extentX[i]);
+        __m128 ey = _mm_loadu_ps(&extentY[i]);
+        __m128 ez = _mm_loadu_ps(&extentZ[i]);
+        __m128 r = _mm_loadu_ps(&radius[i]);
+
+        __m128 outside = _mm_setzero_ps();
+        for (int p = 0; p < 6; p++) {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[p], cx), _mm_mul_ps(ny[p], cy)),
+                                         _mm_add_ps(_mm_mul_ps(nz[p], cz), nw[p]));
+            // Projected box half-size along the normal; the tighter of box and sphere decides.
+            __m128 boxReach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax[p], ex), _mm_mul_ps(ay[p], ey)),
+                                         _mm_mul_ps(az[p], ez));
+            __m128 reach = _mm_min_ps(boxReach, r);
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, _mm_sub_ps(_mm_setzero_ps(), reach)));
+        }
+
+        int mask = _mm_movemask_ps(outside);
+        for (int lane = 0; lane < 4; lane++) {
+            visibility[i + lane] = (mask & (1 << lane)) ? 0 : 1;
+        }
+    }
+#else
+    for (size_t i = 0; i < count; i++) {
+        bool outside = false;
+        for (const glm::vec4& plane : planes) {
+            float distance = plane.x * centerX[i] + plane.y * centerY[i] + plane.z * centerZ[i] + plane.w;
+            float boxReach = std::abs(plane.x) * extentX[i] + std::abs(plane.y) * extentY[i] +
+                             std::abs(plane.z) * extentZ[i];
+            if (distance < -std::min(boxReach, radius[i])) {
+                outside = true;
+                break;
+            }
+        }
+        visibility[i] = outside ? 0 : 1;
+    }
+#endif
+
+    for (size_t i = 0; i < count; i++) {
+        frameStats.visible += visibility[i];
+    }
+    frameStats.culled = frameStats.tested - frameStats.visible;
+    lastStats = frameStats;
+}
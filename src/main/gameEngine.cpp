@@ -1,5 +1,7 @@
 #include "gameEngine.h"
 #include "config.h"
+#include "glCaps.h"
+#include "glState.h"
 #include "items.h"
 #include <iostream>
 #include <random>
@@ -14,6 +16,7 @@ GameEngine::GameEngine()
     : window(nullptr),
       inputHandler(nullptr),
       renderer(nullptr),
+      textureLoader(nullptr),
       audioManager(nullptr),
       gui(nullptr)
 {
@@ -36,7 +39,7 @@ bool GameEngine::initialize() {
         return false;
     }
 
-    glEnable(GL_DEPTH_TEST);
+    glState().setCapability(GL_DEPTH_TEST, true);
     
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -46,19 +49,30 @@ bool GameEngine::initialize() {
     inputHandler = new InputHandler(&gameState);
     inputHandler->setupCallbacks(window);
 
-    renderer = new Renderer(&gameState);
+    // Images decode on worker threads; models and the GUI get placeholders until they land.
+    textureLoader = new TextureLoader();
+
+    renderer = new Renderer(&gameState, textureLoader);
     if (!renderer->initializeShaders() || !renderer->loadModels()) {
         std::cerr << "FATAL: Failed to initialize renderer" << std::endl;
         return false;
     }
 
+    // A level split into rooms bounds the player by its rooms instead of
+    // BOUNDARY_LIMIT, and only objects in rooms in view can be interacted with.
+    if (renderer->hasLevelSectors()) {
+        gameState.walkable = [this](const glm::vec3& position) { return renderer->isWalkable(position); };
+        gameState.interactionSystem.SetReachableTest(
+            [this](const glm::vec3& position) { return renderer->isReachable(position); });
+    }
+
     if (!initializeAudio() || !loadAudioAssets()) {
         std::cerr << "FATAL: Failed to initialize audio systems" << std::endl;
         return false;
     }
 
     gui = new GUI();
-    if (!gui->Initialize(window)) {
+    if (!gui->Initialize(window, textureLoader)) {
         std::cerr << "FATAL: Failed to initialize GUI" << std::endl;
         return false;
     };
@@ -87,7 +101,8 @@ void GameEngine::run() {
         // 3. Update systems that depend on game state (e.g., audio).
         handleMovementAudio();
         
-        // 4. Render the scene and UI.
+        // 4. Upload textures that finished decoding, then render the scene and UI.
+        textureLoader->update();
         renderer->render();
         gui->NewFrame();
         gui->Render(&gameState);
@@ -116,6 +131,11 @@ void GameEngine::cleanup() {
         delete renderer;
         renderer = nullptr;
     }
+    // Owns the GL textures, so it goes after its users but before the context.
+    if (textureLoader) {
+        delete textureLoader;
+        textureLoader = nullptr;
+    }
     if (audioManager) {
         delete audioManager;
         audioManager = nullptr;
@@ -138,12 +158,17 @@ GLFWwindow* GameEngine::initializeGLFW() {
         return nullptr;
     }
 
-    // Request a specific OpenGL version (e.g., 3.3 Core Profile).
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-    GLFWwindow* newWindow = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "PS1 Level Viewer", nullptr, nullptr);
+    // Ask for 4.3 Core first, which enables the GPU-driven level (see indirectScene.h);
+    // 3.3 Core is the baseline everything else needs.
+    const int versions[][2] = { { 4, 3 }, { 3, 3 } };
+    GLFWwindow* newWindow = nullptr;
+    for (const auto& version : versions) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, version[0]);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, version[1]);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        newWindow = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "PS1 Level Viewer", nullptr, nullptr);
+        if (newWindow) break;
+    }
     if (!newWindow) {
         std::cerr << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
@@ -166,6 +191,7 @@ bool GameEngine::initializeGLAD() {
         std::cerr << "Failed to initialize GLAD" << std::endl;
         return false;
     }
+    initializeGLCaps();
     return true;
 }
 
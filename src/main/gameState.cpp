@@ -23,10 +23,16 @@ GameState::GameState()
       awaitingRelock(false),
       eKeyPressed(false),
       tabKeyPressed(false),
+      renderPathKeyPressed(false),
+      depthPrepassKeyPressed(false),
+      occlusionKeyPressed(false),
+      gpuDrivenKeyPressed(false),
       lastCameraPos(camera.Position),
       stepCooldown(0.0f),
       bobTimer(0.0f),
-      projection(glm::mat4(1.0f))
+      projection(glm::mat4(1.0f)),
+      depthPrepass(DEPTH_PREPASS_DEFAULT),
+      gpuDriven(GPU_DRIVEN_DEFAULT)
 {
     // Initialize the projection matrix with the screen dimensions and camera properties.
     float aspect = (float)SCR_WIDTH / (float)SCR_HEIGHT;
@@ -55,11 +61,30 @@ void GameState::updateMovement() {
     glm::vec3 baseCameraPos = camera.Position;
     baseCameraPos.y = CAMERA_HEIGHT; // Enforce a fixed height from the ground.
     
-    // Clamp the player's position to the defined world boundaries.
-    if (baseCameraPos.x > BOUNDARY_LIMIT) baseCameraPos.x = BOUNDARY_LIMIT;
-    if (baseCameraPos.x < -BOUNDARY_LIMIT) baseCameraPos.x = -BOUNDARY_LIMIT;
-    if (baseCameraPos.z > BOUNDARY_LIMIT) baseCameraPos.z = BOUNDARY_LIMIT;
-    if (baseCameraPos.z < -BOUNDARY_LIMIT) baseCameraPos.z = -BOUNDARY_LIMIT;
+    if (walkable) {
+        // Keep the player in the level's rooms, sliding along whatever blocks one axis.
+        // A player already off walkable ground (e.g. spawned outside every room)
+        // moves freely until back on it instead of being frozen in place.
+        glm::vec3 lastGroundPos(lastCameraPos.x, baseCameraPos.y, lastCameraPos.z);
+        if (!walkable(baseCameraPos) && walkable(lastGroundPos)) {
+            glm::vec3 alongX(baseCameraPos.x, baseCameraPos.y, lastCameraPos.z);
+            glm::vec3 alongZ(lastCameraPos.x, baseCameraPos.y, baseCameraPos.z);
+            if (walkable(alongX)) {
+                baseCameraPos = alongX;
+            } else if (walkable(alongZ)) {
+                baseCameraPos = alongZ;
+            } else {
+                baseCameraPos.x = lastCameraPos.x;
+                baseCameraPos.z = lastCameraPos.z;
+            }
+        }
+    } else {
+        // Clamp the player's position to the defined world boundaries.
+        if (baseCameraPos.x > BOUNDARY_LIMIT) baseCameraPos.x = BOUNDARY_LIMIT;
+        if (baseCameraPos.x < -BOUNDARY_LIMIT) baseCameraPos.x = -BOUNDARY_LIMIT;
+        if (baseCameraPos.z > BOUNDARY_LIMIT) baseCameraPos.z = BOUNDARY_LIMIT;
+        if (baseCameraPos.z < -BOUNDARY_LIMIT) baseCameraPos.z = -BOUNDARY_LIMIT;
+    }
     
     // Apply the bounded position back to the camera.
     camera.Position = baseCameraPos;
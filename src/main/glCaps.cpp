@@ -0,0 +1,54 @@
+/**
+ * @file glCaps.cpp
+ * @brief Queries the OpenGL implementation's version, identity and optional features.
+ */
+
+#include "glCaps.h"
+
+#include <iostream>
+
+namespace {
+    GLCaps caps;
+
+    std::string glString(GLenum name) {
+        const GLubyte* value = glGetString(name);
+        return value ? reinterpret_cast<const char*>(value) : "";
+    }
+}
+
+/**
+ * @brief Records what the current context supports and enables parallel shader compilation.
+ */
+void initializeGLCaps() {
+    caps = GLCaps();
+    caps.major = GLVersion.major;
+    caps.minor = GLVersion.minor;
+    caps.vendor = glString(GL_VENDOR);
+    caps.renderer = glString(GL_RENDERER);
+    caps.version = glString(GL_VERSION);
+    caps.glslVersion = glString(GL_SHADING_LANGUAGE_VERSION);
+
+    caps.programBinary = GLAD_GL_VERSION_4_1 || GLAD_GL_ARB_get_program_binary;
+    if (caps.programBinary) {
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &caps.programBinaryFormats);
+    }
+
+    caps.parallelShaderCompile = GLAD_GL_KHR_parallel_shader_compile || GLAD_GL_ARB_parallel_shader_compile;
+    // Let the driver use as many compiler threads as it likes.
+    if (GLAD_GL_KHR_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+    } else if (GLAD_GL_ARB_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFFu);
+    }
+    caps.bufferStorage = GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage;
+    caps.textureBufferRange = GLAD_GL_VERSION_4_3 || GLAD_GL_ARB_texture_buffer_range;
+
+    std::cout << "OpenGL " << caps.version << " (" << caps.vendor << ", " << caps.renderer << ")" << std::endl;
+}
+
+/**
+ * @brief Returns the capabilities recorded by initializeGLCaps.
+ */
+const GLCaps& glCaps() {
+    return caps;
+}
@@ -0,0 +1,240 @@
+/**
+ * @file glState.cpp
+ * @brief Implements the redundant GL state filter and its per-frame counters.
+ *
+ * Every subsystem sets the state it needs before drawing instead of relying
+ * on what the previous one left behind, which is robust but repeats most
+ * calls. Filtering them here keeps that robustness and makes the repeats free.
+ */
+
+#include "glState.h"
+
+#include <iterator>
+
+namespace {
+    GLStateCache cache;
+
+    const GLenum CACHED_CAPABILITIES[] = { GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE, GL_DEPTH_CLAMP };
+    const int CACHED_CAPABILITY_COUNT = static_cast<int>(std::size(CACHED_CAPABILITIES));
+
+    /**
+     * @brief Slot of a cached capability, or -1.
+     */
+    int capabilitySlot(GLenum capability) {
+        for (int i = 0; i < CACHED_CAPABILITY_COUNT; i++) {
+            if (CACHED_CAPABILITIES[i] == capability) return i;
+        }
+        return -1;
+    }
+}
+
+/**
+ * @brief Returns a short name of a call kind for statistics output.
+ */
+const char* glStateCallName(GLStateCall call) {
+    switch (call) {
+        case GLStateCall::Program: return "program";
+        case GLStateCall::VertexArray: return "vertex array";
+        case GLStateCall::ActiveTexture: return "active texture";
+        case GLStateCall::BindTexture: return "texture";
+        case GLStateCall::Capability: return "enable/disable";
+        case GLStateCall::BlendFunc: return "blend func";
+        case GLStateCall::DepthMask: return "depth mask";
+        case GLStateCall::DepthFunc: return "depth func";
+        case GLStateCall::CullFace: return "cull face";
+        case GLStateCall::ColorMask: return "color mask";
+        default: return "unknown";
+    }
+}
+
+/**
+ * @brief Sum of the issued calls of all kinds.
+ */
+unsigned int GLStateStats::totalIssued() const {
+    unsigned int total = 0;
+    for (unsigned int count : issued) total += count;
+    return total;
+}
+
+/**
+ * @brief Sum of the elided calls of all kinds.
+ */
+unsigned int GLStateStats::totalElided() const {
+    unsigned int total = 0;
+    for (unsigned int count : elided) total += count;
+    return total;
+}
+
+/**
+ * @brief Records a call and decides whether it reaches GL.
+ * @param call The kind of call, for the counters.
+ * @param cached The cached value, replaced by value.
+ * @param value The requested value.
+ * @return True if the value differs and the call must be issued.
+ */
+bool GLStateCache::change(GLStateCall call, GLuint& cached, GLuint value) {
+    size_t kind = static_cast<size_t>(call);
+    if (cached == value) {
+        frame.elided[kind]++;
+        return false;
+    }
+    cached = value;
+    frame.issued[kind]++;
+    return true;
+}
+
+/**
+ * @brief Binds a program.
+ */
+void GLStateCache::useProgram(GLuint name) {
+    if (change(GLStateCall::Program, program, name)) {
+        glUseProgram(name);
+    }
+}
+
+/**
+ * @brief Binds a vertex array object.
+ */
+void GLStateCache::bindVertexArray(GLuint name) {
+    if (change(GLStateCall::VertexArray, vertexArray, name)) {
+        glBindVertexArray(name);
+    }
+}
+
+/**
+ * @brief Makes a texture unit active.
+ */
+void GLStateCache::activeTexture(GLuint unit) {
+    if (change(GLStateCall::ActiveTexture, activeUnit, unit)) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+}
+
+/**
+ * @brief Binds a texture to a unit.
+ * @param unit The texture unit index.
+ * @param target GL_TEXTURE_2D and GL_TEXTURE_BUFFER are cached; other targets are always bound.
+ * @param texture The texture name.
+ */
+void GLStateCache::bindTexture(GLuint unit, GLenum target, GLuint texture) {
+    GLuint* slot = nullptr;
+    if (unit < TRACKED_UNITS) {
+        if (target == GL_TEXTURE_2D) slot = &textures2D[unit];
+        else if (target == GL_TEXTURE_BUFFER) slot = &textureBuffers[unit];
+    }
+
+    if (slot) {
+        if (!change(GLStateCall::BindTexture, *slot, texture)) return;
+    } else {
+        frame.issued[static_cast<size_t>(GLStateCall::BindTexture)]++;
+    }
+    activeTexture(unit);
+    glBindTexture(target, texture);
+}
+
+/**
+ * @brief Enables or disables a capability.
+ */
+void GLStateCache::setCapability(GLenum capability, bool enabled) {
+    static_assert(CACHED_CAPABILITY_COUNT == TRACKED_CAPABILITIES, "every cached capability needs a slot");
+    int slot = capabilitySlot(capability);
+    if (slot >= 0 && !change(GLStateCall::Capability, capabilities[slot], enabled ? 1u : 0u)) return;
+    if (slot < 0) {
+        frame.issued[static_cast<size_t>(GLStateCall::Capability)]++;
+    }
+    if (enabled) {
+        glEnable(capability);
+    } else {
+        glDisable(capability);
+    }
+}
+
+/**
+ * @brief Sets the blend factors.
+ */
+void GLStateCache::blendFunc(GLenum source, GLenum destination) {
+    if (blendSource == source && blendDestination == destination) {
+        frame.elided[static_cast<size_t>(GLStateCall::BlendFunc)]++;
+        return;
+    }
+    blendSource = source;
+    blendDestination = destination;
+    frame.issued[static_cast<size_t>(GLStateCall::BlendFunc)]++;
+    glBlendFunc(source, destination);
+}
+
+/**
+ * @brief Turns depth writes on or off.
+ */
+void GLStateCache::depthMask(bool enabled) {
+    if (change(GLStateCall::DepthMask, depthWrites, enabled ? 1u : 0u)) {
+        glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+    }
+}
+
+/**
+ * @brief Sets the depth comparison.
+ */
+void GLStateCache::depthFunc(GLenum function) {
+    if (change(GLStateCall::DepthFunc, depthFunction, function)) {
+        glDepthFunc(function);
+    }
+}
+
+/**
+ * @brief Sets which faces are culled.
+ */
+void GLStateCache::cullFace(GLenum face) {
+    if (change(GLStateCall::CullFace, cullFaceMode, face)) {
+        glCullFace(face);
+    }
+}
+
+/**
+ * @brief Turns writes to all color channels on or off.
+ */
+void GLStateCache::colorMask(bool enabled) {
+    if (change(GLStateCall::ColorMask, colorWrites, enabled ? 1u : 0u)) {
+        GLboolean write = enabled ? GL_TRUE : GL_FALSE;
+        glColorMask(write, write, write, write);
+    }
+}
+
+/**
+ * @brief Forgets every cached value.
+ */
+void GLStateCache::invalidate() {
+    program = UNKNOWN;
+    vertexArray = UNKNOWN;
+    activeUnit = UNKNOWN;
+    for (GLuint unit = 0; unit < TRACKED_UNITS; unit++) {
+        textures2D[unit] = UNKNOWN;
+        textureBuffers[unit] = UNKNOWN;
+    }
+    for (GLuint& capability : capabilities) {
+        capability = UNKNOWN;
+    }
+    blendSource = UNKNOWN;
+    blendDestination = UNKNOWN;
+    depthWrites = UNKNOWN;
+    depthFunction = UNKNOWN;
+    cullFaceMode = UNKNOWN;
+    colorWrites = UNKNOWN;
+    frame.invalidations++;
+}
+
+/**
+ * @brief Publishes the previous frame's counters and starts from unknown state.
+ */
+void GLStateCache::beginFrame() {
+    lastFrame = frame;
+    frame = GLStateStats();
+    invalidate();
+}
+
+/**
+ * @brief Returns the process-wide cache.
+ */
+GLStateCache& glState() {
+    return cache;
+}
@@ -0,0 +1,256 @@
+/**
+ * @file indirectScene.cpp
+ * @brief Implements GPU frustum culling and multi-draw indirect submission of static meshes.
+ *
+ * The command buffer is filled once at load with everything but the instance
+ * count. The cull pass only flips that count between zero and one, so the
+ * CPU never touches per-mesh data after the upload.
+ */
+
+#include "indirectScene.h"
+#include "renderQueue.h"
+#include "frustumCuller.h"
+#include "glState.h"
+
+#include <algorithm>
+
+namespace {
+    // Must match local_size_x in shaders/indirect/frustumCullCs.glsl.
+    const GLuint CULL_GROUP_SIZE = 64;
+
+    // Shader storage bindings of the cull pass.
+    const GLuint BOUNDS_BINDING = 0;
+    const GLuint COMMANDS_BINDING = 1;
+    const GLuint MASK_BINDING = 2;
+
+    size_t indexSize(GLenum indexType) {
+        return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+    }
+}
+
+/**
+ * @brief Builds the cull program; the buffers follow with the first cull.
+ */
+IndirectScene::IndirectScene() {
+    cullProgram = new Shader("shaders/indirect/frustumCullCs.glsl", std::string());
+    planesUniform = cullProgram->uniform("planes");
+    objectCountUniform = cullProgram->uniform("objectCount");
+    useMaskUniform = cullProgram->uniform("useMask");
+}
+
+/**
+ * @brief Releases the buffers and the cull program.
+ */
+IndirectScene::~IndirectScene() {
+    delete cullProgram;
+    GLuint buffers[] = { commandBuffer, boundsBuffer, instanceBuffer, maskBuffer };
+    for (GLuint buffer : buffers) {
+        if (buffer) glDeleteBuffers(1, &buffer);
+    }
+}
+
+/**
+ * @brief Whether the current context can run the GPU-driven path.
+ */
+bool IndirectScene::supported() {
+    return glCaps().atLeast(4, 3);
+}
+
+/**
+ * @brief Adds every mesh of a static model with its world bounds.
+ * @param model The model; its meshes must stay alive and in the pool.
+ * @param transform The model matrix, fixed for the lifetime of the scene.
+ */
+void IndirectScene::add(const Model& model, const glm::mat4& transform) {
+    glm::mat3 linear(transform);
+    float scale = glm::max(glm::length(linear[0]), glm::max(glm::length(linear[1]), glm::length(linear[2])));
+
+    for (size_t i = 0; i < model.meshes.size(); i++) {
+        const Mesh& mesh = model.meshes[i];
+        if (!mesh.geometry.valid() || !mesh.material) continue;
+
+        // Same bounds as the render queue: the box stays axis-aligned, the sphere grows with the largest scale.
+        glm::vec3 extent = (mesh.boundsMax - mesh.boundsMin) * 0.5f;
+        Object object;
+        object.mesh = &mesh;
+        object.meshIndex = static_cast<uint32_t>(i);
+        object.transform = transform * mesh.positionDecode;
+        object.center = glm::vec3(transform * glm::vec4(mesh.boundsCenter(), 1.0f));
+        object.halfExtent = glm::abs(linear[0]) * extent.x + glm::abs(linear[1]) * extent.y +
+                            glm::abs(linear[2]) * extent.z;
+        object.radius = mesh.boundsRadius * scale;
+        objects.push_back(object);
+    }
+    uploaded = false;
+}
+
+/**
+ * @brief Orders the objects into runs and uploads commands, bounds and instances.
+ */
+void IndirectScene::upload() {
+    uploaded = true;
+    runs.clear();
+    if (objects.empty()) return;
+
+    // One call per run needs its commands adjacent: material, then layout.
+    std::stable_sort(objects.begin(), objects.end(), [](const Object& a, const Object& b) {
+        if (a.mesh->material->id != b.mesh->material->id) return a.mesh->material->id < b.mesh->material->id;
+        if (a.mesh->geometry.format != b.mesh->geometry.format) {
+            return a.mesh->geometry.format < b.mesh->geometry.format;
+        }
+        return a.mesh->geometry.indexType < b.mesh->geometry.indexType;
+    });
+
+    std::vector<DrawCommand> commands;
+    std::vector<GpuBounds> bounds;
+    std::vector<InstanceData> instances;
+    uint32_t maxMeshIndex = 0;
+    for (uint32_t i = 0; i < objects.size(); i++) {
+        const Object& object = objects[i];
+        const MeshAllocation& geometry = object.mesh->geometry;
+
+        DrawCommand command;
+        command.count = static_cast<GLuint>(geometry.indexCount);
+        command.instanceCount = 1;
+        command.firstIndex = static_cast<GLuint>(geometry.indexOffset / indexSize(geometry.indexType));
+        command.baseVertex = geometry.baseVertex;
+        command.baseInstance = i;
+        commands.push_back(command);
+
+        bounds.push_back({ glm::vec4(object.center, object.radius), object.halfExtent, object.meshIndex });
+
+        instances.push_back({ object.transform, glm::vec4(1.0f, 0.0f, 0.0f, 0.0f) });
+        maxMeshIndex = std::max(maxMeshIndex, object.meshIndex);
+
+        bool extends = !runs.empty() &&
+                       runs.back().material == object.mesh->material &&
+                       runs.back().format == geometry.format &&
+                       runs.back().indexType == geometry.indexType;
+        if (!extends) {
+            runs.push_back({ object.mesh->material, geometry.format, geometry.indexType, i, 0 });
+        }
+        runs.back().commandCount++;
+    }
+
+    if (!commandBuffer) {
+        GLuint buffers[4];
+        glGenBuffers(4, buffers);
+        commandBuffer = buffers[0];
+        boundsBuffer = buffers[1];
+        instanceBuffer = buffers[2];
+        maskBuffer = buffers[3];
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, commands.size() * sizeof(DrawCommand), commands.data(), GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, boundsBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, bounds.size() * sizeof(GpuBounds), bounds.data(), GL_STATIC_DRAW);
+
+    // Until a mask arrives every mesh passes; whole words, since the shader reads four bytes at a time.
+    maskCapacity = (static_cast<size_t>(maxMeshIndex) + 4) & ~size_t(3);
+    std::vector<uint8_t> allVisible(maskCapacity, 1);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, maskBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, maskCapacity, allVisible.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(InstanceData), instances.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/**
+ * @brief Decides on the GPU which commands draw this frame.
+ * @param viewProjection The projection times the view matrix.
+ * @param meshVisibility Optional per-mesh verdicts, e.g. from the portal walk; zero drops the mesh.
+ */
+void IndirectScene::cull(const glm::mat4& viewProjection, const std::vector<uint8_t>* meshVisibility) {
+    if (!uploaded) {
+        upload();
+    }
+    if (objects.empty()) return;
+
+    glm::vec4 planes[6];
+    extractFrustumPlanes(viewProjection, planes);
+
+    bool useMask = meshVisibility && !meshVisibility->empty();
+    if (useMask) {
+        // Meshes past the end of the mask keep last frame's bytes; callers pass one entry per mesh.
+        size_t bytes = std::min(meshVisibility->size(), maskCapacity);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, maskBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, bytes, meshVisibility->data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    cullProgram->use();
+    glUniform4fv(planesUniform.location, 6, &planes[0][0]);
+    cullProgram->setInt(objectCountUniform, static_cast<int>(objects.size()));
+    cullProgram->setBool(useMaskUniform, useMask);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BOUNDS_BINDING, boundsBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMANDS_BINDING, commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MASK_BINDING, maskBuffer);
+
+    GLuint groups = (static_cast<GLuint>(objects.size()) + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE;
+    glDispatchCompute(groups, 1, 1);
+    // The draws read the instance counts as indirect commands.
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+}
+
+/**
+ * @brief Issues one multi-draw per run with the opaque layer's depth and blend state.
+ * @param meshPool The pool holding every mesh's geometry.
+ * @param program The program to draw with; per-draw data comes from the instance attributes.
+ */
+void IndirectScene::draw(const MeshPool& meshPool, const Shader& program) {
+    IndirectSceneStats frameStats;
+    frameStats.objects = static_cast<unsigned int>(objects.size());
+    if (objects.empty() || !uploaded) {
+        lastStats = frameStats;
+        return;
+    }
+
+    GLStateCache& state = glState();
+    state.setCapability(GL_BLEND, false);
+    state.depthMask(true);
+    state.depthFunc(GL_LESS);
+    program.use();
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+
+    const Material* currentMaterial = nullptr;
+    bool formatSet = false;
+    VertexFormat currentFormat = VertexFormat::Standard;
+    for (const Run& run : runs) {
+        if (run.material != currentMaterial) {
+            run.material->bind();
+            currentMaterial = run.material;
+        }
+
+        if (!formatSet || run.format != currentFormat) {
+            meshPool.bind(run.format);
+            currentFormat = run.format;
+            formatSet = true;
+
+            // The render queue repoints these per batch, so they are set again
+            // for every frame. baseInstance picks each command's entry.
+            const GLsizei stride = sizeof(InstanceData);
+            for (unsigned int column = 0; column < 4; column++) {
+                glVertexAttribPointer(Mesh::INSTANCE_MODEL_LOCATION + column, 4, GL_FLOAT, GL_FALSE, stride,
+                                      (void*)(offsetof(InstanceData, model) + sizeof(glm::vec4) * column));
+            }
+            glVertexAttribPointer(Mesh::INSTANCE_PARAMS_LOCATION, 4, GL_FLOAT, GL_FALSE, stride,
+                                  (void*)offsetof(InstanceData, params));
+        }
+
+        glMultiDrawElementsIndirect(GL_TRIANGLES, run.indexType,
+                                    (void*)(static_cast<size_t>(run.firstCommand) * sizeof(DrawCommand)),
+                                    static_cast<GLsizei>(run.commandCount), 0);
+        frameStats.multiDraws++;
+    }
+
+    state.bindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    lastStats = frameStats;
+}
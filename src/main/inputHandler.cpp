@@ -133,6 +133,49 @@ void InputHandler::processInput(GLFWwindow* window) {
         gameState->tabKeyPressed = false;
     }
 
+    // F2 switches between the forward and deferred render paths.
+    if (glfwGetKey(window, GLFW_KEY_F2) == GLFW_PRESS && !gameState->renderPathKeyPressed) {
+        gameState->renderPathKeyPressed = true;
+        bool deferred = gameState->renderPath == RenderPath::Forward;
+        gameState->renderPath = deferred ? RenderPath::Deferred : RenderPath::Forward;
+    } else if (glfwGetKey(window, GLFW_KEY_F2) == GLFW_RELEASE) {
+        gameState->renderPathKeyPressed = false;
+    }
+
+    // F3 toggles the depth pre-pass of the forward path.
+    if (glfwGetKey(window, GLFW_KEY_F3) == GLFW_PRESS && !gameState->depthPrepassKeyPressed) {
+        gameState->depthPrepassKeyPressed = true;
+        gameState->depthPrepass = !gameState->depthPrepass;
+    } else if (glfwGetKey(window, GLFW_KEY_F3) == GLFW_RELEASE) {
+        gameState->depthPrepassKeyPressed = false;
+    }
+
+    // F4 cycles the occlusion culling mode: off, Hi-Z, conditional render.
+    if (glfwGetKey(window, GLFW_KEY_F4) == GLFW_PRESS && !gameState->occlusionKeyPressed) {
+        gameState->occlusionKeyPressed = true;
+        switch (gameState->occlusionMode) {
+            case OcclusionMode::Off:
+                gameState->occlusionMode = OcclusionMode::HiZ;
+                break;
+            case OcclusionMode::HiZ:
+                gameState->occlusionMode = OcclusionMode::ConditionalRender;
+                break;
+            case OcclusionMode::ConditionalRender:
+                gameState->occlusionMode = OcclusionMode::Off;
+                break;
+        }
+    } else if (glfwGetKey(window, GLFW_KEY_F4) == GLFW_RELEASE) {
+        gameState->occlusionKeyPressed = false;
+    }
+
+    // F5 toggles the GPU-driven level on GL 4.3 contexts.
+    if (glfwGetKey(window, GLFW_KEY_F5) == GLFW_PRESS && !gameState->gpuDrivenKeyPressed) {
+        gameState->gpuDrivenKeyPressed = true;
+        gameState->gpuDriven = !gameState->gpuDriven;
+    } else if (glfwGetKey(window, GLFW_KEY_F5) == GLFW_RELEASE) {
+        gameState->gpuDrivenKeyPressed = false;
+    }
+
     // Handle camera movement via WASD keys.
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
         gameState->camera.ProcessKeyboard(FORWARD, gameState->deltaTime);
@@ -38,6 +38,7 @@ bool InteractionSystem::CheckInteractions(const glm::vec3& playerPos, std::strin
     for (const auto& obj : interactables) {
         // Skip objects that have already been used up.
         if (obj.consumed) continue;
+        if (reachable && !reachable(obj.position)) continue;
 
         float distance = glm::length(playerPos - obj.position);
         if (distance <= obj.radius) {
@@ -57,6 +58,7 @@ bool InteractionSystem::CheckInteractions(const glm::vec3& playerPos, std::strin
 bool InteractionSystem::HandleInteraction(const glm::vec3& playerPos, std::string& outPopup) {
     for (auto& obj : interactables) {
         if (obj.consumed) continue;
+        if (reachable && !reachable(obj.position)) continue;
 
         float distance = glm::length(playerPos - obj.position);
         if (distance <= obj.radius) {
@@ -79,4 +81,12 @@ bool InteractionSystem::HandleInteraction(const glm::vec3& playerPos, std::strin
  */
 void InteractionSystem::ClearInteractables() {
     interactables.clear();
+}
+
+/**
+ * @brief Sets the test that decides which objects can currently be interacted with.
+ * @param test Returns false for positions the player cannot reach; empty accepts everything.
+ */
+void InteractionSystem::SetReachableTest(std::function<bool(const glm::vec3&)> test) {
+    reachable = std::move(test);
 }
\ No newline at end of file
@@ -0,0 +1,361 @@
+/**
+ * @file lightClusters.cpp
+ * @brief Bins point lights into a view-space froxel grid and uploads the lists as buffer textures.
+ *
+ * Binning runs in three steps:
+ *   1. The light spheres are moved to view space and bounded conservatively in
+ *      screen tiles and view depth, four lights at a time with SSE.
+ *   2. The depth bounds become exponential slice indices.
+ *   3. Per-cluster counts, a prefix sum and a fill pass build the index lists.
+ */
+
+#include "lightClusters.h"
+#include "glState.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LIGHT_CLUSTERS_SSE 1
+#endif
+
+namespace {
+    // Lights are referenced by 16-bit indices.
+    const size_t MAX_INDEXED_LIGHTS = 0xFFFF;
+
+    // Per-light bounds from step 1: tile x and y ranges, not yet clamped to the
+    // grid, and the view depth range. zMin >= zMax marks a light outside the
+    // near or far plane.
+    struct LightBounds {
+        float x0[4], x1[4], y0[4], y1[4], zMin[4], zMax[4];
+    };
+
+    struct ViewParams {
+        float m[3][4];          // rows 0-2 of the view matrix
+        float p00, p11;         // projection scale
+        float nearPlane, farPlane;
+    };
+
+#ifdef LIGHT_CLUSTERS_SSE
+    /**
+     * @brief Picks a where mask is set and b elsewhere.
+     */
+    inline __m128 select(__m128 mask, __m128 a, __m128 b) {
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+
+    /**
+     * @brief Bounds four lights at once.
+     */
+    void boundLights(const ViewParams& v, const float* px, const float* py, const float* pz, const float* pr,
+                     LightBounds& out) {
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 half = _mm_set1_ps(0.5f);
+        __m128 x = _mm_loadu_ps(px);
+        __m128 y = _mm_loadu_ps(py);
+        __m128 z = _mm_loadu_ps(pz);
+        __m128 r = _mm_loadu_ps(pr);
+
+        __m128 vx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(v.m[0][0]), x), _mm_mul_ps(_mm_set1_ps(v.m[0][1]), y)),
+                               _mm_add_ps(_mm_mul_ps(_mm_set1_ps(v.m[0][2]), z), _mm_set1_ps(v.m[0][3])));
+        __m128 vy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(v.m[1][0]), x), _mm_mul_ps(_mm_set1_ps(v.m[1][1]), y)),
+                               _mm_add_ps(_mm_mul_ps(_mm_set1_ps(v.m[1][2]), z), _mm_set1_ps(v.m[1][3])));
+        __m128 vz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(v.m[2][0]), x), _mm_mul_ps(_mm_set1_ps(v.m[2][1]), y)),
+                               _mm_add_ps(_mm_mul_ps(_mm_set1_ps(v.m[2][2]), z), _mm_set1_ps(v.m[2][3])));
+
+        // The camera looks down -z.
+        __m128 depth = _mm_sub_ps(zero, vz);
+        __m128 zMin = _mm_max_ps(_mm_set1_ps(v.nearPlane), _mm_sub_ps(depth, r));
+        __m128 zMax = _mm_min_ps(_mm_set1_ps(v.farPlane), _mm_add_ps(depth, r));
+
+        // Project the sphere's view-space box: a negative edge is widest at the
+        // nearest depth, a positive one at the farthest, and vice versa.
+        __m128 xLow = _mm_sub_ps(vx, r);
+        __m128 xHigh = _mm_add_ps(vx, r);
+        __m128 yLow = _mm_sub_ps(vy, r);
+        __m128 yHigh = _mm_add_ps(vy, r);
+        __m128 p00 = _mm_set1_ps(v.p00);
+        __m128 p11 = _mm_set1_ps(v.p11);
+        __m128 ndcX0 = _mm_div_ps(_mm_mul_ps(xLow, p00), select(_mm_cmplt_ps(xLow, zero), zMin, zMax));
+        __m128 ndcX1 = _mm_div_ps(_mm_mul_ps(xHigh, p00), select(_mm_cmplt_ps(xHigh, zero), zMax, zMin));
+        __m128 ndcY0 = _mm_div_ps(_mm_mul_ps(yLow, p11), select(_mm_cmplt_ps(yLow, zero), zMin, zMax));
+        __m128 ndcY1 = _mm_div_ps(_mm_mul_ps(yHigh, p11), select(_mm_cmplt_ps(yHigh, zero), zMax, zMin));
+
+        // NDC [-1, 1] to tiles.
+        __m128 gridX = _mm_set1_ps(static_cast<float>(LIGHT_CLUSTER_X));
+        __m128 gridY = _mm_set1_ps(static_cast<float>(LIGHT_CLUSTER_Y));
+        auto toTile = [&](__m128 ndc, __m128 grid) {
+            return _mm_mul_ps(_mm_add_ps(_mm_mul_ps(ndc, half), half), grid);
+        };
+        _mm_storeu_ps(out.x0, toTile(ndcX0, gridX));
+        _mm_storeu_ps(out.x1, toTile(ndcX1, gridX));
+        _mm_storeu_ps(out.y0, toTile(ndcY0, gridY));
+        _mm_storeu_ps(out.y1, toTile(ndcY1, gridY));
+        _mm_storeu_ps(out.zMin, zMin);
+        _mm_storeu_ps(out.zMax, zMax);
+    }
+#else
+    /**
+     * @brief Bounds four lights, one lane at a time; same math as the SSE version.
+     */
+    void boundLights(const ViewParams& v, const float* px, const float* py, const float* pz, const float* pr,
+                     LightBounds& out) {
+        auto toTile = [](float ndc, int grid) {
+            return (ndc * 0.5f + 0.5f) * grid;
+        };
+        for (int lane = 0; lane < 4; lane++) {
+            float x = px[lane], y = py[lane], z = pz[lane], r = pr[lane];
+            float vx = v.m[0][0] * x + v.m[0][1] * y + v.m[0][2] * z + v.m[0][3];
+            float vy = v.m[1][0] * x + v.m[1][1] * y + v.m[1][2] * z + v.m[1][3];
+            float vz = v.m[2][0] * x + v.m[2][1] * y + v.m[2][2] * z + v.m[2][3];
+
+            float depth = -vz;
+            float zMin = std::max(v.nearPlane, depth - r);
+            float zMax = std::min(v.farPlane, depth + r);
+
+            float xLow = vx - r, xHigh = vx + r, yLow = vy - r, yHigh = vy + r;
+            out.x0[lane] = toTile(xLow * v.p00 / (xLow < 0.0f ? zMin : zMax), LIGHT_CLUSTER_X);
+            out.x1[lane] = toTile(xHigh * v.p00 / (xHigh < 0.0f ? zMax : zMin), LIGHT_CLUSTER_X);
+            out.y0[lane] = toTile(yLow * v.p11 / (yLow < 0.0f ? zMin : zMax), LIGHT_CLUSTER_Y);
+            out.y1[lane] = toTile(yHigh * v.p11 / (yHigh < 0.0f ? zMax : zMin), LIGHT_CLUSTER_Y);
+            out.zMin[lane] = zMin;
+            out.zMax[lane] = zMax;
+        }
+    }
+#endif
+}
+
+/**
+ * @brief Solves constant + linear * d + quadratic * d^2 = LIGHT_ATTENUATION_LEVELS for d.
+ */
+float pointLightRange(const ScenePointLight& light) {
+    float threshold = static_cast<float>(LIGHT_ATTENUATION_LEVELS) - light.constant;
+    if (threshold <= 0.0f) {
+        return 0.0f;
+    }
+    if (light.quadratic > 0.0f) {
+        float linear = light.linear;
+        return (-linear + std::sqrt(linear * linear + 4.0f * light.quadratic * threshold)) / (2.0f * light.quadratic);
+    }
+    if (light.linear > 0.0f) {
+        return threshold / light.linear;
+    }
+    return std::numeric_limits<float>::infinity();
+}
+
+/**
+ * @brief Releases the buffers and their textures.
+ */
+LightClusters::~LightClusters() {
+    for (BufferTexture* target : { &clusterBuffer, &indexBuffer, &dataBuffer }) {
+        if (target->texture) glDeleteTextures(1, &target->texture);
+    }
+}
+
+/**
+ * @brief Bins the lights for this frame's camera and uploads the cluster lists.
+ * @param lights Every light in the scene; the ones outside the frustum are skipped.
+ * @param view The view matrix.
+ * @param projection The projection matrix.
+ * @param nearPlane Near plane distance of the projection.
+ * @param farPlane Far plane distance of the projection.
+ * @param viewportSize Framebuffer size in pixels, to map gl_FragCoord to tiles.
+ */
+void LightClusters::build(const std::vector<ScenePointLight>& lights, const glm::mat4& view,
+                          const glm::mat4& projection, float nearPlane, float farPlane,
+                          const glm::ivec2& viewportSize) {
+    if (maxTexels == 0) {
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    }
+
+    LightClusterStats frameStats;
+    size_t limit = std::min(MAX_INDEXED_LIGHTS, static_cast<size_t>(maxTexels / LIGHT_DATA_TEXELS));
+    size_t count = std::min(lights.size(), limit);
+    frameStats.lights = static_cast<unsigned int>(lights.size());
+    frameStats.droppedLights = static_cast<unsigned int>(lights.size() - count);
+
+    float sliceScale = LIGHT_CLUSTER_Z / std::log(farPlane / nearPlane);
+    params = glm::vec4(static_cast<float>(LIGHT_CLUSTER_X) / std::max(viewportSize.x, 1),
+                       static_cast<float>(LIGHT_CLUSTER_Y) / std::max(viewportSize.y, 1),
+                       sliceScale, -std::log(nearPlane) * sliceScale);
+
+    // Structure of arrays, padded with spheres of negative radius that bound to nothing.
+    size_t padded = (count + 3) & ~static_cast<size_t>(3);
+    centerX.assign(padded, 0.0f);
+    centerY.assign(padded, 0.0f);
+    centerZ.assign(padded, 0.0f);
+    radius.assign(padded, -1.0f);
+    for (size_t i = 0; i < count; i++) {
+        centerX[i] = lights[i].position.x;
+        centerY[i] = lights[i].position.y;
+        centerZ[i] = lights[i].position.z;
+        radius[i] = pointLightRange(lights[i]);
+    }
+
+    computeRanges(view, projection, nearPlane, farPlane, count);
+
+    // Visible lights get compact ids in the data buffer.
+    lightData.clear();
+    clusterCounts.assign(LIGHT_CLUSTER_COUNT, 0);
+    compactIds.assign(count, 0);
+    for (size_t i = 0; i < count; i++) {
+        const ClusterRange& range = ranges[i];
+        if (range.x0 > range.x1 || range.y0 > range.y1 || range.z0 > range.z1) {
+            continue;
+        }
+        compactIds[i] = static_cast<uint16_t>(frameStats.visibleLights++);
+
+        const ScenePointLight& light = lights[i];
+        lightData.push_back(glm::vec4(light.position, light.constant));
+        lightData.push_back(glm::vec4(light.ambient, light.linear));
+        lightData.push_back(glm::vec4(light.diffuse, light.quadratic));
+        lightData.push_back(glm::vec4(light.specular, radius[i]));
+
+        for (int z = range.z0; z <= range.z1; z++)
+            for (int y = range.y0; y <= range.y1; y++)
+                for (int x = range.x0; x <= range.x1; x++)
+                    clusterCounts[(z * LIGHT_CLUSTER_Y + y) * LIGHT_CLUSTER_X + x]++;
+    }
+
+    // Prefix sum into offsets; lists that would run past the buffer texture limit are cut short.
+    clusterTable.resize(LIGHT_CLUSTER_COUNT * 2);
+    uint32_t total = 0;
+    uint32_t capacity = static_cast<uint32_t>(maxTexels);
+    for (int c = 0; c < LIGHT_CLUSTER_COUNT; c++) {
+        uint32_t kept = std::min(clusterCounts[c], capacity - total);
+        frameStats.droppedIndices += clusterCounts[c] - kept;
+        frameStats.maxClusterLights = std::max(frameStats.maxClusterLights, clusterCounts[c]);
+        clusterTable[c * 2] = total;
+        clusterTable[c * 2 + 1] = kept;
+        clusterCounts[c] = 0; // reused as the fill cursor
+        total += kept;
+    }
+    frameStats.lightIndices = total;
+
+    indices.resize(total);
+    for (size_t i = 0; i < count; i++) {
+        const ClusterRange& range = ranges[i];
+        if (range.x0 > range.x1 || range.y0 > range.y1 || range.z0 > range.z1) {
+            continue;
+        }
+        for (int z = range.z0; z <= range.z1; z++) {
+            for (int y = range.y0; y <= range.y1; y++) {
+                for (int x = range.x0; x <= range.x1; x++) {
+                    int c = (z * LIGHT_CLUSTER_Y + y) * LIGHT_CLUSTER_X + x;
+                    if (clusterCounts[c] < clusterTable[c * 2 + 1]) {
+                        indices[clusterTable[c * 2] + clusterCounts[c]++] = compactIds[i];
+                    }
+                }
+            }
+        }
+    }
+
+    upload(clusterBuffer, GL_RG32UI, clusterTable.data(), clusterTable.size() * sizeof(uint32_t));
+    upload(indexBuffer, GL_R16UI, indices.data(), indices.size() * sizeof(uint16_t));
+    upload(dataBuffer, GL_RGBA32F, lightData.data(), lightData.size() * sizeof(glm::vec4));
+    lastStats = frameStats;
+}
+
+/**
+ * @brief Binds the three buffer textures to their fixed units.
+ */
+void LightClusters::bind() const {
+    GLStateCache& state = glState();
+    state.bindTexture(LIGHT_CLUSTER_TEXTURE_UNIT, GL_TEXTURE_BUFFER, clusterBuffer.texture);
+    state.bindTexture(LIGHT_INDEX_TEXTURE_UNIT, GL_TEXTURE_BUFFER, indexBuffer.texture);
+    state.bindTexture(LIGHT_DATA_TEXTURE_UNIT, GL_TEXTURE_BUFFER, dataBuffer.texture);
+}
+
+/**
+ * @brief Fences the regions written by this frame's build.
+ */
+void LightClusters::endFrame() {
+    clusterBuffer.stream.end();
+    indexBuffer.stream.end();
+    dataBuffer.stream.end();
+}
+
+/**
+ * @brief Turns the light spheres into conservative cluster ranges.
+ */
+void LightClusters::computeRanges(const glm::mat4& view, const glm::mat4& projection, float nearPlane,
+                                  float farPlane, size_t count) {
+    ViewParams v;
+    for (int row = 0; row < 3; row++) {
+        for (int column = 0; column < 4; column++) {
+            v.m[row][column] = view[column][row];
+        }
+    }
+    v.p00 = projection[0][0];
+    v.p11 = projection[1][1];
+    v.nearPlane = nearPlane;
+    v.farPlane = farPlane;
+
+    float sliceScale = params.z;
+    float sliceBias = params.w;
+    auto toSlice = [&](float depth) {
+        float slice = std::log(depth) * sliceScale + sliceBias;
+        return std::min(std::max(static_cast<int>(slice), 0), LIGHT_CLUSTER_Z - 1);
+    };
+    auto toTile = [](float tile, int grid) {
+        return static_cast<int>(std::min(std::max(tile, 0.0f), static_cast<float>(grid - 1)));
+    };
+
+    ranges.resize(count);
+    LightBounds bounds;
+    for (size_t i = 0; i < count; i += 4) {
+        boundLights(v, &centerX[i], &centerY[i], &centerZ[i], &radius[i], bounds);
+
+        for (size_t lane = 0; lane < 4 && i + lane < count; lane++) {
+            ClusterRange& range = ranges[i + lane];
+            // Also outside if the tile range misses the grid, i.e. beyond a side plane.
+            if (!(bounds.zMin[lane] < bounds.zMax[lane]) ||
+                !(bounds.x1[lane] >= 0.0f && bounds.x0[lane] < LIGHT_CLUSTER_X) ||
+                !(bounds.y1[lane] >= 0.0f && bounds.y0[lane] < LIGHT_CLUSTER_Y)) {
+                range = { 0, -1, 0, -1, 0, -1 };
+                continue;
+            }
+            range.x0 = toTile(bounds.x0[lane], LIGHT_CLUSTER_X);
+            range.x1 = toTile(bounds.x1[lane], LIGHT_CLUSTER_X);
+            range.y0 = toTile(bounds.y0[lane], LIGHT_CLUSTER_Y);
+            range.y1 = toTile(bounds.y1[lane], LIGHT_CLUSTER_Y);
+            range.z0 = toSlice(bounds.zMin[lane]);
+            range.z1 = toSlice(bounds.zMax[lane]);
+        }
+    }
+}
+
+/**
+ * @brief Streams the contents of a buffer texture into the next region of its buffer.
+ *
+ * With persistent mapping the texture is pointed at the region just written;
+ * otherwise the buffer was orphaned and the texture keeps addressing all of it.
+ */
+void LightClusters::upload(BufferTexture& target, GLenum format, const void* data, size_t bytes) {
+    if (!target.texture) {
+        glGenTextures(1, &target.texture);
+    }
+
+    target.stream.begin(std::max(bytes, static_cast<size_t>(16)));
+    if (target.stream.persistent() && offsetAlignment == 0) {
+        glGetIntegerv(GL_TEXTURE_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+    }
+    GLintptr offset = target.stream.write(data, bytes, static_cast<size_t>(std::max(offsetAlignment, 16)));
+    if (offset < 0) return;
+
+    if (target.stream.persistent()) {
+        glState().bindTexture(0, GL_TEXTURE_BUFFER, target.texture);
+        glTexBufferRange(GL_TEXTURE_BUFFER, format, target.stream.buffer(), offset,
+                         static_cast<GLsizeiptr>(std::max(bytes, static_cast<size_t>(16))));
+        glState().bindTexture(0, GL_TEXTURE_BUFFER, 0);
+        target.attached = target.stream.buffer();
+    } else if (target.attached != target.stream.buffer()) {
+        // The texture refers to the buffer object, so it follows every orphaning.
+        glState().bindTexture(0, GL_TEXTURE_BUFFER, target.texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, target.stream.buffer());
+        glState().bindTexture(0, GL_TEXTURE_BUFFER, 0);
+        target.attached = target.stream.buffer();
+    }
+}
@@ -0,0 +1,136 @@
+/**
+ * @file material.cpp
+ * @brief Implements materials and the library holding their parameter buffer.
+ *
+ * Everything a draw needs from its material is resolved when the model is
+ * imported: texture names per fixed unit and an offset into one uniform
+ * buffer. Switching materials is then a handful of binds, with no sampler
+ * name lookups and no uniform uploads.
+ */
+
+#include "material.h"
+#include "glState.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+    // Enough for every model of the scene without growing.
+    const size_t INITIAL_MATERIAL_CAPACITY = 32;
+}
+
+/**
+ * @brief Maps an imported texture type name to its slot.
+ */
+MaterialTextureSlot materialTextureSlot(const std::string& type) {
+    if (type == "texture_diffuse") return MATERIAL_TEXTURE_DIFFUSE;
+    if (type == "texture_specular") return MATERIAL_TEXTURE_SPECULAR;
+    if (type == "texture_normal") return MATERIAL_TEXTURE_NORMAL;
+    if (type == "texture_height") return MATERIAL_TEXTURE_HEIGHT;
+    return MATERIAL_TEXTURE_SLOTS;
+}
+
+/**
+ * @brief Binds the material's maps and its parameter range.
+ *
+ * Slots without a map are left alone; no shader samples them for this material.
+ */
+void Material::bind() const {
+    for (uint32_t slot = 0; slot < MATERIAL_TEXTURE_SLOTS; slot++) {
+        if (!textures[slot]) continue;
+        glState().bindTexture(MATERIAL_TEXTURE_UNIT_BASE + slot, GL_TEXTURE_2D, textures[slot]);
+    }
+    glBindBufferRange(GL_UNIFORM_BUFFER, MATERIAL_PARAMS_BINDING, paramsBuffer, paramsOffset, sizeof(MaterialParams));
+}
+
+/**
+ * @brief Releases the parameter buffer and the fallback texture.
+ */
+MaterialLibrary::~MaterialLibrary() {
+    if (buffer) glDeleteBuffers(1, &buffer);
+    if (whiteTexture) glDeleteTextures(1, &whiteTexture);
+}
+
+/**
+ * @brief Creates the parameter buffer and the white fallback texture on first use.
+ */
+void MaterialLibrary::createResources() {
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    size_t align = static_cast<size_t>(std::max(alignment, 1));
+    stride = (sizeof(MaterialParams) + align - 1) / align * align;
+
+    glGenBuffers(1, &buffer);
+
+    const uint8_t white[4] = { 255, 255, 255, 255 };
+    glGenTextures(1, &whiteTexture);
+    glBindTexture(GL_TEXTURE_2D, whiteTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+/**
+ * @brief Doubles the parameter buffer and uploads every material again.
+ *
+ * The buffer keeps its name, so the ranges the materials point at stay valid.
+ */
+void MaterialLibrary::grow() {
+    capacity = std::max(INITIAL_MATERIAL_CAPACITY, capacity * 2);
+    std::vector<uint8_t> contents(capacity * stride, 0);
+    for (size_t i = 0; i < materials.size(); i++) {
+        std::memcpy(contents.data() + i * stride, &materials[i]->params, sizeof(MaterialParams));
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, contents.size(), contents.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+/**
+ * @brief Returns the material with these maps and parameters, creating it if needed.
+ * @param textures GL texture names per MaterialTextureSlot, 0 for missing maps.
+ * @param params The material parameters.
+ * @return The shared material; it lives as long as the library.
+ */
+const Material* MaterialLibrary::acquire(const GLuint textures[MATERIAL_TEXTURE_SLOTS], const MaterialParams& params) {
+    if (!buffer) {
+        createResources();
+    }
+
+    Material candidate;
+    std::memcpy(candidate.textures, textures, sizeof(candidate.textures));
+    if (!candidate.textures[MATERIAL_TEXTURE_DIFFUSE]) {
+        candidate.textures[MATERIAL_TEXTURE_DIFFUSE] = whiteTexture;
+    }
+    candidate.params = params;
+    candidate.params.pad = 0.0f;
+
+    for (const std::unique_ptr<Material>& material : materials) {
+        if (std::memcmp(material->textures, candidate.textures, sizeof(candidate.textures)) == 0 &&
+            std::memcmp(&material->params, &candidate.params, sizeof(MaterialParams)) == 0) {
+            return material.get();
+        }
+    }
+
+    // The sort keys have 16 bits for the material.
+    if (materials.size() > 0xFFFF) {
+        std::cerr << "Material library: more than 65536 materials, sharing the last one" << std::endl;
+        return materials.back().get();
+    }
+
+    candidate.id = static_cast<uint16_t>(materials.size());
+    candidate.paramsBuffer = buffer;
+    candidate.paramsOffset = static_cast<GLintptr>(materials.size() * stride);
+    materials.push_back(std::make_unique<Material>(candidate));
+
+    if (materials.size() > capacity) {
+        grow();
+    } else {
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, candidate.paramsOffset, sizeof(MaterialParams), &candidate.params);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+    return materials.back().get();
+}
@@ -0,0 +1,458 @@
+/**
+ * @file meshCache.cpp
+ * @brief Implements the binary mesh cache that lets warm starts skip Assimp.
+ *
+ * File layout, all little-endian and naturally aligned:
+ *   header | mesh records | texture references | string table | geometry blobs
+ * Geometry blobs are stored exactly as uploaded, 16-byte aligned, so a warm
+ * start maps the file and hands the pointers straight to the mesh pool.
+ */
+
+#include "meshCache.h"
+#include "config.h"
+#include "hash.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    const char MESH_CACHE_MAGIC[4] = { 'P', 'S', 'M', 'C' };
+    const size_t BLOB_ALIGNMENT = 16;
+
+    struct FileHeader {
+        char magic[4];
+        uint32_t version;
+        uint64_t sourceHash;
+        uint32_t attributeMask;
+        uint32_t meshCount;
+        uint32_t textureRefCount;
+        uint32_t stringBytes;
+        uint64_t bvhOffset;
+        uint64_t bvhBytes;
+        uint64_t sectorOffset;
+        uint64_t sectorBytes;
+        uint64_t fileSize;
+    };
+
+    struct FileMeshRecord {
+        uint32_t format;
+        uint32_t indexType;
+        uint64_t vertexCount;
+        uint64_t indexCount;
+        uint64_t vertexOffset;
+        uint64_t indexOffset;
+        float boundsMin[3];
+        float boundsMax[3];
+        float boundsRadius;
+        float positionDecode[16];
+        float material[8]; // MaterialParams
+        uint32_t firstTexture;
+        uint32_t textureCount;
+    };
+
+    static_assert(sizeof(MaterialParams) == sizeof(float) * 8, "FileMeshRecord::material must hold MaterialParams");
+
+    struct FileTextureRef {
+        uint32_t typeOffset;
+        uint32_t typeLength;
+        uint32_t pathOffset;
+        uint32_t pathLength;
+    };
+
+    /**
+     * @brief Reads a whole file, returning false if it cannot be opened.
+     */
+    bool readFile(const std::string& path, std::string& contents) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            return false;
+        }
+        std::stringstream stream;
+        stream << file.rdbuf();
+        contents = stream.str();
+        return true;
+    }
+
+    size_t alignUp(size_t value, size_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    size_t indexSize(GLenum indexType) {
+        return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+    }
+}
+
+/**
+ * @brief Unmaps the file.
+ */
+MappedFile::~MappedFile() {
+    close();
+}
+
+/**
+ * @brief Maps a file read-only.
+ * @param path The file to map.
+ * @return True on success; empty files fail.
+ */
+bool MappedFile::open(const std::string& path) {
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    fileHandle = file;
+    mappingHandle = mapping;
+    bytes = static_cast<const uint8_t*>(view);
+    length = static_cast<size_t>(fileSize.QuadPart);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (view == MAP_FAILED) {
+        ::close(fd);
+        return false;
+    }
+    descriptor = fd;
+    bytes = static_cast<const uint8_t*>(view);
+    length = static_cast<size_t>(info.st_size);
+#endif
+    return true;
+}
+
+/**
+ * @brief Releases the mapping, if any.
+ */
+void MappedFile::close() {
+#ifdef _WIN32
+    if (bytes) UnmapViewOfFile(bytes);
+    if (mappingHandle) CloseHandle(mappingHandle);
+    if (fileHandle) CloseHandle(fileHandle);
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    if (bytes) munmap(const_cast<uint8_t*>(bytes), length);
+    if (descriptor >= 0) ::close(descriptor);
+    descriptor = -1;
+#endif
+    bytes = nullptr;
+    length = 0;
+}
+
+/**
+ * @brief Hashes a model and the material libraries (mtllib) it references.
+ * @param modelPath The model file.
+ * @return The combined hash, or 0 if the model cannot be read.
+ */
+uint64_t hashModelSources(const std::string& modelPath) {
+    std::string contents;
+    if (!readFile(modelPath, contents)) {
+        return 0;
+    }
+    uint64_t hash = fnv1a(contents);
+
+    std::string directory = modelPath.substr(0, modelPath.find_last_of('/'));
+    std::istringstream lines(contents);
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (line.compare(0, 7, "mtllib ") != 0) {
+            continue;
+        }
+        std::string library = line.substr(7);
+        while (!library.empty() && (library.back() == '\r' || library.back() == ' ')) {
+            library.pop_back();
+        }
+        std::string material;
+        if (readFile(directory + '/' + library, material)) {
+            hash = fnv1a(material, hash);
+        }
+    }
+    return hash;
+}
+
+/**
+ * @brief Returns the cache file used for a model.
+ */
+std::string meshCachePath(const std::string& modelPath) {
+    std::string name = modelPath;
+    for (char& c : name) {
+        if (c == '/' || c == '\\' || c == ':') {
+            c = '_';
+        }
+    }
+    return std::string(MESH_CACHE_DIRECTORY) + '/' + name + ".bin";
+}
+
+/**
+ * @brief Writes a model's processed meshes to a cache file.
+ * @param cachePath The cache file to create.
+ * @param sourceHash Hash of the model sources, see hashModelSources.
+ * @param attributeMask The shader attributes the geometry was encoded for.
+ * @param meshes The encoded meshes.
+ * @param bvhData A serialized TriangleBVH, or empty.
+ * @param sectorData A serialized SectorGraph, or empty.
+ * @return True if the cache was written.
+ */
+bool writeMeshCache(const std::string& cachePath, uint64_t sourceHash, uint32_t attributeMask,
+                    const std::vector<MeshCacheEntry>& meshes, const std::vector<uint8_t>& bvhData,
+                    const std::vector<uint8_t>& sectorData) {
+    std::vector<FileMeshRecord> records(meshes.size());
+    std::vector<FileTextureRef> textureRefs;
+    std::string strings;
+
+    for (size_t i = 0; i < meshes.size(); i++) {
+        FileMeshRecord& record = records[i];
+        std::memset(&record, 0, sizeof(record));
+        record.firstTexture = static_cast<uint32_t>(textureRefs.size());
+        record.textureCount = static_cast<uint32_t>(meshes[i].textures.size());
+        for (const MeshCacheTexture& texture : meshes[i].textures) {
+            FileTextureRef ref;
+            ref.typeOffset = static_cast<uint32_t>(strings.size());
+            ref.typeLength = static_cast<uint32_t>(texture.type.size());
+            strings += texture.type;
+            ref.pathOffset = static_cast<uint32_t>(strings.size());
+            ref.pathLength = static_cast<uint32_t>(texture.path.size());
+            strings += texture.path;
+            textureRefs.push_back(ref);
+        }
+    }
+
+    // Place the geometry after the metadata.
+    size_t offset = sizeof(FileHeader) + records.size() * sizeof(FileMeshRecord) +
+                    textureRefs.size() * sizeof(FileTextureRef) + strings.size();
+    for (size_t i = 0; i < meshes.size(); i++) {
+        const MeshCacheEntry& mesh = meshes[i];
+        FileMeshRecord& record = records[i];
+        record.format = static_cast<uint32_t>(mesh.format);
+        record.indexType = mesh.indexType;
+        record.vertexCount = mesh.vertexCount;
+        record.indexCount = mesh.indexCount;
+        std::memcpy(record.boundsMin, &mesh.boundsMin[0], sizeof(record.boundsMin));
+        std::memcpy(record.boundsMax, &mesh.boundsMax[0], sizeof(record.boundsMax));
+        record.boundsRadius = mesh.boundsRadius;
+        std::memcpy(record.positionDecode, &mesh.positionDecode[0][0], sizeof(record.positionDecode));
+        std::memcpy(record.material, &mesh.material, sizeof(record.material));
+
+        offset = alignUp(offset, BLOB_ALIGNMENT);
+        record.vertexOffset = offset;
+        offset += mesh.vertexCount * vertexFormatStride(mesh.format);
+        offset = alignUp(offset, BLOB_ALIGNMENT);
+        record.indexOffset = offset;
+        offset += mesh.indexCount * indexSize(mesh.indexType);
+    }
+    offset = alignUp(offset, BLOB_ALIGNMENT);
+    size_t bvhOffset = offset;
+    offset += bvhData.size();
+    offset = alignUp(offset, BLOB_ALIGNMENT);
+    size_t sectorOffset = offset;
+    offset += sectorData.size();
+
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+    header.version = MESH_CACHE_VERSION;
+    header.sourceHash = sourceHash;
+    header.attributeMask = attributeMask;
+    header.meshCount = static_cast<uint32_t>(meshes.size());
+    header.textureRefCount = static_cast<uint32_t>(textureRefs.size());
+    header.stringBytes = static_cast<uint32_t>(strings.size());
+    header.bvhOffset = bvhData.empty() ? 0 : bvhOffset;
+    header.bvhBytes = bvhData.size();
+    header.sectorOffset = sectorData.empty() ? 0 : sectorOffset;
+    header.sectorBytes = sectorData.size();
+    header.fileSize = offset;
+
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(cachePath).parent_path(), error);
+
+    std::string temporaryPath = cachePath + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            std::cerr << "Mesh cache: cannot write " << temporaryPath << std::endl;
+            return false;
+        }
+
+        size_t written = 0;
+        auto write = [&](const void* data, size_t size) {
+            file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+            written += size;
+        };
+        auto pad = [&](size_t target) {
+            static const char zeros[BLOB_ALIGNMENT] = {};
+            write(zeros, target - written);
+        };
+
+        write(&header, sizeof(header));
+        write(records.data(), records.size() * sizeof(FileMeshRecord));
+        write(textureRefs.data(), textureRefs.size() * sizeof(FileTextureRef));
+        write(strings.data(), strings.size());
+        for (size_t i = 0; i < meshes.size(); i++) {
+            pad(records[i].vertexOffset);
+            write(meshes[i].vertexData, meshes[i].vertexCount * vertexFormatStride(meshes[i].format));
+            pad(records[i].indexOffset);
+            write(meshes[i].indexData, meshes[i].indexCount * indexSize(meshes[i].indexType));
+        }
+        pad(bvhOffset);
+        write(bvhData.data(), bvhData.size());
+        pad(sectorOffset);
+        write(sectorData.data(), sectorData.size());
+
+        if (!file) {
+            std::cerr << "Mesh cache: write failed for " << temporaryPath << std::endl;
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temporaryPath, cachePath, error);
+    if (error) {
+        std::cerr << "Mesh cache: cannot replace " << cachePath << ": " << error.message() << std::endl;
+        std::filesystem::remove(temporaryPath, error);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Maps a cache file and checks that it matches the current sources.
+ * @param cachePath The cache file.
+ * @param sourceHash Hash of the current model sources.
+ * @param attributeMask The shader attributes the geometry must be encoded for.
+ * @return True if the cache is usable; false means the model must be imported.
+ */
+bool MeshCacheReader::open(const std::string& cachePath, uint64_t sourceHash, uint32_t attributeMask) {
+    entries.clear();
+    bvh = nullptr;
+    bvhBytes = 0;
+    sectors = nullptr;
+    sectorBytes = 0;
+    if (!file.open(cachePath)) {
+        return false;
+    }
+
+    const uint8_t* base = file.data();
+    size_t size = file.size();
+    if (size < sizeof(FileHeader)) {
+        file.close();
+        return false;
+    }
+
+    FileHeader header;
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != MESH_CACHE_VERSION || header.sourceHash != sourceHash ||
+        header.attributeMask != attributeMask || header.fileSize != size) {
+        file.close();
+        return false;
+    }
+
+    if (header.bvhBytes > 0) {
+        if (header.bvhOffset + header.bvhBytes > size) {
+            file.close();
+            return false;
+        }
+        bvh = base + header.bvhOffset;
+        bvhBytes = header.bvhBytes;
+    }
+    if (header.sectorBytes > 0) {
+        if (header.sectorOffset + header.sectorBytes > size) {
+            file.close();
+            return false;
+        }
+        sectors = base + header.sectorOffset;
+        sectorBytes = header.sectorBytes;
+    }
+
+    size_t recordsOffset = sizeof(FileHeader);
+    size_t refsOffset = recordsOffset + header.meshCount * sizeof(FileMeshRecord);
+    size_t stringsOffset = refsOffset + header.textureRefCount * sizeof(FileTextureRef);
+    if (stringsOffset + header.stringBytes > size) {
+        file.close();
+        return false;
+    }
+
+    const FileTextureRef* refs = reinterpret_cast<const FileTextureRef*>(base + refsOffset);
+    const char* strings = reinterpret_cast<const char*>(base + stringsOffset);
+
+    entries.resize(header.meshCount);
+    for (uint32_t i = 0; i < header.meshCount; i++) {
+        FileMeshRecord record;
+        std::memcpy(&record, base + recordsOffset + i * sizeof(FileMeshRecord), sizeof(record));
+
+        MeshCacheEntry& entry = entries[i];
+        if (record.format >= VERTEX_FORMAT_COUNT ||
+            record.firstTexture + record.textureCount > header.textureRefCount ||
+            record.vertexOffset + record.vertexCount * vertexFormatStride(static_cast<VertexFormat>(record.format)) > size ||
+            record.indexOffset + record.indexCount * indexSize(record.indexType) > size) {
+            entries.clear();
+            file.close();
+            return false;
+        }
+
+        entry.format = static_cast<VertexFormat>(record.format);
+        entry.indexType = record.indexType;
+        entry.vertexData = base + record.vertexOffset;
+        entry.vertexCount = record.vertexCount;
+        entry.indexData = base + record.indexOffset;
+        entry.indexCount = record.indexCount;
+        std::memcpy(&entry.boundsMin[0], record.boundsMin, sizeof(record.boundsMin));
+        std::memcpy(&entry.boundsMax[0], record.boundsMax, sizeof(record.boundsMax));
+        entry.boundsRadius = record.boundsRadius;
+        std::memcpy(&entry.positionDecode[0][0], record.positionDecode, sizeof(record.positionDecode));
+        std::memcpy(&entry.material, record.material, sizeof(record.material));
+
+        for (uint32_t t = 0; t < record.textureCount; t++) {
+            const FileTextureRef& ref = refs[record.firstTexture + t];
+            if (ref.typeOffset + ref.typeLength > header.stringBytes ||
+                ref.pathOffset + ref.pathLength > header.stringBytes) {
+                entries.clear();
+                file.close();
+                return false;
+            }
+            MeshCacheTexture texture;
+            texture.type.assign(strings + ref.typeOffset, ref.typeLength);
+            texture.path.assign(strings + ref.pathOffset, ref.pathLength);
+            entry.textures.push_back(texture);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,428 @@
+/**
+ * @file meshOptimizer.cpp
+ * @brief Implements the import-time mesh optimization pass.
+ *
+ * Assimp's OBJ output duplicates every vertex per face corner and keeps the
+ * file's triangle order. This pass welds the duplicates, then reorders the
+ * triangles for the post-transform vertex cache (Forsyth), groups them into
+ * clusters sorted to reduce overdraw (Sander et al.), and finally renumbers the
+ * vertices in first-use order for linear vertex fetch.
+ */
+
+#include "meshOptimizer.h"
+#include "hash.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+    // Forsyth scoring parameters, from "Linear-Speed Vertex Cache Optimisation".
+    const int FORSYTH_CACHE_SIZE = 32;
+    const float CACHE_DECAY_POWER = 1.5f;
+    const float LAST_TRIANGLE_SCORE = 0.75f;
+    const float VALENCE_BOOST_SCALE = 2.0f;
+    const float VALENCE_BOOST_POWER = 0.5f;
+
+    // Allowed ACMR growth when splitting clusters for overdraw ordering.
+    const float OVERDRAW_THRESHOLD = 1.05f;
+
+    /**
+     * @brief Hashes the bytes of a vertex (FNV-1a).
+     */
+    struct VertexHash {
+        size_t operator()(const Vertex& v) const {
+            return static_cast<size_t>(fnv1a(&v, sizeof(Vertex)));
+        }
+    };
+
+    struct VertexEqual {
+        bool operator()(const Vertex& a, const Vertex& b) const {
+            return std::memcmp(&a, &b, sizeof(Vertex)) == 0;
+        }
+    };
+
+    /**
+     * @brief Scores a vertex by its cache position and the triangles still using it.
+     */
+    float vertexScore(int cachePosition, unsigned int remainingTriangles) {
+        if (remainingTriangles == 0) {
+            return -1.0f;
+        }
+
+        float score = 0.0f;
+        if (cachePosition >= 0) {
+            if (cachePosition < 3) {
+                // The triangle just emitted; a fixed score keeps strips from being favored.
+                score = LAST_TRIANGLE_SCORE;
+            } else {
+                float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+                score = std::pow(1.0f - (cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+            }
+        }
+        // Favor finishing off vertices with few triangles left.
+        score += VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remainingTriangles), -VALENCE_BOOST_POWER);
+        return score;
+    }
+
+    /**
+     * @brief FIFO post-transform cache used to count vertex shader invocations.
+     */
+    struct FifoCache {
+        std::vector<unsigned int> timestamps;
+        unsigned int time;
+        unsigned int size;
+
+        FifoCache(size_t vertexCount, unsigned int cacheSize)
+            : timestamps(vertexCount, 0), time(cacheSize + 1), size(cacheSize) {}
+
+        // returns 1 on a miss, inserting the vertex
+        unsigned int access(unsigned int vertex) {
+            if (time - timestamps[vertex] > size) {
+                timestamps[vertex] = time++;
+                return 1;
+            }
+            return 0;
+        }
+
+        // evicts everything
+        void flush() {
+            time += size + 1;
+        }
+    };
+}
+
+/**
+ * @brief Accumulates another mesh's statistics, weighting ACMR by triangle count.
+ */
+MeshOptimizationStats& MeshOptimizationStats::operator+=(const MeshOptimizationStats& other) {
+    size_t total = triangles + other.triangles;
+    if (total > 0) {
+        acmrBefore = (acmrBefore * triangles + other.acmrBefore * other.triangles) / total;
+        acmrAfter = (acmrAfter * triangles + other.acmrAfter * other.triangles) / total;
+    }
+    triangles = total;
+    verticesBefore += other.verticesBefore;
+    verticesAfter += other.verticesAfter;
+    atvrAfter = verticesAfter > 0 ? acmrAfter * triangles / verticesAfter : 0.0f;
+    return *this;
+}
+
+/**
+ * @brief Merges bitwise identical vertices.
+ * @param vertices The vertices, compacted in place.
+ * @param indices The indices, rewritten to the merged vertices.
+ */
+void weldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    std::unordered_map<Vertex, unsigned int, VertexHash, VertexEqual> unique;
+    unique.reserve(vertices.size());
+
+    std::vector<unsigned int> remap(vertices.size());
+    std::vector<Vertex> welded;
+    welded.reserve(vertices.size());
+
+    for (size_t i = 0; i < vertices.size(); i++) {
+        auto result = unique.emplace(vertices[i], static_cast<unsigned int>(welded.size()));
+        if (result.second) {
+            welded.push_back(vertices[i]);
+        }
+        remap[i] = result.first->second;
+    }
+
+    for (unsigned int& index : indices) {
+        index = remap[index];
+    }
+    vertices.swap(welded);
+}
+
+/**
+ * @brief Reorders triangles for post-transform cache locality.
+ * @param indices Triangle list indices, reordered in place.
+ * @param vertexCount Number of vertices the indices refer to.
+ */
+void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // Per-vertex lists of the triangles still to be emitted; the live part of a
+    // vertex's list is its first remaining[v] entries.
+    std::vector<unsigned int> remaining(vertexCount, 0);
+    for (unsigned int index : indices) {
+        remaining[index]++;
+    }
+    std::vector<unsigned int> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++) {
+        offsets[v + 1] = offsets[v] + remaining[v];
+    }
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++) {
+        for (int k = 0; k < 3; k++) {
+            adjacency[fill[indices[t * 3 + k]]++] = static_cast<unsigned int>(t);
+        }
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> scores(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) {
+        scores[v] = vertexScore(-1, remaining[v]);
+    }
+
+    std::vector<float> triangleScores(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    int best = 0;
+    for (size_t t = 0; t < triangleCount; t++) {
+        const unsigned int* tri = &indices[t * 3];
+        triangleScores[t] = scores[tri[0]] + scores[tri[1]] + scores[tri[2]];
+        if (triangleScores[t] > triangleScores[best]) {
+            best = static_cast<int>(t);
+        }
+    }
+
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+    std::vector<unsigned int> cache;
+    std::vector<unsigned int> nextCache;
+    size_t scanCursor = 0;
+
+    while (output.size() < indices.size()) {
+        if (best < 0) {
+            // Nothing in the cache has work left; restart from the next triangle in input order.
+            while (emitted[scanCursor]) {
+                scanCursor++;
+            }
+            best = static_cast<int>(scanCursor);
+        }
+
+        unsigned int triangle = static_cast<unsigned int>(best);
+        const unsigned int* tri = &indices[triangle * 3];
+        emitted[triangle] = true;
+
+        nextCache.clear();
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = tri[k];
+            output.push_back(v);
+
+            unsigned int* list = &adjacency[offsets[v]];
+            for (unsigned int j = 0; j < remaining[v]; j++) {
+                if (list[j] == triangle) {
+                    std::swap(list[j], list[remaining[v] - 1]);
+                    break;
+                }
+            }
+            remaining[v]--;
+
+            if (std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end()) {
+                nextCache.push_back(v);
+            }
+        }
+        for (unsigned int v : cache) {
+            if (v != tri[0] && v != tri[1] && v != tri[2]) {
+                nextCache.push_back(v);
+            }
+        }
+
+        // Rescore every vertex that moved in or fell out of the cache.
+        for (size_t i = 0; i < nextCache.size(); i++) {
+            unsigned int v = nextCache[i];
+            cachePosition[v] = i < static_cast<size_t>(FORSYTH_CACHE_SIZE) ? static_cast<int>(i) : -1;
+            scores[v] = vertexScore(cachePosition[v], remaining[v]);
+        }
+        if (nextCache.size() > static_cast<size_t>(FORSYTH_CACHE_SIZE)) {
+            nextCache.resize(FORSYTH_CACHE_SIZE);
+        }
+        cache.swap(nextCache);
+
+        // The next triangle is the best one touching the cache.
+        best = -1;
+        float bestScore = -1.0f;
+        for (unsigned int v : cache) {
+            const unsigned int* list = &adjacency[offsets[v]];
+            for (unsigned int j = 0; j < remaining[v]; j++) {
+                unsigned int t = list[j];
+                const unsigned int* other = &indices[t * 3];
+                triangleScores[t] = scores[other[0]] + scores[other[1]] + scores[other[2]];
+                if (triangleScores[t] > bestScore) {
+                    bestScore = triangleScores[t];
+                    best = static_cast<int>(t);
+                }
+            }
+        }
+    }
+
+    indices.swap(output);
+}
+
+/**
+ * @brief Sorts clusters of cache-ordered triangles so outward-facing ones are drawn first.
+ * @param indices Cache-optimized triangle list indices, reordered in place.
+ * @param vertices The vertices the indices refer to.
+ * @param threshold Allowed ACMR growth from splitting clusters.
+ */
+void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, float threshold) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2) {
+        return;
+    }
+
+    // Hard boundaries: triangles that miss on all three vertices already start a
+    // fresh cache working set, so splitting there costs nothing.
+    std::vector<size_t> hardBoundaries;
+    FifoCache cache(vertices.size(), MESH_OPTIMIZER_CACHE_SIZE);
+    for (size_t t = 0; t < triangleCount; t++) {
+        unsigned int misses = cache.access(indices[t * 3]) + cache.access(indices[t * 3 + 1]) +
+                              cache.access(indices[t * 3 + 2]);
+        if (t == 0 || misses == 3) {
+            hardBoundaries.push_back(t);
+        }
+    }
+    hardBoundaries.push_back(triangleCount);
+
+    // Soft boundaries: split a hard cluster again whenever the running ACMR of the
+    // current piece falls within threshold of the whole cluster's.
+    std::vector<size_t> clusters;
+    for (size_t c = 0; c + 1 < hardBoundaries.size(); c++) {
+        size_t start = hardBoundaries[c];
+        size_t end = hardBoundaries[c + 1];
+
+        cache.flush();
+        unsigned int clusterMisses = 0;
+        for (size_t t = start; t < end; t++) {
+            clusterMisses += cache.access(indices[t * 3]) + cache.access(indices[t * 3 + 1]) +
+                             cache.access(indices[t * 3 + 2]);
+        }
+        float clusterThreshold = threshold * clusterMisses / static_cast<float>(end - start);
+
+        cache.flush();
+        clusters.push_back(start);
+        unsigned int pieceMisses = 0;
+        size_t pieceStart = start;
+        for (size_t t = start; t < end; t++) {
+            pieceMisses += cache.access(indices[t * 3]) + cache.access(indices[t * 3 + 1]) +
+                           cache.access(indices[t * 3 + 2]);
+            float pieceAcmr = pieceMisses / static_cast<float>(t - pieceStart + 1);
+            if (t + 1 < end && pieceAcmr <= clusterThreshold) {
+                clusters.push_back(t + 1);
+                pieceStart = t + 1;
+                pieceMisses = 0;
+                cache.flush();
+            }
+        }
+    }
+    clusters.push_back(triangleCount);
+
+    // Area-weighted centroid and normal of every cluster and of the whole mesh.
+    size_t clusterCount = clusters.size() - 1;
+    std::vector<glm::vec3> centroids(clusterCount, glm::vec3(0.0f));
+    std::vector<glm::vec3> normals(clusterCount, glm::vec3(0.0f));
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+
+    for (size_t c = 0; c < clusterCount; c++) {
+        float clusterArea = 0.0f;
+        for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+            const glm::vec3& a = vertices[indices[t * 3]].Position;
+            const glm::vec3& b = vertices[indices[t * 3 + 1]].Position;
+            const glm::vec3& p = vertices[indices[t * 3 + 2]].Position;
+            glm::vec3 n = glm::cross(b - a, p - a);
+            float area = glm::length(n);
+            glm::vec3 center = (a + b + p) / 3.0f;
+
+            centroids[c] += center * area;
+            normals[c] += n;
+            clusterArea += area;
+        }
+        meshCentroid += centroids[c];
+        meshArea += clusterArea;
+        centroids[c] = clusterArea > 0.0f ? centroids[c] / clusterArea : glm::vec3(0.0f);
+        float length = glm::length(normals[c]);
+        normals[c] = length > 0.0f ? normals[c] / length : glm::vec3(0.0f);
+    }
+    meshCentroid = meshArea > 0.0f ? meshCentroid / meshArea : glm::vec3(0.0f);
+
+    // Clusters facing away from the mesh center are likely to occlude the rest.
+    std::vector<float> sortKeys(clusterCount);
+    std::vector<size_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++) {
+        sortKeys[c] = glm::dot(centroids[c] - meshCentroid, normals[c]);
+        order[c] = c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return sortKeys[a] > sortKeys[b];
+    });
+
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+    for (size_t c : order) {
+        output.insert(output.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+    }
+    indices.swap(output);
+}
+
+/**
+ * @brief Renumbers vertices in first-use order.
+ * @param vertices The vertices, reordered in place.
+ * @param indices The indices, rewritten to the new order.
+ */
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    std::vector<unsigned int> remap(vertices.size(), UINT_MAX);
+    std::vector<Vertex> ordered;
+    ordered.reserve(vertices.size());
+
+    for (unsigned int& index : indices) {
+        if (remap[index] == UINT_MAX) {
+            remap[index] = static_cast<unsigned int>(ordered.size());
+            ordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(ordered);
+}
+
+/**
+ * @brief Computes the average cache miss ratio of a triangle list.
+ * @param indices Triangle list indices.
+ * @param vertexCount Number of vertices the indices refer to.
+ * @param cacheSize Entries of the simulated FIFO cache.
+ * @return Vertex shader invocations per triangle.
+ */
+float computeACMR(const std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        return 0.0f;
+    }
+
+    FifoCache cache(vertexCount, cacheSize);
+    size_t misses = 0;
+    for (unsigned int index : indices) {
+        misses += cache.access(index);
+    }
+    return static_cast<float>(misses) / triangleCount;
+}
+
+/**
+ * @brief Runs the full optimization pass on one mesh.
+ * @param vertices The mesh vertices, modified in place.
+ * @param indices The mesh indices, modified in place.
+ * @return The before/after statistics.
+ */
+MeshOptimizationStats optimizeMesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    MeshOptimizationStats stats;
+    stats.triangles = indices.size() / 3;
+    stats.verticesBefore = vertices.size();
+    stats.acmrBefore = computeACMR(indices, vertices.size(), MESH_OPTIMIZER_CACHE_SIZE);
+
+    weldVertices(vertices, indices);
+    optimizeVertexCache(indices, vertices.size());
+    optimizeOverdraw(indices, vertices, OVERDRAW_THRESHOLD);
+    optimizeVertexFetch(vertices, indices);
+
+    stats.verticesAfter = vertices.size();
+    stats.acmrAfter = computeACMR(indices, vertices.size(), MESH_OPTIMIZER_CACHE_SIZE);
+    stats.atvrAfter = stats.verticesAfter > 0 ? stats.acmrAfter * stats.triangles / stats.verticesAfter : 0.0f;
+    return stats;
+}
@@ -0,0 +1,191 @@
+/**
+ * @file meshPool.cpp
+ * @brief Implements the shared vertex/index buffer pool for static meshes.
+ */
+
+#include "meshPool.h"
+#include "mesh.h"
+#include "glState.h"
+
+#include <algorithm>
+
+namespace {
+    // Initial sizes, enough for the current arena without growing.
+    const size_t INITIAL_VERTEX_CAPACITY = 64 * 1024;
+    const size_t INITIAL_INDEX_BYTES = 1024 * 1024;
+
+    /**
+     * @brief Replaces a buffer with a larger one, copying the used range on the GPU.
+     * @param buffer The buffer name, updated to the new buffer.
+     * @param usedBytes Bytes of live data to preserve.
+     * @param newCapacity Size of the new buffer in bytes.
+     */
+    void reallocateBuffer(GLuint& buffer, size_t usedBytes, size_t newCapacity) {
+        GLuint replacement = 0;
+        glGenBuffers(1, &replacement);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, replacement);
+        glBufferData(GL_COPY_WRITE_BUFFER, newCapacity, nullptr, GL_STATIC_DRAW);
+
+        if (buffer && usedBytes > 0) {
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedBytes);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        if (buffer) {
+            glDeleteBuffers(1, &buffer);
+        }
+        buffer = replacement;
+    }
+
+    /**
+     * @brief Returns the size of one index of the given GL type.
+     */
+    size_t indexSize(GLenum indexType) {
+        return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+    }
+}
+
+/**
+ * @brief Releases the pool's buffers and vertex arrays.
+ */
+MeshPool::~MeshPool() {
+    for (VertexArena& arena : arenas) {
+        if (arena.vao) glDeleteVertexArrays(1, &arena.vao);
+        if (arena.vbo) glDeleteBuffers(1, &arena.vbo);
+    }
+    if (ebo) glDeleteBuffers(1, &ebo);
+}
+
+/**
+ * @brief Creates the VAO and initial vertex buffer of a format on first use.
+ */
+void MeshPool::createArena(VertexFormat format) {
+    VertexArena& arena = arenas[static_cast<size_t>(format)];
+    arena.stride = vertexFormatStride(format);
+    glGenVertexArrays(1, &arena.vao);
+
+    if (!ebo) {
+        growIndices(INITIAL_INDEX_BYTES);
+    }
+    growVertices(format, INITIAL_VERTEX_CAPACITY);
+}
+
+/**
+ * @brief Grows a format's vertex buffer to hold at least the given number of vertices.
+ */
+void MeshPool::growVertices(VertexFormat format, size_t requiredVertices) {
+    VertexArena& arena = arenas[static_cast<size_t>(format)];
+    size_t newCapacity = std::max(requiredVertices, arena.capacity * 2);
+    reallocateBuffer(arena.vbo, arena.count * arena.stride, newCapacity * arena.stride);
+    arena.capacity = newCapacity;
+    // The attribute pointers captured the old buffer.
+    setupVertexArray(format);
+}
+
+/**
+ * @brief Grows the shared index buffer to hold at least the given number of bytes.
+ */
+void MeshPool::growIndices(size_t requiredBytes) {
+    size_t newCapacity = std::max(requiredBytes, indexCapacity * 2);
+    reallocateBuffer(ebo, indexBytes, newCapacity);
+    indexCapacity = newCapacity;
+
+    // The element buffer binding is VAO state, so every format's VAO needs the new buffer.
+    for (VertexArena& arena : arenas) {
+        if (!arena.vao) continue;
+        glState().bindVertexArray(arena.vao);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    }
+    glState().bindVertexArray(0);
+}
+
+/**
+ * @brief Describes a format's layout to its VAO and enables the instance attributes.
+ */
+void MeshPool::setupVertexArray(VertexFormat format) {
+    const VertexArena& arena = arenas[static_cast<size_t>(format)];
+    glState().bindVertexArray(arena.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, arena.vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+
+    describeVertexFormat(format);
+
+    // instance attributes advance once per instance; RenderQueue points them per batch
+    for (unsigned int i = 0; i < 5; i++) {
+        glEnableVertexAttribArray(Mesh::INSTANCE_MODEL_LOCATION + i);
+        glVertexAttribDivisor(Mesh::INSTANCE_MODEL_LOCATION + i, 1);
+    }
+
+    glState().bindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/**
+ * @brief Copies a mesh's vertices and indices into the pool.
+ * @param format The layout of vertexData.
+ * @param vertexData Encoded vertices.
+ * @param count Number of vertices.
+ * @param indexData Indices relative to the mesh's first vertex.
+ * @param indexType GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+ * @param indexCount Number of indices.
+ * @return The mesh's location in the pool.
+ */
+MeshAllocation MeshPool::allocate(VertexFormat format, const void* vertexData, size_t count,
+                                  const void* indexData, GLenum indexType, size_t indexCount) {
+    VertexArena& arena = arenas[static_cast<size_t>(format)];
+    if (!arena.vao) {
+        createArena(format);
+    }
+
+    // 32-bit ranges must start 4-byte aligned after an odd-length 16-bit range.
+    size_t elementSize = indexSize(indexType);
+    size_t indexStart = (indexBytes + elementSize - 1) / elementSize * elementSize;
+    size_t newIndexBytes = indexCount * elementSize;
+
+    if (arena.count + count > arena.capacity) {
+        growVertices(format, arena.count + count);
+    }
+    if (indexStart + newIndexBytes > indexCapacity) {
+        growIndices(indexStart + newIndexBytes);
+    }
+
+    MeshAllocation allocation;
+    allocation.format = format;
+    allocation.baseVertex = static_cast<GLint>(arena.count);
+    allocation.indexOffset = indexStart;
+    allocation.indexCount = static_cast<GLsizei>(indexCount);
+    allocation.indexType = indexType;
+
+    glBindBuffer(GL_ARRAY_BUFFER, arena.vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, arena.count * arena.stride, count * arena.stride, vertexData);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // Bind through the copy target so no VAO's element binding is touched.
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, indexStart, newIndexBytes, indexData);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    arena.count += count;
+    indexBytes = indexStart + newIndexBytes;
+    return allocation;
+}
+
+/**
+ * @brief Binds the VAO of a vertex format (and with it the pool's buffers).
+ */
+void MeshPool::bind(VertexFormat format) const {
+    glState().bindVertexArray(arenas[static_cast<size_t>(format)].vao);
+}
+
+/**
+ * @brief Returns the bytes of vertex data stored across all formats.
+ */
+size_t MeshPool::vertexBytesUsed() const {
+    size_t total = 0;
+    for (const VertexArena& arena : arenas) {
+        total += arena.count * arena.stride;
+    }
+    return total;
+}
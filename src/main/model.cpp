@@ -9,36 +9,79 @@
  */
 
 #include "model.h"
+#include "hash.h"
+
+#include <assimp/config.h>
+
+#include <algorithm>
 
 /**
  * @brief Constructs a Model object.
  * @param path The file path to the 3D model.
+ * @param pool The mesh pool that receives the model's geometry.
+ * @param textureLoader The loader that decodes and uploads the model's textures.
+ * @param materials The library the model's materials are resolved into.
+ * @param attributeMask The vertex attributes read by the shader that draws this model.
  * @param gamma A flag indicating whether to apply gamma correction.
+ * @param options Whether to keep a triangle BVH and the world transform to bake into a model that never moves.
  */
-Model::Model(std::string const &path, bool gamma) : gammaCorrection(gamma) {
-    loadModel(path);
+Model::Model(std::string const &path, MeshPool &pool, TextureLoader &textureLoader, MaterialLibrary &materials,
+             uint32_t attributeMask, bool gamma, const ModelLoadOptions &options)
+    : gammaCorrection(gamma), textureLoader(textureLoader), materials(materials), bvhRequested(options.buildBvh),
+      staticBatching(options.staticTransform != nullptr),
+      staticTransform(options.staticTransform ? *options.staticTransform : glm::mat4(1.0f)) {
+    loadModel(path, pool, attributeMask);
 }
 
 /**
- * @brief Renders all meshes in the model.
- * @param shader The shader program to use for drawing.
+ * @brief Gives every mesh a material with the same maps but the given parameters.
+ * @param shininess Specular exponent.
+ * @param alpha Material opacity.
+ * @param emissiveStrength Self-illumination strength (read by the EMISSIVE variants).
  */
-void Model::Draw(Shader &shader) {
-    for (unsigned int i = 0; i < meshes.size(); i++) {
-        meshes[i].Draw(shader);
+void Model::overrideMaterialParams(float shininess, float alpha, float emissiveStrength) {
+    for (Mesh& mesh : meshes) {
+        if (!mesh.material) continue;
+        MaterialParams params = mesh.material->params;
+        params.shininess = shininess;
+        params.alpha = alpha;
+        params.emissiveStrength = emissiveStrength;
+        mesh.material = materials.acquire(mesh.material->textures, params);
     }
 }
 
 /**
- * @brief Loads a model from a file using Assimp.
+ * @brief Loads a model and uploads it to the mesh pool, from the mesh cache when
+ * it is up to date and through Assimp otherwise.
  * @param path The file path of the model to load.
+ * @param pool The mesh pool that receives the geometry.
+ * @param attributeMask The vertex attributes read by the target shader.
  */
-void Model::loadModel(std::string const &path) {
+void Model::loadModel(std::string const &path, MeshPool &pool, uint32_t attributeMask) {
+    // Store the directory of the model file for loading textures.
+    directory = path.substr(0, path.find_last_of('/'));
+
+    uint64_t sourceHash = hashModelSources(path);
+    // The baked transform is part of the cached result.
+    if (sourceHash != 0 && staticBatching) {
+        sourceHash = fnv1a(&staticTransform, sizeof(staticTransform), sourceHash);
+    }
+    std::string cachePath = meshCachePath(path);
+    if (sourceHash != 0 && loadFromCache(cachePath, sourceHash, pool, attributeMask)) {
+        return;
+    }
+
     Assimp::Importer importer;
-    // Read the model file with post-processing flags.
-    const aiScene* scene = importer.ReadFile(path, 
-        aiProcess_Triangulate | aiProcess_GenSmoothNormals | 
-        aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+    // Read the model file with post-processing flags. Points and lines survive
+    // triangulation; splitting meshes by primitive type and dropping those
+    // parts leaves triangle lists only. Tangents are only worth computing when
+    // the shader reads them.
+    unsigned int flags = aiProcess_Triangulate | aiProcess_SortByPType | aiProcess_GenSmoothNormals | aiProcess_FlipUVs;
+    importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE);
+    if (attributeMask & TANGENT_SPACE_ATTRIBUTE_MASK) {
+        flags |= aiProcess_CalcTangentSpace;
+    }
+    const aiScene* scene = importer.ReadFile(path, flags);
 
     // Check for loading errors.
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
@@ -46,10 +89,145 @@ void Model::loadModel(std::string const &path) {
         return;
     }
 
-    // Store the directory of the model file for loading textures.
-    directory = path.substr(0, path.find_last_of('/'));
     // Start processing the nodes recursively from the root node.
     processNode(scene->mRootNode, scene);
+
+    // Everything below (sectors, batches, BVH) then works in world space.
+    if (staticBatching) {
+        bakeStaticTransform(meshes, staticTransform);
+    }
+
+    // Portals are polygons for the visibility walk, not geometry; they leave
+    // the mesh list before anything indexes it.
+    std::vector<Mesh> drawnMeshes;
+    drawnMeshes.reserve(meshes.size());
+    std::vector<glm::vec3> tagPositions;
+    for (size_t i = 0; i < meshes.size(); i++) {
+        if (SectorGraph::isTagged(meshNames[i])) {
+            tagPositions.clear();
+            for (const Vertex& vertex : meshes[i].vertices) {
+                tagPositions.push_back(vertex.Position);
+            }
+            uint32_t index = static_cast<uint32_t>(drawnMeshes.size());
+            if (sectors.addMesh(meshNames[i], tagPositions, meshes[i].indices, index)) continue;
+        }
+        drawnMeshes.push_back(std::move(meshes[i]));
+    }
+    meshes = std::move(drawnMeshes);
+    meshNames.clear();
+    sectors.finalize();
+
+    // One mesh per material and room; merging across rooms would defeat the portal culling.
+    if (staticBatching) {
+        std::vector<int> groups(meshes.size());
+        for (size_t i = 0; i < meshes.size(); i++) {
+            groups[i] = sectors.meshSector(static_cast<uint32_t>(i));
+        }
+        std::vector<uint32_t> meshMap;
+        batchStaticMeshes(meshes, groups, meshMap);
+        if (!sectors.empty()) {
+            sectors.remapMeshes(meshMap);
+        }
+    }
+
+    // The hierarchy needs the plain positions, which encoding drops.
+    if (bvhRequested) {
+        std::vector<glm::vec3> positions;
+        for (size_t i = 0; i < meshes.size(); i++) {
+            positions.clear();
+            for (const Vertex& vertex : meshes[i].vertices) {
+                positions.push_back(vertex.Position);
+            }
+            bvh.addMesh(positions, meshes[i].indices, static_cast<uint32_t>(i));
+        }
+        bvh.build();
+    }
+
+    // Move the geometry into the shared buffers; the CPU copies are dropped.
+    std::vector<EncodedGeometry> encodedMeshes;
+    encodedMeshes.reserve(meshes.size());
+    for (Mesh& mesh : meshes) {
+        loadStatistics.unpackedBytes += mesh.vertices.size() * sizeof(Vertex) +
+                                        mesh.indices.size() * sizeof(unsigned int);
+        encodedMeshes.push_back(mesh.encode(attributeMask));
+        mesh.upload(pool, encodedMeshes.back());
+        loadStatistics.gpuBytes += mesh.gpuBytes();
+    }
+
+    // Keep the processed result so the next launch can skip the import.
+    if (sourceHash != 0) {
+        std::vector<MeshCacheEntry> entries(meshes.size());
+        for (size_t i = 0; i < meshes.size(); i++) {
+            const EncodedGeometry& encoded = encodedMeshes[i];
+            MeshCacheEntry& entry = entries[i];
+            entry.format = encoded.format;
+            entry.indexType = encoded.indexType;
+            entry.vertexData = encoded.vertices.data();
+            entry.vertexCount = encoded.vertexCount;
+            entry.indexData = encoded.indices.data();
+            entry.indexCount = encoded.indexCount;
+            entry.boundsMin = meshes[i].boundsMin;
+            entry.boundsMax = meshes[i].boundsMax;
+            entry.boundsRadius = meshes[i].boundsRadius;
+            entry.positionDecode = meshes[i].positionDecode;
+            entry.material = meshes[i].material->params;
+            for (const Texture& texture : meshes[i].textures) {
+                entry.textures.push_back({ texture.type, texture.path });
+            }
+        }
+        std::vector<uint8_t> bvhData;
+        if (bvhRequested) {
+            bvh.serialize(bvhData);
+        }
+        std::vector<uint8_t> sectorData;
+        if (!sectors.empty()) {
+            sectors.serialize(sectorData);
+        }
+        writeMeshCache(cachePath, sourceHash, attributeMask, entries, bvhData, sectorData);
+    }
+}
+
+/**
+ * @brief Rebuilds the model from its mesh cache, uploading straight from the mapping.
+ * @param cachePath The cache file.
+ * @param sourceHash Hash of the current model sources.
+ * @param pool The mesh pool that receives the geometry.
+ * @param attributeMask The vertex attributes read by the target shader.
+ * @return True if the cache was current and the model is loaded.
+ */
+bool Model::loadFromCache(std::string const &cachePath, uint64_t sourceHash,
+                          MeshPool &pool, uint32_t attributeMask) {
+    MeshCacheReader reader;
+    if (!reader.open(cachePath, sourceHash, attributeMask)) {
+        return false;
+    }
+    // A cache written without the hierarchy cannot provide it; import again.
+    // The import appends to both, so neither may keep what was read here.
+    if ((bvhRequested && !bvh.deserialize(reader.bvhData(), reader.bvhSize())) ||
+        (reader.sectorSize() > 0 && !sectors.deserialize(reader.sectorData(), reader.sectorSize(),
+                                                         reader.meshes().size()))) {
+        bvh.clear();
+        sectors.clear();
+        return false;
+    }
+
+    meshes.reserve(reader.meshes().size());
+    for (const MeshCacheEntry& entry : reader.meshes()) {
+        std::vector<Texture> textures;
+        for (const MeshCacheTexture& reference : entry.textures) {
+            textures.push_back(loadTexture(reference.path, reference.type));
+        }
+
+        Mesh mesh(textures, entry.boundsMin, entry.boundsMax, entry.boundsRadius, entry.positionDecode);
+        mesh.material = resolveMaterial(textures, entry.material);
+        mesh.upload(pool, entry.format, entry.vertexData, entry.vertexCount,
+                    entry.indexData, entry.indexType, entry.indexCount);
+        loadStatistics.gpuBytes += mesh.gpuBytes();
+        meshes.push_back(mesh);
+    }
+
+    loadStatistics.fromCache = true;
+    return true;
 }
 
 /**
@@ -61,7 +239,15 @@ void Model::processNode(aiNode *node, const aiScene *scene) {
     // Process all meshes in the current node.
     for (unsigned int i = 0; i < node->mNumMeshes; i++) {
         aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+        // Everything is drawn and optimized as triangle lists.
+        if (mesh->mPrimitiveTypes != aiPrimitiveType_TRIANGLE) continue;
         meshes.push_back(processMesh(mesh, scene));
+        // Importers put the object name on the mesh or on its node; prefer whichever is tagged.
+        std::string name = mesh->mName.C_Str();
+        if (!SectorGraph::isTagged(name)) {
+            name = node->mName.C_Str();
+        }
+        meshNames.push_back(name);
     }
     // Recursively process all child nodes.
     for (unsigned int i = 0; i < node->mNumChildren; i++) {
@@ -82,7 +268,7 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene) {
 
     // Extract vertex data.
     for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
-        Vertex vertex;
+        Vertex vertex{};
         glm::vec3 vector;
 
         // Position
@@ -106,17 +292,20 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene) {
             vec.y = mesh->mTextureCoords[0][i].y;
             vertex.TexCoords = vec;
 
-            // Tangent
-            vector.x = mesh->mTangents[i].x;
-            vector.y = mesh->mTangents[i].y;
-            vector.z = mesh->mTangents[i].z;
-            vertex.Tangent = vector;
-
-            // Bitangent
-            vector.x = mesh->mBitangents[i].x;
-            vector.y = mesh->mBitangents[i].y;
-            vector.z = mesh->mBitangents[i].z;
-            vertex.Bitangent = vector;
+            // Tangents are only present when the importer was asked for them.
+            if (mesh->HasTangentsAndBitangents()) {
+                // Tangent
+                vector.x = mesh->mTangents[i].x;
+                vector.y = mesh->mTangents[i].y;
+                vector.z = mesh->mTangents[i].z;
+                vertex.Tangent = vector;
+
+                // Bitangent
+                vector.x = mesh->mBitangents[i].x;
+                vector.y = mesh->mBitangents[i].y;
+                vector.z = mesh->mBitangents[i].z;
+                vertex.Bitangent = vector;
+            }
         } else {
             vertex.TexCoords = glm::vec2(0.0f, 0.0f);
         }
@@ -148,8 +337,57 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene) {
     std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
     textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
+    // Weld duplicates and reorder for the vertex cache, overdraw and fetch.
+    optimizationStats += optimizeMesh(vertices, indices);
+
     // Return a new Mesh object created from the extracted data.
-    return Mesh(vertices, indices, textures);
+    Mesh result(vertices, indices, textures);
+    result.material = resolveMaterial(textures, loadMaterialParams(material, !diffuseMaps.empty()));
+    return result;
+}
+
+/**
+ * @brief Reads the parameters of a material.
+ * @param mat The Assimp material.
+ * @param hasDiffuseMap Whether the material has a diffuse map; otherwise its diffuse color is used.
+ * @return The parameters, with defaults for whatever the file leaves out.
+ */
+MaterialParams Model::loadMaterialParams(aiMaterial *mat, bool hasDiffuseMap) {
+    MaterialParams params;
+    // With a map the color would tint it; exporters write a gray default there.
+    aiColor3D color(1.0f, 1.0f, 1.0f);
+    if (!hasDiffuseMap && mat->Get(AI_MATKEY_COLOR_DIFFUSE, color) == AI_SUCCESS) {
+        params.diffuseColor = glm::vec4(color.r, color.g, color.b, 1.0f);
+    }
+    float value = 0.0f;
+    if (mat->Get(AI_MATKEY_SHININESS, value) == AI_SUCCESS && value > 0.0f) {
+        params.shininess = value;
+    }
+    if (mat->Get(AI_MATKEY_OPACITY, value) == AI_SUCCESS) {
+        params.alpha = value;
+    }
+    aiColor3D emissive(0.0f, 0.0f, 0.0f);
+    if (mat->Get(AI_MATKEY_COLOR_EMISSIVE, emissive) == AI_SUCCESS) {
+        params.emissiveStrength = std::max(emissive.r, std::max(emissive.g, emissive.b));
+    }
+    return params;
+}
+
+/**
+ * @brief Puts the first texture of each slot and the parameters into a shared material.
+ * @param textures The mesh's textures, tagged with their sampler type.
+ * @param params The material parameters.
+ * @return The material from the library.
+ */
+const Material *Model::resolveMaterial(const std::vector<Texture> &textures, const MaterialParams &params) {
+    GLuint slots[MATERIAL_TEXTURE_SLOTS] = {};
+    for (const Texture& texture : textures) {
+        MaterialTextureSlot slot = materialTextureSlot(texture.type);
+        if (slot < MATERIAL_TEXTURE_SLOTS && !slots[slot]) {
+            slots[slot] = texture.id;
+        }
+    }
+    return materials.acquire(slots, params);
 }
 
 /**
@@ -165,25 +403,30 @@ std::vector<Texture> Model::loadMaterialTextures(aiMaterial *mat, aiTextureType
         aiString str;
         mat->GetTexture(type, i, &str);
 
-        // Prevent loading the same texture multiple times.
-        bool skip = false;
-        for (unsigned int j = 0; j < textures_loaded.size(); j++) {
-            if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0) {
-                textures.push_back(textures_loaded[j]);
-                skip = true;
-                break;
-            }
-        }
+        textures.push_back(loadTexture(str.C_Str(), typeName));
+    }
+    return textures;
+}
 
-        if (!skip) {
-            // If the texture hasn't been loaded yet, load it.
-            Texture texture;
-            texture.id = TextureFromFile(str.C_Str(), this->directory);
-            texture.type = typeName;
-            texture.path = str.C_Str();
-            textures.push_back(texture);
-            textures_loaded.push_back(texture); // Add to loaded textures cache.
+/**
+ * @brief Returns a texture of this model, loading it on first use.
+ * @param path The texture path relative to the model directory.
+ * @param typeName The sampler type name (e.g. "texture_diffuse").
+ * @return The texture.
+ */
+Texture Model::loadTexture(const std::string &path, const std::string &typeName) {
+    // Prevent loading the same texture multiple times.
+    for (unsigned int j = 0; j < textures_loaded.size(); j++) {
+        if (textures_loaded[j].path == path) {
+            return textures_loaded[j];
         }
     }
-    return textures;
+
+    // If the texture hasn't been loaded yet, load it.
+    Texture texture;
+    texture.id = textureLoader.load(directory + '/' + path);
+    texture.type = typeName;
+    texture.path = path;
+    textures_loaded.push_back(texture); // Add to loaded textures cache.
+    return texture;
 }
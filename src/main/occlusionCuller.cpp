@@ -0,0 +1,416 @@
+/**
+ * @file occlusionCuller.cpp
+ * @brief Hi-Z pyramid occlusion tests and box-query conditional rendering.
+ *
+ * The frustum and fog tests keep everything in front of the camera, including
+ * rooms on the other side of a wall. Both modes here reject those draws using
+ * the level's own depth: the Hi-Z mode through a pyramid read back a few
+ * frames late, the conditional mode through queries the GPU resolves itself.
+ */
+
+#include "occlusionCuller.h"
+#include "shaderVariants.h"
+#include "frameConstants.h"
+#include "glState.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace {
+    // The visibility target holds one R8 texel per candidate.
+    const int VISIBILITY_WIDTH = 256;
+    const int VISIBILITY_ROWS = 64;
+    const size_t MAX_CANDIDATES = static_cast<size_t>(VISIBILITY_WIDTH) * VISIBILITY_ROWS;
+    const int CANDIDATE_FLOATS = 6; // center xyz, half extent xyz
+}
+
+/**
+ * @brief Creates the occluder target, the pyramid, the readback ring and the pass programs.
+ * @param width Width of the occluder depth target, which is also pyramid level 0.
+ * @param height Height of the occluder depth target.
+ */
+OcclusionCuller::OcclusionCuller(int width, int height)
+    : width(width), height(height), levels(1) {
+    while ((std::max(width, height) >> levels) > 0) {
+        levels++;
+    }
+
+    createTargets();
+    createBox();
+
+    glGenVertexArrays(1, &emptyVAO);
+
+    glGenVertexArrays(1, &candidateVAO);
+    glGenBuffers(1, &candidateVBO);
+    glBindVertexArray(candidateVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, candidateVBO);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, CANDIDATE_FLOATS * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, CANDIDATE_FLOATS * sizeof(float), (void*)(3 * sizeof(float)));
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    reduceShader = new Shader("shaders/occlusion/hizVs.glsl", "shaders/occlusion/hizReduceFs.glsl");
+    testShader = new Shader("shaders/occlusion/occlusionTestVs.glsl", "shaders/occlusion/occlusionTestFs.glsl",
+                            shaderVariantHeader(0));
+    boxShader = new Shader("shaders/occlusion/boxVs.glsl", "shaders/depth/depthFs.glsl", shaderVariantHeader(0));
+
+    testShader->bindUniformBlock("FrameConstants", FRAME_CONSTANTS_BINDING);
+    boxShader->bindUniformBlock("FrameConstants", FRAME_CONSTANTS_BINDING);
+    reduceShader->use();
+    reduceShader->setInt("source", OCCLUSION_PYRAMID_TEXTURE_UNIT);
+    testShader->use();
+    testShader->setInt("hiZ", OCCLUSION_PYRAMID_TEXTURE_UNIT);
+    testShader->setInt("hiZLevels", levels);
+    testShader->setVec2("targetSize", glm::vec2(VISIBILITY_WIDTH, VISIBILITY_ROWS));
+    glState().useProgram(0);
+
+    // Set per pyramid level and per queried box.
+    reduceUniform = reduceShader->uniform("reduce");
+    boxMinUniform = boxShader->uniform("boxMin");
+    boxMaxUniform = boxShader->uniform("boxMax");
+}
+
+/**
+ * @brief Releases the framebuffers, textures, buffers, fences, queries and programs.
+ */
+OcclusionCuller::~OcclusionCuller() {
+    delete reduceShader;
+    delete testShader;
+    delete boxShader;
+
+    for (Readback& slot : readbacks) {
+        if (slot.fence) {
+            glDeleteSync(slot.fence);
+        }
+        glDeleteBuffers(1, &slot.pbo);
+    }
+    for (std::vector<GLuint>& pool : queries) {
+        if (!pool.empty()) {
+            glDeleteQueries(static_cast<GLsizei>(pool.size()), pool.data());
+        }
+    }
+
+    GLuint framebuffers[] = { occluderBuffer, pyramidBuffer, visibilityBuffer };
+    glDeleteFramebuffers(3, framebuffers);
+    GLuint textures[] = { occluderDepth, pyramid, visibilityTexture };
+    glDeleteTextures(3, textures);
+    GLuint buffers[] = { candidateVBO, boxVBO, boxEBO };
+    glDeleteBuffers(3, buffers);
+    GLuint vertexArrays[] = { candidateVAO, emptyVAO, boxVAO };
+    glDeleteVertexArrays(3, vertexArrays);
+}
+
+/**
+ * @brief Creates the occluder depth target, the pyramid with its full mip chain,
+ * the visibility target and the pixel buffers it is read back through.
+ */
+void OcclusionCuller::createTargets() {
+    glGenTextures(1, &occluderDepth);
+    glBindTexture(GL_TEXTURE_2D, occluderDepth);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    // Every level is allocated up front; the reduction fills them each frame.
+    glGenTextures(1, &pyramid);
+    glBindTexture(GL_TEXTURE_2D, pyramid);
+    for (int level = 0; level < levels; level++) {
+        glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, std::max(1, width >> level), std::max(1, height >> level), 0,
+                     GL_RED, GL_FLOAT, nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+    glGenTextures(1, &visibilityTexture);
+    glBindTexture(GL_TEXTURE_2D, visibilityTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, VISIBILITY_WIDTH, VISIBILITY_ROWS, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &occluderBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, occluderBuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, occluderDepth, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    bool occluderComplete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+    glGenFramebuffers(1, &pyramidBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, pyramidBuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pyramid, 0);
+    bool pyramidComplete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+    glGenFramebuffers(1, &visibilityBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, visibilityBuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, visibilityTexture, 0);
+    bool visibilityComplete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    for (Readback& slot : readbacks) {
+        glGenBuffers(1, &slot.pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, MAX_CANDIDATES, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    complete = occluderComplete && pyramidComplete && visibilityComplete;
+    if (!complete) {
+        std::cerr << "ERROR::OCCLUSION::FRAMEBUFFER_INCOMPLETE" << std::endl;
+    }
+}
+
+/**
+ * @brief Builds the unit cube the query boxes are stretched from.
+ */
+void OcclusionCuller::createBox() {
+    const float corners[] = {
+        0.0f, 0.0f, 0.0f,  1.0f, 0.0f, 0.0f,  1.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f,
+        0.0f, 0.0f, 1.0f,  1.0f, 0.0f, 1.0f,  1.0f, 1.0f, 1.0f,  0.0f, 1.0f, 1.0f
+    };
+    // Culling is off while the boxes are drawn, so the winding does not matter.
+    const unsigned int indices[] = {
+        0, 1, 2, 0, 2, 3,  4, 6, 5, 4, 7, 6,
+        0, 4, 5, 0, 5, 1,  3, 2, 6, 3, 6, 7,
+        0, 3, 7, 0, 7, 4,  1, 5, 6, 1, 6, 2
+    };
+
+    glGenVertexArrays(1, &boxVAO);
+    glGenBuffers(1, &boxVBO);
+    glGenBuffers(1, &boxEBO);
+
+    glBindVertexArray(boxVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, boxVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, boxEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/**
+ * @brief Applies every readback whose fence has passed, oldest first, without waiting on the rest.
+ *
+ * Each result replaces the previous one: meshes it did not test count as
+ * visible, and a mesh drawn several times is hidden only if every instance was.
+ */
+void OcclusionCuller::collect() {
+    for (int offset = 0; offset < READBACK_SLOTS; offset++) {
+        Readback& slot = readbacks[(frameIndex + offset) % READBACK_SLOTS];
+        if (!slot.fence) continue;
+
+        GLenum status = glClientWaitSync(slot.fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) continue;
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        const uint8_t* verdicts = static_cast<const uint8_t*>(
+            glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.meshes.size(), GL_MAP_READ_BIT));
+        if (verdicts) {
+            std::fill(visibility.begin(), visibility.end(), 1);
+            for (uint32_t mesh : slot.meshes) {
+                if (mesh >= visibility.size()) {
+                    visibility.resize(mesh + 1, 1);
+                }
+                visibility[mesh] = 0;
+            }
+
+            unsigned int occluded = 0;
+            for (size_t i = 0; i < slot.meshes.size(); i++) {
+                if (verdicts[i]) {
+                    visibility[slot.meshes[i]] = 1;
+                } else {
+                    occluded++;
+                }
+            }
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+
+            lastStats.tested = static_cast<unsigned int>(slot.meshes.size());
+            lastStats.occluded = occluded;
+            lastStats.latencyFrames = frameIndex - slot.frame;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+}
+
+/**
+ * @brief Drops pending readbacks and marks everything visible, e.g. while the Hi-Z mode is off,
+ * so turning it back on never applies a verdict from an old view.
+ */
+void OcclusionCuller::reset() {
+    for (Readback& slot : readbacks) {
+        if (slot.fence) {
+            glDeleteSync(slot.fence);
+            slot.fence = nullptr;
+        }
+    }
+    std::fill(visibility.begin(), visibility.end(), 1);
+}
+
+/**
+ * @brief Binds the occluder target at its own resolution and clears its depth.
+ */
+void OcclusionCuller::beginOccluders() {
+    glBindFramebuffer(GL_FRAMEBUFFER, occluderBuffer);
+    glViewport(0, 0, width, height);
+    glState().depthMask(true);
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+/**
+ * @brief Copies the occluder depth into pyramid level 0 and reduces it level by level.
+ *
+ * Each pass renders into one level while reading the one below; the base and
+ * max level are narrowed to the source so the two never overlap.
+ */
+void OcclusionCuller::buildPyramid() {
+    GLStateCache& state = glState();
+    glBindFramebuffer(GL_FRAMEBUFFER, pyramidBuffer);
+    // The level range edits below go to the texture bound on the active unit.
+    state.activeTexture(OCCLUSION_PYRAMID_TEXTURE_UNIT);
+    reduceShader->use();
+    state.bindVertexArray(emptyVAO);
+
+    for (int level = 0; level < levels; level++) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pyramid, level);
+        glViewport(0, 0, std::max(1, width >> level), std::max(1, height >> level));
+        if (level == 0) {
+            state.bindTexture(OCCLUSION_PYRAMID_TEXTURE_UNIT, GL_TEXTURE_2D, occluderDepth);
+            reduceShader->setBool(reduceUniform, false);
+        } else {
+            state.bindTexture(OCCLUSION_PYRAMID_TEXTURE_UNIT, GL_TEXTURE_2D, pyramid);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+            reduceShader->setBool(reduceUniform, true);
+        }
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+
+    state.bindTexture(OCCLUSION_PYRAMID_TEXTURE_UNIT, GL_TEXTURE_2D, pyramid);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+}
+
+/**
+ * @brief Tests the candidates against this frame's occluders and queues the readback of the verdicts.
+ * @param candidates Bounds to test; the ones past the visibility target's capacity stay visible.
+ * @param viewport The window viewport to restore afterwards.
+ */
+void OcclusionCuller::testCandidates(const std::vector<OcclusionCandidate>& candidates, const GLint viewport[4]) {
+    buildPyramid();
+
+    // A slot still in flight after a full ring means the GPU is far behind; skip a test then.
+    Readback& slot = readbacks[frameIndex % READBACK_SLOTS];
+    size_t count = std::min(candidates.size(), MAX_CANDIDATES);
+    if (count > 0 && !slot.fence) {
+        candidateData.clear();
+        slot.meshes.clear();
+        for (size_t i = 0; i < count; i++) {
+            const OcclusionCandidate& candidate = candidates[i];
+            candidateData.insert(candidateData.end(), { candidate.center.x, candidate.center.y, candidate.center.z,
+                                                        candidate.halfExtent.x, candidate.halfExtent.y,
+                                                        candidate.halfExtent.z });
+            slot.meshes.push_back(candidate.mesh);
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, candidateVBO);
+        size_t bytes = candidateData.size() * sizeof(float);
+        if (bytes > candidateCapacity) {
+            candidateCapacity = bytes * 2;
+        }
+        glBufferData(GL_ARRAY_BUFFER, candidateCapacity, nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, candidateData.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        GLsizei rows = static_cast<GLsizei>((count + VISIBILITY_WIDTH - 1) / VISIBILITY_WIDTH);
+        glBindFramebuffer(GL_FRAMEBUFFER, visibilityBuffer);
+        glViewport(0, 0, VISIBILITY_WIDTH, rows);
+        glState().bindTexture(OCCLUSION_PYRAMID_TEXTURE_UNIT, GL_TEXTURE_2D, pyramid);
+        testShader->use();
+        glState().bindVertexArray(candidateVAO);
+        glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(count));
+
+        // The copy into the pixel buffer is queued like a draw; the fence tells when it landed.
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, VISIBILITY_WIDTH, rows, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.frame = frameIndex;
+    }
+    frameIndex++;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glState().bindVertexArray(0);
+}
+
+/**
+ * @brief Counts how many of the box queries issued two frames ago came back empty.
+ */
+void OcclusionCuller::beginQueryFrame() {
+    unsigned int parity = queryFrame & 1;
+    size_t used = queriesUsed[parity];
+    if (used > 0) {
+        // Queries finish in order, so the last one being done means all are.
+        GLint available = 0;
+        glGetQueryObjectiv(queries[parity][used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            unsigned int skipped = 0;
+            for (size_t i = 0; i < used; i++) {
+                GLuint anyPassed = 0;
+                glGetQueryObjectuiv(queries[parity][i], GL_QUERY_RESULT, &anyPassed);
+                if (!anyPassed) {
+                    skipped++;
+                }
+            }
+            lastStats.conditionalQueries = static_cast<unsigned int>(used);
+            lastStats.conditionalSkipped = skipped;
+        }
+    }
+    queriesUsed[parity] = 0;
+    queryFrame++;
+}
+
+/**
+ * @brief Draws a box against the current depth with an any-samples query.
+ * @param boxMin Minimum corner in world space.
+ * @param boxMax Maximum corner in world space.
+ * @param restoreDepthWrites The depth mask of the layer being drawn, restored afterwards.
+ * @return The query to pass to glBeginConditionalRender.
+ *
+ * Leaves the box program and vertex array bound; the caller rebinds its own.
+ */
+GLuint OcclusionCuller::queryBox(const glm::vec3& boxMin, const glm::vec3& boxMax, bool restoreDepthWrites) {
+    std::vector<GLuint>& pool = queries[queryFrame & 1];
+    size_t& used = queriesUsed[queryFrame & 1];
+    if (used == pool.size()) {
+        GLuint query = 0;
+        glGenQueries(1, &query);
+        pool.push_back(query);
+    }
+    GLuint query = pool[used++];
+
+    GLStateCache& state = glState();
+    state.colorMask(false);
+    state.depthMask(false);
+    boxShader->use();
+    boxShader->setVec3(boxMinUniform, boxMin);
+    boxShader->setVec3(boxMaxUniform, boxMax);
+    state.bindVertexArray(boxVAO);
+
+    glBeginQuery(GL_ANY_SAMPLES_PASSED, query);
+    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    glEndQuery(GL_ANY_SAMPLES_PASSED);
+
+    state.colorMask(true);
+    state.depthMask(restoreDepthWrites);
+    return query;
+}
@@ -0,0 +1,155 @@
+/**
+ * @file programCache.cpp
+ * @brief Saves linked shader programs with glGetProgramBinary and restores them on later runs.
+ *
+ * Each program is stored in its own file named after its cache key:
+ *   header (magic, version, key, binary format, length) | driver binary
+ */
+
+#include "programCache.h"
+#include "config.h"
+#include "glCaps.h"
+#include "hash.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace {
+    const char PROGRAM_CACHE_MAGIC[4] = { 'P', 'S', 'P', 'B' };
+
+    struct FileHeader {
+        char magic[4];
+        uint32_t version;
+        uint64_t key;
+        uint32_t binaryFormat;
+        uint32_t length;
+    };
+
+    /**
+     * @brief Returns the cache file of a key.
+     */
+    std::string programCachePath(uint64_t key) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+        return std::string(SHADER_CACHE_DIRECTORY) + '/' + name;
+    }
+}
+
+/**
+ * @brief Returns true if program binaries can be saved on this context.
+ */
+bool programBinaryCacheEnabled() {
+    return glCaps().programBinary && glCaps().programBinaryFormats > 0;
+}
+
+/**
+ * @brief Hashes the sources, defines and driver identity of a program.
+ */
+uint64_t programCacheKey(const std::string& vertexSource, const std::string& fragmentSource,
+                         const std::string& defines) {
+    const GLCaps& caps = glCaps();
+    const char separator = '\0';
+
+    uint64_t hash = fnv1a(&PROGRAM_CACHE_VERSION, sizeof(PROGRAM_CACHE_VERSION));
+    for (const std::string* part : { &caps.vendor, &caps.renderer, &caps.version, &defines,
+                                     &vertexSource, &fragmentSource }) {
+        hash = fnv1a(*part, hash);
+        hash = fnv1a(&separator, 1, hash);
+    }
+    return hash;
+}
+
+/**
+ * @brief Loads a cached binary into a program object.
+ * @param key The program's cache key.
+ * @param program A program object with nothing attached.
+ * @return True if the program is linked from the cache.
+ */
+bool loadProgramBinary(uint64_t key, GLuint program) {
+    if (!programBinaryCacheEnabled()) {
+        return false;
+    }
+
+    std::ifstream file(programCachePath(key), std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    FileHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != PROGRAM_CACHE_VERSION || header.key != key || header.length == 0) {
+        return false;
+    }
+
+    std::vector<char> binary(header.length);
+    if (!file.read(binary.data(), header.length)) {
+        return false;
+    }
+
+    glProgramBinary(program, header.binaryFormat, binary.data(), static_cast<GLsizei>(header.length));
+
+    // Drivers reject binaries from other versions or hardware; the caller compiles instead.
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    return linked == GL_TRUE;
+}
+
+/**
+ * @brief Writes a linked program's binary to the cache.
+ * @param key The program's cache key.
+ * @param program A successfully linked program.
+ */
+void storeProgramBinary(uint64_t key, GLuint program) {
+    if (!programBinaryCacheEnabled()) {
+        return;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    std::vector<char> binary(length);
+    GLenum binaryFormat = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &binaryFormat, binary.data());
+    if (written <= 0) {
+        return;
+    }
+
+    FileHeader header;
+    std::memcpy(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic));
+    header.version = PROGRAM_CACHE_VERSION;
+    header.key = key;
+    header.binaryFormat = binaryFormat;
+    header.length = static_cast<uint32_t>(written);
+
+    std::error_code error;
+    std::filesystem::create_directories(SHADER_CACHE_DIRECTORY, error);
+
+    std::string path = programCachePath(key);
+    std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            std::cerr << "Program cache: cannot write " << temporaryPath << std::endl;
+            return;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(binary.data(), written);
+        if (!file) {
+            std::cerr << "Program cache: write failed for " << temporaryPath << std::endl;
+            return;
+        }
+    }
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error) {
+        std::filesystem::remove(temporaryPath, error);
+    }
+}
@@ -0,0 +1,539 @@
+/**
+ * @file renderQueue.cpp
+ * @brief Implements the sort-keyed draw queue used by the Renderer.
+ *
+ * Draws are collected per frame, sorted by a packed 64-bit key and submitted
+ * in one pass that only touches GL state when it actually changes.
+ */
+
+#include "renderQueue.h"
+#include "glState.h"
+#include "shaderVariants.h"
+
+#include <algorithm>
+#include <cstddef>
+
+namespace {
+    const int DEPTH_BITS = 24;
+    const uint64_t DEPTH_MAX = (1ull << DEPTH_BITS) - 1;
+
+    /**
+     * @brief Quantizes a view distance into the sort key depth field.
+     */
+    uint64_t quantizeDepth(float depth, float farPlane) {
+        float normalized = glm::clamp(depth / farPlane, 0.0f, 1.0f);
+        return static_cast<uint64_t>(normalized * static_cast<float>(DEPTH_MAX));
+    }
+
+    // World-space bounds of a mesh under a transform.
+    struct WorldBounds {
+        glm::vec3 center;
+        glm::vec3 halfExtent;
+        float radius;
+    };
+
+    /**
+     * @brief Moves a mesh's box and sphere to world space.
+     *
+     * The box stays axis-aligned by summing the absolute transformed axes; the
+     * sphere grows with the largest axis scale.
+     */
+    WorldBounds worldBounds(const Mesh& mesh, const glm::mat4& transform) {
+        glm::mat3 linear(transform);
+        glm::vec3 extent = (mesh.boundsMax - mesh.boundsMin) * 0.5f;
+        float scale = glm::max(glm::length(linear[0]), glm::max(glm::length(linear[1]), glm::length(linear[2])));
+
+        WorldBounds bounds;
+        bounds.center = glm::vec3(transform * glm::vec4(mesh.boundsCenter(), 1.0f));
+        bounds.halfExtent = glm::abs(linear[0]) * extent.x + glm::abs(linear[1]) * extent.y +
+                            glm::abs(linear[2]) * extent.z;
+        bounds.radius = mesh.boundsRadius * scale;
+        return bounds;
+    }
+}
+
+/**
+ * @brief Releases the overdraw queries.
+ */
+RenderQueue::~RenderQueue() {
+    if (prepassQueries[0]) {
+        glDeleteQueries(2, prepassQueries);
+    }
+    for (std::vector<GLuint>& queries : shadingQueries) {
+        if (!queries.empty()) {
+            glDeleteQueries(static_cast<GLsizei>(queries.size()), queries.data());
+        }
+    }
+}
+
+/**
+ * @brief Starts a new frame, discarding the previous frame's draws.
+ * @param position The camera position used for depth sorting.
+ * @param farDistance The far plane distance used to normalize depths.
+ * @param viewProjection The camera's projection times view matrix, for culling.
+ */
+void RenderQueue::begin(const glm::vec3& position, float farDistance, const glm::mat4& viewProjection) {
+    items.clear();
+    cameraPosition = position;
+    farPlane = farDistance;
+    culler.begin(viewProjection);
+    fogCulledCount = 0;
+    bvhCulledCount = 0;
+}
+
+/**
+ * @brief Queues every mesh of a model.
+ * @param model The model to draw.
+ * @param program The program to draw it with.
+ * @param transform The model matrix.
+ * @param layer The layer, which decides blending, depth state and sort direction.
+ * @param alpha Per-instance alpha for blended programs.
+ */
+void RenderQueue::submit(const Model& model, const RenderProgram& program, const glm::mat4& transform,
+                         RenderLayer layer, float alpha) {
+    for (const Mesh& mesh : model.meshes) {
+        WorldBounds bounds = worldBounds(mesh, transform);
+        push(mesh, program, transform, bounds.center, bounds.halfExtent, bounds.radius, layer, alpha);
+    }
+}
+
+/**
+ * @brief Queues every mesh of a model with the cheapest shader variant that still looks the same,
+ * skipping meshes the fog hides completely.
+ * @param model The model to draw.
+ * @param variants The variants of the program to draw it with.
+ * @param context This frame's camera and lights, which decide the features each mesh needs.
+ * @param transform The model matrix.
+ * @param layer The layer, which decides blending, depth state and sort direction.
+ * @param alpha Per-instance alpha for blended programs.
+ * @param visibleMeshes Optional per-mesh visibility, e.g. from TriangleBVH::queryFrustum.
+ */
+void RenderQueue::submit(const Model& model, const ShaderVariantSet& variants, const ShaderVariantContext& context,
+                         const glm::mat4& transform, RenderLayer layer, float alpha,
+                         const std::vector<uint8_t>* visibleMeshes) {
+    bool fogCulling = variants.fadesOutInFog();
+    for (size_t i = 0; i < model.meshes.size(); i++) {
+        const Mesh& mesh = model.meshes[i];
+        if (visibleMeshes && i < visibleMeshes->size() && !(*visibleMeshes)[i]) {
+            bvhCulledCount++;
+            continue;
+        }
+        WorldBounds bounds = worldBounds(mesh, transform);
+        // Past the fog wall the mesh would come out as FOG_COLOR, the same as the clear.
+        if (fogCulling && context.hiddenByFog(bounds.center, bounds.radius)) {
+            fogCulledCount++;
+            continue;
+        }
+        const RenderProgram& program = variants.select(context.requiredFeatures(bounds.center, bounds.radius));
+        push(mesh, program, transform, bounds.center, bounds.halfExtent, bounds.radius, layer, alpha);
+    }
+}
+
+/**
+ * @brief Adds one mesh draw with its world-space bounds.
+ */
+void RenderQueue::push(const Mesh& mesh, const RenderProgram& program, const glm::mat4& transform,
+                       const glm::vec3& center, const glm::vec3& halfExtent, float radius,
+                       RenderLayer layer, float alpha) {
+    float depth = glm::length(center - cameraPosition);
+    uint32_t cullIndex = culler.add(center, halfExtent, radius);
+    // Packed meshes store quantized positions; their decode matrix is folded
+    // into the instance transform so the shaders need no extra uniform.
+    DrawItem item{ &mesh, &program, transform * mesh.positionDecode, layer, depth, alpha, 0, cullIndex,
+                   center, halfExtent };
+    items.push_back(item);
+}
+
+/**
+ * @brief Builds the sort key of a draw.
+ */
+uint64_t RenderQueue::makeKey(const DrawItem& item) const {
+    uint64_t layer = static_cast<uint64_t>(item.layer) & 0x3;
+    uint64_t program = item.program->sortId;
+    uint64_t material = item.mesh->materialKey() & 0xFFFF;
+    uint64_t mesh = item.mesh->id & 0x3FFF;
+    uint64_t depth = quantizeDepth(item.depth, farPlane);
+
+    if (item.layer == RenderLayer::Transparent) {
+        // Back-to-front: the farthest draw gets the smallest key.
+        uint64_t inverted = DEPTH_MAX - depth;
+        return (layer << 62) | (inverted << 38) | (program << 30) | (material << 14) | mesh;
+    }
+    // The mesh sits above depth so every copy of a mesh ends up in one run.
+    return (layer << 62) | (program << 54) | (material << 38) | (mesh << 24) | depth;
+}
+
+/**
+ * @brief Culls the queued draws against the frustum and the Hi-Z verdicts, then keys and orders the survivors.
+ */
+void RenderQueue::sort() {
+    // One batched pass over all bounds of the frame.
+    culler.cull();
+
+    order.clear();
+    order.reserve(items.size());
+    candidates.clear();
+    occlusionCulledCount = 0;
+    for (uint32_t i = 0; i < items.size(); i++) {
+        if (!culler.visible(items[i].cullIndex)) continue;
+
+        // The overlay is drawn over a cleared depth buffer, so nothing hides it.
+        if (items[i].layer != RenderLayer::Overlay) {
+            uint32_t id = items[i].mesh->id;
+            candidates.push_back({ id, items[i].center, items[i].halfExtent });
+            if (occlusionVisibility && id < occlusionVisibility->size() && !(*occlusionVisibility)[id]) {
+                occlusionCulledCount++;
+                continue;
+            }
+        }
+
+        items[i].key = makeKey(items[i]);
+        order.emplace_back(items[i].key, i);
+    }
+    std::sort(order.begin(), order.end());
+    buildBatches();
+}
+
+/**
+ * @brief Merges runs of sorted draws that share mesh, program and layer into batches
+ * and lays out their instance data contiguously in batch order.
+ */
+void RenderQueue::buildBatches() {
+    batches.clear();
+    instances.clear();
+    instances.reserve(order.size());
+
+    for (const auto& entry : order) {
+        const DrawItem& item = items[entry.second];
+
+        bool extends = !batches.empty() &&
+                       batches.back().mesh == item.mesh &&
+                       batches.back().program == item.program &&
+                       batches.back().layer == item.layer;
+        if (!extends) {
+            DrawBatch batch{ item.mesh, item.program, item.layer, static_cast<uint32_t>(instances.size()), 0,
+                             item.center - item.halfExtent, item.center + item.halfExtent };
+            batches.push_back(batch);
+        }
+
+        instances.push_back({ item.transform, glm::vec4(item.alpha, 0.0f, 0.0f, 0.0f) });
+        DrawBatch& batch = batches.back();
+        batch.instanceCount++;
+        batch.boundsMin = glm::min(batch.boundsMin, item.center - item.halfExtent);
+        batch.boundsMax = glm::max(batch.boundsMax, item.center + item.halfExtent);
+    }
+}
+
+/**
+ * @brief Copies the frame's instance data into the next region of the instance stream.
+ */
+void RenderQueue::uploadInstances() {
+    size_t bytes = instances.size() * sizeof(InstanceData);
+    instanceStream.begin(bytes);
+    instanceOffset = std::max<GLintptr>(instanceStream.write(instances.data(), bytes, sizeof(glm::vec4)), 0);
+}
+
+/**
+ * @brief Points the bound VAO's instance attributes at a batch's slice of the instance buffer.
+ *
+ * GL 3.3 has no base instance, so the attribute offsets carry the batch start instead.
+ */
+void RenderQueue::bindInstanceAttributes(const DrawBatch& batch) const {
+    const GLsizei stride = sizeof(InstanceData);
+    size_t base = static_cast<size_t>(instanceOffset) + static_cast<size_t>(batch.firstInstance) * sizeof(InstanceData);
+
+    for (unsigned int column = 0; column < 4; column++) {
+        glVertexAttribPointer(Mesh::INSTANCE_MODEL_LOCATION + column, 4, GL_FLOAT, GL_FALSE, stride,
+                              (void*)(base + offsetof(InstanceData, model) + sizeof(glm::vec4) * column));
+    }
+    glVertexAttribPointer(Mesh::INSTANCE_PARAMS_LOCATION, 4, GL_FLOAT, GL_FALSE, stride,
+                          (void*)(base + offsetof(InstanceData, params)));
+}
+
+/**
+ * @brief Whether a batch is drawn depth-first and then shaded with GL_EQUAL.
+ */
+bool RenderQueue::usesPrepass(const DrawBatch& batch) const {
+    return depthPrepass && batch.layer == RenderLayer::Opaque && batch.program->depthShader;
+}
+
+/**
+ * @brief Whether a batch is drawn inside a conditional render on its box query.
+ *
+ * Pre-passed batches are left out: their depth is already final, so their
+ * boxes would only test against themselves. A box around the camera loses
+ * the faces clipped by the near plane and could report nothing visible, so
+ * those batches are always drawn.
+ */
+bool RenderQueue::usesConditionalRender(const DrawBatch& batch) const {
+    if (!conditionalCuller || batch.layer == RenderLayer::Overlay || usesPrepass(batch)) return false;
+    const float nearMargin = 0.5f;
+    glm::vec3 low = batch.boundsMin - nearMargin;
+    glm::vec3 high = batch.boundsMax + nearMargin;
+    bool surroundsCamera = cameraPosition.x >= low.x && cameraPosition.x <= high.x &&
+                           cameraPosition.y >= low.y && cameraPosition.y <= high.y &&
+                           cameraPosition.z >= low.z && cameraPosition.z <= high.z;
+    return !surroundsCamera;
+}
+
+/**
+ * @brief Lays down the depth of the pre-pass batches with color writes off.
+ *
+ * The depth program only reads the position, so this pass costs vertex work
+ * and depth bandwidth but no shading.
+ */
+void RenderQueue::executeDepthPrepass(const MeshPool& meshPool, RenderQueueStats& frameStats) {
+    GLStateCache& state = glState();
+    state.colorMask(false);
+    state.setCapability(GL_BLEND, false);
+    state.depthMask(true);
+    state.depthFunc(GL_LESS);
+
+    const Shader* currentShader = nullptr;
+    bool formatSet = false;
+    VertexFormat currentFormat = VertexFormat::Standard;
+
+    for (const DrawBatch& batch : batches) {
+        if (!usesPrepass(batch)) continue;
+
+        if (batch.program->depthShader != currentShader) {
+            batch.program->depthShader->use();
+            currentShader = batch.program->depthShader;
+        }
+
+        VertexFormat format = batch.mesh->geometry.format;
+        if (!formatSet || format != currentFormat) {
+            meshPool.bind(format);
+            currentFormat = format;
+            formatSet = true;
+            frameStats.vertexArrayBinds++;
+        }
+
+        bindInstanceAttributes(batch);
+        batch.mesh->drawInstanced(batch.instanceCount);
+        frameStats.prepassDraws++;
+    }
+
+    state.colorMask(true);
+}
+
+/**
+ * @brief Reads back the overdraw queries issued two frames ago, if they are done.
+ */
+void RenderQueue::collectOverdraw() {
+    unsigned int parity = frameIndex & 1;
+    if (!overdrawPending[parity]) return;
+
+    // Queries finish in order, so the last one issued decides.
+    size_t used = shadingQueriesUsed[parity];
+    GLuint last = used > 0 ? shadingQueries[parity][used - 1] : overdrawPrepass[parity] ? prepassQueries[parity] : 0;
+    GLint available = GL_TRUE;
+    if (last) {
+        glGetQueryObjectiv(last, GL_QUERY_RESULT_AVAILABLE, &available);
+    }
+    if (!available) return;
+
+    OverdrawStats result;
+    result.prepass = overdrawPrepass[parity];
+    GLuint64 samples = 0;
+    if (result.prepass) {
+        glGetQueryObjectui64v(prepassQueries[parity], GL_QUERY_RESULT, &samples);
+        result.depthSamples = samples;
+    }
+    for (size_t i = 0; i < used; i++) {
+        glGetQueryObjectui64v(shadingQueries[parity][i], GL_QUERY_RESULT, &samples);
+        result.shadedSamples += samples;
+    }
+
+    lastOverdraw = result;
+    overdrawPending[parity] = false;
+}
+
+/**
+ * @brief Starts the next shading count query of a frame parity, creating it on first use.
+ */
+void RenderQueue::beginShadingQuery(unsigned int parity) {
+    std::vector<GLuint>& queries = shadingQueries[parity];
+    size_t& used = shadingQueriesUsed[parity];
+    if (used == queries.size()) {
+        GLuint query;
+        glGenQueries(1, &query);
+        queries.push_back(query);
+    }
+    glBeginQuery(GL_SAMPLES_PASSED, queries[used++]);
+}
+
+/**
+ * @brief Sets the blend and depth state of a layer.
+ */
+void RenderQueue::applyLayerState(RenderLayer layer) {
+    GLStateCache& state = glState();
+    switch (layer) {
+        case RenderLayer::Opaque:
+            state.setCapability(GL_BLEND, false);
+            state.depthMask(true);
+            break;
+        case RenderLayer::Transparent:
+            state.setCapability(GL_BLEND, true);
+            state.blendFunc(GL_SRC_ALPHA, GL_ONE);
+            state.depthMask(false);
+            break;
+        case RenderLayer::Overlay:
+            // The overlay is drawn on top of the scene.
+            state.setCapability(GL_BLEND, false);
+            state.depthMask(true);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            break;
+    }
+}
+
+/**
+ * @brief Restores the depth and blend state the rest of the frame (and the GUI) expects.
+ *
+ * Program and texture bindings are left as they are; whoever draws next binds its own.
+ */
+void RenderQueue::restoreDefaultState() {
+    GLStateCache& state = glState();
+    state.depthMask(true);
+    state.depthFunc(GL_LESS);
+    state.setCapability(GL_BLEND, false);
+}
+
+/**
+ * @brief Submits the sorted batches, skipping redundant program, texture and layer changes.
+ * @param meshPool The pool holding every queued mesh's geometry.
+ */
+void RenderQueue::execute(const MeshPool& meshPool) {
+    RenderQueueStats frameStats;
+    frameStats.items = static_cast<unsigned int>(items.size());
+    frameStats.visible = culler.stats().visible;
+    frameStats.culled = culler.stats().culled;
+    frameStats.fogCulled = fogCulledCount;
+    frameStats.bvhCulled = bvhCulledCount;
+    frameStats.occlusionCulled = occlusionCulledCount;
+
+    uploadInstances();
+
+    // Queries of this parity were issued two frames ago and are normally done.
+    if (!prepassQueries[0]) {
+        glGenQueries(2, prepassQueries);
+    }
+    collectOverdraw();
+    unsigned int parity = frameIndex & 1;
+    // Only one occlusion query can be active at a time, so the box queries rule out measuring.
+    bool measure = !overdrawPending[parity] && !conditionalCuller;
+
+    // Every mesh lives in the pool, so one VAO per vertex format serves the whole frame.
+    glBindBuffer(GL_ARRAY_BUFFER, instanceStream.buffer());
+
+    if (depthPrepass) {
+        if (measure) glBeginQuery(GL_SAMPLES_PASSED, prepassQueries[parity]);
+        executeDepthPrepass(meshPool, frameStats);
+        if (measure) glEndQuery(GL_SAMPLES_PASSED);
+    }
+
+    bool formatSet = false;
+    VertexFormat currentFormat = VertexFormat::Standard;
+
+    const RenderProgram* currentProgram = nullptr;
+    const Material* currentMaterial = nullptr;
+    bool layerSet = false;
+    RenderLayer currentLayer = RenderLayer::Opaque;
+    bool currentEqual = false;
+    bool shadingQueryActive = false;
+    if (measure) {
+        shadingQueriesUsed[parity] = 0;
+    }
+
+    for (const DrawBatch& batch : batches) {
+        bool layerChanged = !layerSet || batch.layer != currentLayer;
+        if (layerChanged) {
+            applyLayerState(batch.layer);
+            currentLayer = batch.layer;
+            layerSet = true;
+            frameStats.layerChanges++;
+        }
+
+        // Pre-passed pixels already hold their final depth; only the exact match gets shaded.
+        bool equal = usesPrepass(batch);
+        if (layerChanged || equal != currentEqual) {
+            glState().depthFunc(equal ? GL_EQUAL : GL_LESS);
+            if (batch.layer == RenderLayer::Opaque) {
+                glState().depthMask(!equal);
+            }
+            currentEqual = equal;
+        }
+
+        // The box is tested against the depth drawn so far; it binds its own program and vertex array.
+        bool conditional = usesConditionalRender(batch);
+        GLuint query = 0;
+        if (conditional) {
+            query = conditionalCuller->queryBox(batch.boundsMin, batch.boundsMax, batch.layer == RenderLayer::Opaque);
+            currentProgram = nullptr;
+            formatSet = false;
+        }
+
+        bool programChanged = batch.program != currentProgram;
+        if (programChanged) {
+            batch.program->shader->use();
+            currentProgram = batch.program;
+            frameStats.programBinds++;
+        }
+
+        // Every program samples the same fixed units and reads the same block
+        // binding, so a material stays bound across program changes.
+        const Material* material = batch.mesh->material;
+        if (material && material != currentMaterial) {
+            material->bind();
+            currentMaterial = material;
+            frameStats.textureBinds++;
+        }
+
+        VertexFormat format = batch.mesh->geometry.format;
+        if (!formatSet || format != currentFormat) {
+            meshPool.bind(format);
+            currentFormat = format;
+            formatSet = true;
+            frameStats.vertexArrayBinds++;
+        }
+
+        // The shading count covers the same batches as the pre-pass count, or
+        // the whole opaque layer without a pre-pass.
+        bool measured = measure && batch.layer == RenderLayer::Opaque && (!depthPrepass || equal);
+        if (measured != shadingQueryActive) {
+            if (measured) {
+                beginShadingQuery(parity);
+            } else {
+                glEndQuery(GL_SAMPLES_PASSED);
+            }
+            shadingQueryActive = measured;
+        }
+
+        bindInstanceAttributes(batch);
+        if (conditional) {
+            // No wait: if the query is not back yet the batch is simply drawn.
+            glBeginConditionalRender(query, GL_QUERY_NO_WAIT);
+            batch.mesh->drawInstanced(batch.instanceCount);
+            glEndConditionalRender();
+            frameStats.conditionalDraws++;
+        } else {
+            batch.mesh->drawInstanced(batch.instanceCount);
+        }
+        frameStats.draws++;
+    }
+
+    if (shadingQueryActive) {
+        glEndQuery(GL_SAMPLES_PASSED);
+    }
+    if (measure) {
+        overdrawPending[parity] = true;
+        overdrawPrepass[parity] = depthPrepass;
+    }
+    frameIndex++;
+
+    glState().bindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    instanceStream.end();
+    restoreDefaultState();
+    lastStats = frameStats;
+}
@@ -2,46 +2,96 @@
 #include <GLFW/glfw3.h>
 #include "renderer.h"
 #include "config.h"
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <cmath>
 #include <glm/gtc/matrix_transform.hpp>
 
-Renderer::Renderer(GameState* state) 
+Renderer::Renderer(GameState* state, TextureLoader* loader) 
     : gameState(state), 
-      levelShader(nullptr), 
-      swordShader(nullptr),
-      bonfireShader(nullptr),
+      textureLoader(loader), 
+      levelShaders(nullptr), 
+      swordShaders(nullptr),
+      bonfireShaders(nullptr),
+      lightBeamShaders(nullptr),
+      gbufferShaders(nullptr),
+      depthShader(nullptr),
       level(nullptr), 
       bonfire(nullptr),
       bonfireSword(nullptr),
       brokenSword(nullptr),
       sword(nullptr),
-      lightBeam(nullptr) 
+      lightBeam(nullptr),
+      frameConstants{},
+      uniformOffsetAlignment(256),
+      deferredRenderer(nullptr),
+      occlusionCuller(nullptr),
+      indirectScene(nullptr),
+      sceneTimeQueries{ 0, 0 },
+      frameIndex(0),
+      sceneGpuMilliseconds(0.0f)
 {
 }
 
 Renderer::~Renderer() {
-    delete levelShader;
-    delete swordShader;
-    delete bonfireShader;
+    delete levelShaders;
+    delete swordShaders;
+    delete bonfireShaders;
+    delete lightBeamShaders;
+    delete gbufferShaders;
+    delete depthShader;
+    delete deferredRenderer;
+    delete occlusionCuller;
+    delete indirectScene;
     delete level;
     delete bonfireSword;
     delete bonfire;
     delete brokenSword;
     delete sword;
     delete lightBeam;
+    if (sceneTimeQueries[0]) {
+        glDeleteQueries(2, sceneTimeQueries);
+    }
 }
 
 /**
- * @brief Initializes all shader programs used for rendering.
+ * @brief Starts building all shader programs used for rendering.
+ *
+ * Every program comes in variants with and without its optional features; see
+ * shaderVariants.h. The programs are only submitted here; each one is
+ * finalized when it is first needed, so the driver can build them in parallel
+ * with each other and with model loading.
  * @return True if shaders were created successfully, false otherwise.
  */
 bool Renderer::initializeShaders() {
     try {
-        levelShader = new Shader("shaders/level/levelVs.glsl", "shaders/level/levelFs.glsl");
-        swordShader = new Shader("shaders/sword/swordVs.glsl", "shaders/sword/swordFs.glsl");
-        bonfireShader = new Shader("shaders/bonfire/bonfireVs.glsl", "shaders/bonfire/bonfireFs.glsl");
+        // Variants get consecutive sort ids, so draws of one set stay together in the queue.
+        levelShaders = new ShaderVariantSet("shaders/level/levelVs.glsl", "shaders/level/levelFs.glsl",
+                                            SHADER_FEATURE_QUANTIZE,
+                                            SHADER_FEATURE_POINT_LIGHTS | SHADER_FEATURE_FOG, 0);
+        bonfireShaders = new ShaderVariantSet("shaders/bonfire/bonfireVs.glsl", "shaders/bonfire/bonfireFs.glsl",
+                                              SHADER_FEATURE_QUANTIZE | SHADER_FEATURE_EMISSIVE,
+                                              SHADER_FEATURE_FOG, levelShaders->nextSortId());
+        swordShaders = new ShaderVariantSet("shaders/sword/swordVs.glsl", "shaders/sword/swordFs.glsl",
+                                            SHADER_FEATURE_QUANTIZE,
+                                            SHADER_FEATURE_POINT_LIGHTS, bonfireShaders->nextSortId());
+        lightBeamShaders = new ShaderVariantSet("shaders/lightBeam/lightBeamVs.glsl", "shaders/lightBeam/lightBeamFs.glsl",
+                                                SHADER_FEATURE_QUANTIZE, 0, swordShaders->nextSortId());
+        // The deferred path's geometry pass; lighting, quantization and fog happen later.
+        gbufferShaders = new ShaderVariantSet("shaders/level/levelVs.glsl", "shaders/deferred/gbufferFs.glsl",
+                                              0, 0, lightBeamShaders->nextSortId());
+
+        // Only the level takes part in the depth pre-pass: its fragment shader
+        // is the expensive one, and its vertex stage matches depthVs exactly.
+        depthShader = new Shader("shaders/depth/depthVs.glsl", "shaders/depth/depthFs.glsl",
+                                 shaderVariantHeader(0));
+        levelShaders->setDepthShader(depthShader);
+
+        // The per-frame constants of every program are bound as a range of a stream buffer.
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformOffsetAlignment);
+
+        glGenQueries(2, sceneTimeQueries);
         return true;
     } catch (const std::exception& e) {
         std::cerr << "Failed to initialize shaders: " << e.what() << std::endl;
@@ -55,12 +105,53 @@ bool Renderer::initializeShaders() {
  */
 bool Renderer::loadModels() {
     try {
-        level = new Model("models/level/level.obj");
-        sword = new Model("models/sword/sword.obj");
-        bonfireSword = new Model("models/bonfireSword/bonfire.obj");
-        bonfire = new Model("models/bonfire/bonfire.obj");
-        brokenSword = new Model("models/brokenSword/broken_sword.obj");
-        lightBeam = new Model("models/lightBeam/lightBeam.obj");
+        // Variants share their vertex stage, so the full variant's attributes cover all of them.
+        // The declared inputs are known from the source; asking the linker would
+        // wait for the builds the imports below are meant to overlap with.
+        uint32_t levelAttributes = levelShaders->full().shader->declaredAttributeMask();
+        uint32_t swordAttributes = swordShaders->full().shader->declaredAttributeMask();
+        uint32_t bonfireAttributes = bonfireShaders->full().shader->declaredAttributeMask();
+        uint32_t lightBeamAttributes = lightBeamShaders->full().shader->declaredAttributeMask();
+
+        // The level and the bonfire never move: their transforms are baked in
+        // and their meshes merged per material. The level also keeps a
+        // triangle BVH for culling and spatial queries.
+        glm::mat4 levelModel = levelTransform();
+        glm::mat4 bonfireModel = bonfireTransform();
+        level = new Model("models/level/level.obj", meshPool, *textureLoader, materials, levelAttributes,
+                          false, { .buildBvh = true, .staticTransform = &levelModel });
+        sword = new Model("models/sword/sword.obj", meshPool, *textureLoader, materials, swordAttributes);
+        bonfireSword = new Model("models/bonfireSword/bonfire.obj", meshPool, *textureLoader, materials,
+                                 bonfireAttributes, false, { .staticTransform = &bonfireModel });
+        bonfire = new Model("models/bonfire/bonfire.obj", meshPool, *textureLoader, materials,
+                            bonfireAttributes, false, { .staticTransform = &bonfireModel });
+        brokenSword = new Model("models/brokenSword/broken_sword.obj", meshPool, *textureLoader, materials,
+                                swordAttributes);
+        lightBeam = new Model("models/lightBeam/lightBeam.obj", meshPool, *textureLoader, materials,
+                              lightBeamAttributes);
+
+        // The exporter writes its default shininess and no emissive strength;
+        // the PS1 look is tuned in the config.
+        level->overrideMaterialParams(MATERIAL_SHININESS, MATERIAL_ALPHA, 0.0f);
+        sword->overrideMaterialParams(MATERIAL_SHININESS, 1.0f, 0.0f);
+        brokenSword->overrideMaterialParams(MATERIAL_SHININESS, 1.0f, 0.0f);
+        bonfire->overrideMaterialParams(TORCH_SHININESS, 1.0f, TORCH_EMISSIVE_STRENGTH);
+        bonfireSword->overrideMaterialParams(TORCH_SHININESS, 1.0f, TORCH_EMISSIVE_STRENGTH);
+
+        // Programs whose builds are done get their uniforms now; the rest are
+        // configured in later frames, and draws use a finished variant meanwhile.
+        configurePrograms();
+
+        // Its programs are set up on creation, so it also waits for the imports.
+        deferredRenderer = new DeferredRenderer(PS1_INTERNAL_WIDTH, PS1_INTERNAL_HEIGHT);
+        occlusionCuller = new OcclusionCuller(OCCLUSION_HIZ_WIDTH, OCCLUSION_HIZ_HEIGHT);
+        // The level's walls are the occluders; they only need their depth.
+        occluderProgram.shader = depthShader;
+
+        if (IndirectScene::supported()) {
+            indirectScene = new IndirectScene();
+            indirectScene->add(*level, glm::mat4(1.0f));
+        }
         return true;
     } catch (const std::exception& e) {
         std::cerr << "Failed to load models: " << e.what() << std::endl;
@@ -68,127 +159,312 @@ bool Renderer::loadModels() {
     }
 }
 
-void Renderer::setupLighting(Shader& shader, float time) {
-    shader.use();
+/**
+ * @brief Attaches the frame constants and material blocks, points the light
+ * cluster and material samplers at their units and sets the uniforms that never change.
+ *
+ * Uniform values are program state, so fill-light parameters only need to be
+ * uploaded once instead of before every draw; material parameters come from
+ * the bound range of the material buffer. Each variant set applies this as its
+ * programs finish building, so nothing here waits for the driver.
+ */
+void Renderer::configurePrograms() {
+    auto sceneProgram = [](const Shader& shader) {
+        shader.bindUniformBlock("FrameConstants", FRAME_CONSTANTS_BINDING);
+        shader.bindUniformBlock("MaterialParams", MATERIAL_PARAMS_BINDING);
+        shader.use();
+        shader.setInt("diffuseMap", MATERIAL_TEXTURE_UNIT_BASE + MATERIAL_TEXTURE_DIFFUSE);
+        shader.setInt("lightClusters", LIGHT_CLUSTER_TEXTURE_UNIT);
+        shader.setInt("lightIndices", LIGHT_INDEX_TEXTURE_UNIT);
+        shader.setInt("lightData", LIGHT_DATA_TEXTURE_UNIT);
+    };
+    for (ShaderVariantSet* variants : { levelShaders, swordShaders, gbufferShaders }) {
+        variants->setConfigure(sceneProgram);
+    }
+    bonfireShaders->setConfigure([sceneProgram](const Shader& shader) {
+        sceneProgram(shader);
+        shader.setVec3("torchLight.direction", DIR_LIGHT_DIRECTION);
+        shader.setVec3("torchLight.ambient", TORCH_DIR_AMBIENT);
+        shader.setVec3("torchLight.diffuse", TORCH_DIR_DIFFUSE);
+        shader.setVec3("torchLight.specular", DIR_LIGHT_SPECULAR);
+    });
+    lightBeamShaders->setConfigure([sceneProgram](const Shader& shader) {
+        sceneProgram(shader);
+        shader.setVec3("beamLight.direction", BEAM_LIGHT_DIRECTION);
+        shader.setVec3("beamLight.ambient", BEAM_LIGHT_COLOR);
+        shader.setVec3("beamLight.diffuse", BEAM_LIGHT_COLOR);
+        shader.setVec3("beamLight.specular", glm::vec3(0.0f));
+    });
+    depthShader->bindUniformBlock("FrameConstants", FRAME_CONSTANTS_BINDING);
 
-    shader.setVec3("viewPos", gameState->camera.Position);
+    configureReadyPrograms();
+    glState().useProgram(0);
+}
 
-    shader.setVec3("dirLight.direction", DIR_LIGHT_DIRECTION);
-    shader.setVec3("dirLight.ambient", DIR_LIGHT_AMBIENT);
-    shader.setVec3("dirLight.diffuse", DIR_LIGHT_DIFFUSE);
-    shader.setVec3("dirLight.specular", DIR_LIGHT_SPECULAR);
+/**
+ * @brief Configures the scene programs whose builds finished since the last call.
+ */
+void Renderer::configureReadyPrograms() {
+    for (ShaderVariantSet* variants : { levelShaders, swordShaders, bonfireShaders, lightBeamShaders, gbufferShaders }) {
+        variants->configureReady();
+    }
+}
 
+/**
+ * @brief Collects this frame's point lights: the config torches with any color, then the dynamic ones.
+ * @param time The current time in seconds, used for the bonfire flicker.
+ */
+void Renderer::updateLights(float time) {
+    pointLights.clear();
     for (int i = 0; i < NUM_POINT_LIGHTS; i++) {
-        std::string number = std::to_string(i);
-        shader.setVec3("pointLights[" + number + "].position", POINT_LIGHT_POSITIONS[i]);
-        
+        ScenePointLight light;
+        light.position = POINT_LIGHT_POSITIONS[i];
+        light.constant = LIGHT_CONSTANT;
+
         if (i == BONFIRE_LIGHT_INDEX) {
             float flicker = FLICKER_BASE + FLICKER_AMPLITUDE * sin(time * FLICKER_FREQ1 + i * FLICKER_PHASE1) * sin(time * FLICKER_FREQ2 + i * FLICKER_PHASE2);
-            
-            shader.setVec3("pointLights[" + number + "].ambient", BONFIRE_AMBIENT_BASE * flicker);
-            shader.setVec3("pointLights[" + number + "].diffuse", BONFIRE_DIFFUSE_BASE * flicker);
-            shader.setVec3("pointLights[" + number + "].specular", BONFIRE_SPECULAR);
-            
-            shader.setFloat("pointLights[" + number + "].constant", LIGHT_CONSTANT);
-            shader.setFloat("pointLights[" + number + "].linear", BONFIRE_LINEAR);
-            shader.setFloat("pointLights[" + number + "].quadratic", BONFIRE_QUADRATIC);
+
+            light.ambient = BONFIRE_AMBIENT_BASE * flicker;
+            light.diffuse = BONFIRE_DIFFUSE_BASE * flicker;
+            light.specular = BONFIRE_SPECULAR;
+            light.linear = BONFIRE_LINEAR;
+            light.quadratic = BONFIRE_QUADRATIC;
         } else {
-            shader.setVec3("pointLights[" + number + "].ambient", REGULAR_LIGHT_COLOR);
-            shader.setVec3("pointLights[" + number + "].diffuse", REGULAR_LIGHT_COLOR);
-            shader.setVec3("pointLights[" + number + "].specular", REGULAR_LIGHT_COLOR);
-            
-            shader.setFloat("pointLights[" + number + "].constant", LIGHT_CONSTANT);
-            shader.setFloat("pointLights[" + number + "].linear", REGULAR_LINEAR);
-            shader.setFloat("pointLights[" + number + "].quadratic", REGULAR_QUADRATIC);
+            light.ambient = REGULAR_LIGHT_COLOR;
+            light.diffuse = REGULAR_LIGHT_COLOR;
+            light.specular = REGULAR_LIGHT_COLOR;
+            light.linear = REGULAR_LINEAR;
+            light.quadratic = REGULAR_QUADRATIC;
+        }
+
+        // A black light adds nothing, so it never reaches the clusters.
+        if (light.hasColor()) {
+            pointLights.push_back(light);
+        }
+    }
+    for (const ScenePointLight& light : dynamicLights) {
+        if (light.hasColor()) {
+            pointLights.push_back(light);
         }
     }
 
-    shader.setFloat("material.shininess", MATERIAL_SHININESS);
-    shader.setFloat("material.alpha", MATERIAL_ALPHA);
+    // Lights whose reach stays within rooms the portals do not reach stay out
+    // of the clusters; one spilling through a doorway into a seen room is kept.
+    if (hasLevelSectors()) {
+        pointLights.erase(std::remove_if(pointLights.begin(), pointLights.end(),
+                                         [this](const ScenePointLight& light) {
+                                             return !isReachable(light.position, pointLightRange(light));
+                                         }),
+                          pointLights.end());
+    }
+}
 
-    shader.setFloat("fogNear", FOG_NEAR);
-    shader.setFloat("fogFar", FOG_FAR);
-    shader.setVec3("fogColor", FOG_COLOR);
+/**
+ * @brief Walks the level's portals from the camera's room and culls each visible
+ * room's meshes against the frustum narrowed through the portals it is seen by.
+ * @param viewProjection The camera's projection times view matrix.
+ */
+void Renderer::updateSectors(const glm::mat4& viewProjection) {
+    if (!hasLevelSectors()) return;
+
+    // Within this distance (world units) of a portal the camera is stepping through it.
+    const float doorwayMargin = 0.25f;
+
+    // The level is baked into world space, so its rooms need no model matrix.
+    const SectorGraph& graph = level->sectors;
+    graph.traverse(viewProjection, gameState->camera.Position, doorwayMargin, sectorVisibility);
+
+    // Untagged meshes keep their 1 and are left to the other culling stages.
+    sectorMeshVisibility.assign(level->meshes.size(), 1);
+    for (size_t s = 0; s < graph.sectors().size(); s++) {
+        const Sector& sector = graph.sectors()[s];
+        if (!sectorVisibility.sectors[s]) {
+            for (uint32_t mesh : sector.meshes) {
+                sectorMeshVisibility[mesh] = 0;
+            }
+            continue;
+        }
+
+        sectorCuller.begin(SectorGraph::narrowToRect(viewProjection, sectorVisibility.rects[s]));
+        for (uint32_t mesh : sector.meshes) {
+            const Mesh& bounds = level->meshes[mesh];
+            sectorCuller.add(bounds.boundsCenter(), (bounds.boundsMax - bounds.boundsMin) * 0.5f, bounds.boundsRadius);
+        }
+        sectorCuller.cull();
+        for (size_t i = 0; i < sector.meshes.size(); i++) {
+            sectorMeshVisibility[sector.meshes[i]] = sectorCuller.visible(static_cast<uint32_t>(i)) ? 1 : 0;
+        }
+    }
 }
 
-void Renderer::setupTorchLighting(Shader& shader, float time) {
-    shader.use();
-    
-    shader.setVec3("viewPos", gameState->camera.Position);
-    
-    shader.setVec3("dirLight.direction", DIR_LIGHT_DIRECTION);
-    shader.setVec3("dirLight.ambient", TORCH_DIR_AMBIENT);
-    shader.setVec3("dirLight.diffuse", TORCH_DIR_DIFFUSE);
-    shader.setVec3("dirLight.specular", DIR_LIGHT_SPECULAR);
-    
-    shader.setFloat("material.shininess", TORCH_SHININESS);
-    shader.setFloat("material.emissiveStrength", TORCH_EMISSIVE_STRENGTH);
-    shader.setFloat("time", time);
-    
-    // Atmospheric fog settings
-    shader.setFloat("fogNear", 4.0f);
-    shader.setFloat("fogFar", 7.0f);
-    shader.setVec3("fogColor", 0.02f, 0.02f, 0.04f);
+/**
+ * @brief Whether a world position lies in a room seen this frame; positions outside every room count as seen.
+ */
+bool Renderer::isReachable(const glm::vec3& position) const {
+    if (!hasLevelSectors() || sectorVisibility.sectors.empty()) return true;
+    int sector = level->sectors.findSector(position);
+    return sector < 0 || sectorVisibility.sectors[sector];
 }
 
 /**
- * @brief Renders the main level geometry.
+ * @brief Whether a sphere touches a room seen this frame; spheres centered
+ * outside every room, and unbounded ones, count as seen.
  */
-void Renderer::renderLevel() {
-    if (!levelShader || !level) return;
-    
-    setupLighting(*levelShader, static_cast<float>(glfwGetTime()));
+bool Renderer::isReachable(const glm::vec3& center, float radius) const {
+    if (!hasLevelSectors() || sectorVisibility.sectors.empty()) return true;
+    if (level->sectors.findSector(center) < 0 || !std::isfinite(radius)) return true;
+
+    const std::vector<Sector>& rooms = level->sectors.sectors();
+    for (size_t i = 0; i < rooms.size(); i++) {
+        if (!sectorVisibility.sectors[i]) continue;
+        glm::vec3 offset = glm::clamp(center, rooms[i].boundsMin, rooms[i].boundsMax) - center;
+        if (glm::dot(offset, offset) <= radius * radius) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Whether the player fits at a world position: inside one of the
+ * level's rooms and at least PLAYER_RADIUS away from every wall.
+ *
+ * The room boxes only bound the rooms roughly; testing the walls themselves
+ * through the BVH keeps the camera out of them and also bounds rooms that are
+ * not boxes.
+ */
+bool Renderer::isWalkable(const glm::vec3& position) const {
+    if (!hasLevelSectors()) return true;
+    if (level->sectors.findSector(position) < 0) return false;
+
+    std::vector<uint32_t> touching;
+    if (!level->bvh.overlapSphere(position, PLAYER_RADIUS, touching)) return true;
+    const std::vector<BVHTriangle>& triangles = level->bvh.triangles();
+    for (uint32_t index : touching) {
+        const BVHTriangle& triangle = triangles[index];
+        glm::vec3 normal = glm::cross(triangle.v1 - triangle.v0, triangle.v2 - triangle.v0);
+        float length = glm::length(normal);
+        if (length > 0.0f && std::abs(normal.y) < WALL_MAX_NORMAL_Y * length) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Fills the frame constants from the game state and uploads them once for all programs.
+ * @param time The current time in seconds.
+ */
+void Renderer::updateFrameConstants(float time) {
+    FrameConstants& fc = frameConstants;
+
+    fc.view = gameState->camera.GetViewMatrix();
+    fc.projection = gameState->projection;
+    fc.viewPos = gameState->camera.Position;
+    fc.time = time;
 
+    fc.dirLight.direction = DIR_LIGHT_DIRECTION;
+    fc.dirLight.ambient = DIR_LIGHT_AMBIENT;
+    fc.dirLight.diffuse = DIR_LIGHT_DIFFUSE;
+    fc.dirLight.specular = DIR_LIGHT_SPECULAR;
+
+    fc.fogColor = FOG_COLOR;
+    fc.fogNear = FOG_NEAR;
+    fc.fogFar = FOG_FAR;
+    fc.clusterParams = lightClusters.shaderParams();
+
+    frameConstantsStream.begin(sizeof(FrameConstants));
+    GLintptr offset = frameConstantsStream.write(&fc, sizeof(FrameConstants),
+                                                 static_cast<size_t>(std::max(uniformOffsetAlignment, 1)));
+    if (offset >= 0) {
+        glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_CONSTANTS_BINDING, frameConstantsStream.buffer(), offset,
+                          sizeof(FrameConstants));
+    }
+}
+
+/**
+ * @brief Whether this frame takes the deferred path; falls back to forward if its targets are unusable.
+ */
+bool Renderer::useDeferred() const {
+    return gameState->renderPath == RenderPath::Deferred && deferredRenderer && deferredRenderer->isComplete();
+}
+
+/**
+ * @brief Placement of the level in the world, baked into its vertices at load.
+ */
+glm::mat4 Renderer::levelTransform() {
     glm::mat4 model = glm::mat4(1.0f);
     model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
     model = glm::scale(model, glm::vec3(3.0f, 3.0f, 3.0f));
-    
-    glm::mat4 view = gameState->camera.GetViewMatrix();
-    
-    levelShader->setMat4("model", model);
-    levelShader->setMat4("view", view);
-    levelShader->setMat4("projection", gameState->projection);
+    return model;
+}
 
-    level->Draw(*levelShader);
+/**
+ * @brief Placement of the bonfire (both states) in the world, baked into its vertices at load.
+ */
+glm::mat4 Renderer::bonfireTransform() {
+    glm::mat4 model = glm::mat4(1.0f);
+    model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
+    return model;
 }
 
 /**
- * @brief Renders the bonfire, switching between the sword and lit states.
- * @param flag True if the bonfire is lit (player has the sword), false otherwise.
+ * @brief Whether this frame culls and draws the level on the GPU; needs a GL 4.3 context.
  */
-void Renderer::renderBonfire(bool flag) {
-    if (!bonfireShader || !bonfire || !bonfireSword) return;
+bool Renderer::useGpuDriven() const {
+    return gameState->gpuDriven && indirectScene && !indirectScene->empty();
+}
 
-    setupTorchLighting(*bonfireShader, static_cast<float>(glfwGetTime()));
+/**
+ * @brief Queues the main level geometry, into the G-buffer pass on the deferred path.
+ */
+void Renderer::submitLevel() {
+    if (!levelShaders || !gbufferShaders || !level) return;
 
+    // Baked into world space at load, one mesh per material and room.
     glm::mat4 model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
-    
-    glm::mat4 view = gameState->camera.GetViewMatrix();
 
-    bonfireShader->setMat4("model", model);
-    bonfireShader->setMat4("view", view);
-    bonfireShader->setMat4("projection", gameState->projection);
+    // Meshes whose triangles all miss the frustum are dropped before the
+    // per-mesh box test, which only sees their (often view-spanning) bounds.
+    const std::vector<uint8_t>* visible = nullptr;
+    if (!level->bvh.empty()) {
+        level->bvh.queryFrustum(gameState->projection * gameState->camera.GetViewMatrix() * model, levelVisibility);
+        visible = &levelVisibility;
+    }
+    // Rooms the portals do not reach, or only reach outside a mesh's bounds, drop out too.
+    if (hasLevelSectors()) {
+        if (visible) {
+            for (size_t i = 0; i < levelVisibility.size() && i < sectorMeshVisibility.size(); i++) {
+                levelVisibility[i] &= sectorMeshVisibility[i];
+            }
+        } else {
+            visible = &sectorMeshVisibility;
+        }
+    }
 
-    // Render the unlit bonfire (with sword) or the lit bonfire.
-    if (!flag){
-        bonfireSword->Draw(*bonfireShader);
+    if (useDeferred()) {
+        geometryQueue.submit(*level, *gbufferShaders, variantContext, model, RenderLayer::Opaque, 1.0f, visible);
     } else {
-        bonfire->Draw(*bonfireShader);
+        renderQueue.submit(*level, *levelShaders, variantContext, model, RenderLayer::Opaque, 1.0f, visible);
     }
 }
 
 /**
- * @brief Renders the player's first-person sword model.
+ * @brief Queues the bonfire, switching between the sword and lit states.
+ * @param flag True if the bonfire is lit (player has the sword), false otherwise.
+ */
+void Renderer::submitBonfire(bool flag) {
+    if (!bonfireShaders || !bonfire || !bonfireSword) return;
+
+    if (!isReachable(glm::vec3(bonfireTransform()[3]))) return;
+
+    // Render the unlit bonfire (with sword) or the lit bonfire; both are baked into world space.
+    const Model& bonfireModel = flag ? *bonfire : *bonfireSword;
+    renderQueue.submit(bonfireModel, *bonfireShaders, variantContext, glm::mat4(1.0f), RenderLayer::Opaque);
+}
+
+/**
+ * @brief Queues the player's first-person sword model on the overlay layer.
  * @param type A string indicating which sword model to render (e.g., "broken").
  */
-void Renderer::renderSword(std::string type) {
-    if (!swordShader || !sword || !brokenSword) return;
-    
-    setupLighting(*swordShader, static_cast<float>(glfwGetTime()));
-    
-    // Clear the depth buffer to ensure the sword renders on top of the scene.
-    glClear(GL_DEPTH_BUFFER_BIT);
+void Renderer::submitSword(const std::string& type) {
+    if (!swordShaders || !sword || !brokenSword) return;
 
     glm::mat4 swordModel = glm::mat4(1.0f);
     
@@ -216,117 +492,207 @@ void Renderer::renderSword(std::string type) {
     swordModel = glm::rotate(swordModel, glm::radians(25.0f), glm::vec3(0.0f, 1.0f, 0.0f));
     swordModel = glm::rotate(swordModel, glm::radians(10.0f), glm::vec3(0.0f, 0.0f, 1.0f));
     
-    glm::mat4 view = gameState->camera.GetViewMatrix();
-    
-    swordShader->setMat4("model", swordModel);
-    swordShader->setMat4("view", view);
-    swordShader->setMat4("projection", gameState->projection);
-    
     if (type == "broken"){
-        brokenSword->Draw(*swordShader);
+        renderQueue.submit(*brokenSword, *swordShaders, variantContext, swordModel, RenderLayer::Overlay);
     } else {
         // Currently, only the broken sword is rendered.
-        // sword->Draw(*swordShader);
+        // renderQueue.submit(*sword, *swordShaders, variantContext, swordModel, RenderLayer::Overlay);
     }
 }
 
 /**
- * @brief Renders the atmospheric light beam from the ceiling using volumetric layers.
+ * @brief Queues the atmospheric light beam from the ceiling as layered, additively blended cones.
+ *
+ * The layers share one mesh, so the queue draws them as a single instanced call
+ * with the per-layer alpha in the instance data.
  */
-void Renderer::renderLightBeam() {
-    if (!levelShader || !lightBeam) return;
-    
-    // Configure alpha blending for light beam transparency
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-    glDepthMask(GL_FALSE);
-    
-    // Configure bright self-illuminated lighting for the light beam
-    levelShader->use();
-    levelShader->setVec3("viewPos", gameState->camera.Position);
-    
-    levelShader->setVec3("dirLight.direction", 0.0f, -1.0f, 0.0f);
-    levelShader->setVec3("dirLight.ambient", 2.5f, 2.5f, 2.0f);
-    levelShader->setVec3("dirLight.diffuse", 2.5f, 2.5f, 2.0f);
-    levelShader->setVec3("dirLight.specular", 0.0f, 0.0f, 0.0f);
-    
-    // Disable all point lights for the light beam
-    for (int i = 0; i < NUM_POINT_LIGHTS; i++) {
-        std::string number = std::to_string(i);
-        levelShader->setVec3("pointLights[" + number + "].diffuse", 0.0f, 0.0f, 0.0f);
-        levelShader->setVec3("pointLights[" + number + "].ambient", 0.0f, 0.0f, 0.0f);
-        levelShader->setVec3("pointLights[" + number + "].specular", 0.0f, 0.0f, 0.0f);
-    }
-    
-    levelShader->setFloat("material.shininess", 1.0f);
-    
-    // Disable fog for the light beam
-    levelShader->setFloat("fogNear", 999.0f);
-    levelShader->setFloat("fogFar", 1000.0f);
-
-    glm::mat4 view = gameState->camera.GetViewMatrix();
-    levelShader->setMat4("view", view);
-    levelShader->setMat4("projection", gameState->projection);
+void Renderer::submitLightBeam() {
+    if (!lightBeamShaders || !lightBeam) return;
 
     // Render volumetric light beam using multiple layered cones
     const glm::vec3 beamPosition(0.0f, 2.5f, 0.0f);
     const glm::vec3 beamScale(1.0f, 2.5f, 1.0f);
-    
-    // Layer 1: Outer cone
-    levelShader->setFloat("material.alpha", 0.15f);
-    glm::mat4 model1 = glm::mat4(1.0f);
-    model1 = glm::translate(model1, beamPosition);
-    model1 = glm::scale(model1, beamScale * glm::vec3(1.4f, 1.0f, 1.4f));
-    levelShader->setMat4("model", model1);
-    lightBeam->Draw(*levelShader);
-    
-    // Layer 2: Middle-outer cone
-    levelShader->setFloat("material.alpha", 0.25f);
-    glm::mat4 model2 = glm::mat4(1.0f);
-    model2 = glm::translate(model2, beamPosition);
-    model2 = glm::scale(model2, beamScale * glm::vec3(1.1f, 1.0f, 1.1f));
-    levelShader->setMat4("model", model2);
-    lightBeam->Draw(*levelShader);
-    
-    // Layer 3: Middle-inner cone
-    levelShader->setFloat("material.alpha", 0.35f);
-    glm::mat4 model3 = glm::mat4(1.0f);
-    model3 = glm::translate(model3, beamPosition);
-    model3 = glm::scale(model3, beamScale * glm::vec3(0.8f, 1.0f, 0.8f));
-    levelShader->setMat4("model", model3);
-    lightBeam->Draw(*levelShader);
-    
-    // Layer 4: Inner core
-    levelShader->setFloat("material.alpha", 0.5f);
-    glm::mat4 model4 = glm::mat4(1.0f);
-    model4 = glm::translate(model4, beamPosition);
-    model4 = glm::scale(model4, beamScale * glm::vec3(0.5f, 1.0f, 0.5f));
-    levelShader->setMat4("model", model4);
-    lightBeam->Draw(*levelShader);
-    
-    // Restore normal rendering state
-    glDepthMask(GL_TRUE);
-    glDisable(GL_BLEND);
+    if (!isReachable(beamPosition)) return;
+
+    struct BeamLayer { float widthScale; float alpha; };
+    const BeamLayer layers[] = {
+        { 1.4f, 0.15f }, // Outer cone
+        { 1.1f, 0.25f }, // Middle-outer cone
+        { 0.8f, 0.35f }, // Middle-inner cone
+        { 0.5f, 0.5f  }  // Inner core
+    };
+
+    for (const BeamLayer& layer : layers) {
+        glm::mat4 model = glm::mat4(1.0f);
+        model = glm::translate(model, beamPosition);
+        model = glm::scale(model, beamScale * glm::vec3(layer.widthScale, 1.0f, layer.widthScale));
+        renderQueue.submit(*lightBeam, *lightBeamShaders, variantContext, model, RenderLayer::Transparent, layer.alpha);
+    }
+}
+
+/**
+ * @brief Draws the level depth-only into the occluder target and tests this frame's
+ * candidates from both scene queues against its pyramid.
+ *
+ * The verdicts come back a few frames later, so a mesh that steps out from
+ * behind a wall can show up that many frames late; the coarse occluder target
+ * keeps that to meshes that were hidden by a wide margin.
+ * @param viewProjection The camera's projection times view matrix.
+ * @param farPlane The far plane distance, for the occluder queue's depth keys.
+ * @param viewport The window viewport to restore afterwards.
+ */
+void Renderer::renderOccluders(const glm::mat4& viewProjection, float farPlane, const GLint viewport[4]) {
+    if (!level) return;
+
+    occlusionCandidates.clear();
+    if (useDeferred()) {
+        const std::vector<OcclusionCandidate>& geometry = geometryQueue.occlusionCandidates();
+        occlusionCandidates.insert(occlusionCandidates.end(), geometry.begin(), geometry.end());
+    }
+    const std::vector<OcclusionCandidate>& forward = renderQueue.occlusionCandidates();
+    occlusionCandidates.insert(occlusionCandidates.end(), forward.begin(), forward.end());
+
+    occluderQueue.begin(gameState->camera.Position, farPlane, viewProjection);
+    occluderQueue.submit(*level, occluderProgram, glm::mat4(1.0f), RenderLayer::Opaque);
+    occluderQueue.sort();
+    occlusionCuller->beginOccluders();
+    occluderQueue.execute(meshPool);
+    occlusionCuller->testCandidates(occlusionCandidates, viewport);
 }
 
 /**
  * @brief The main render loop function, called once per frame.
+ *
+ * On the deferred path the level is drawn into the G-buffer at the PS1
+ * internal resolution and lit there; the resolve fills the window's color and
+ * depth, and the forward queue then draws the remaining objects on top.
  */
 void Renderer::render() {
-    // Clear the screen with a dark blue color to match the PS1 aesthetic.
-    glClearColor(0.05f, 0.05f, 0.15f, 1.0f);
+    // Texture uploads and the GUI ran since the last frame; start from unknown state.
+    glState().beginFrame();
+    configureReadyPrograms();
+    // The clear honours the depth mask.
+    glState().depthMask(true);
+
+    // With fog, nothing past the fog wall is visible: the far plane moves in to
+    // it and the clear takes the fog color, so clipped and culled geometry
+    // looks exactly like the fully fogged geometry it replaces.
+    if (ENABLE_FOG) {
+        glClearColor(FOG_COLOR.x, FOG_COLOR.y, FOG_COLOR.z, 1.0f);
+    } else {
+        // Clear the screen with a dark blue color to match the PS1 aesthetic.
+        glClearColor(0.05f, 0.05f, 0.15f, 1.0f);
+    }
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    const float nearPlane = 0.1f;
+    const float farPlane = ENABLE_FOG ? fogHiddenDistance() : 100.0f;
+
     // Update the projection matrix based on the current camera zoom and aspect ratio.
     gameState->projection = glm::perspective(
         glm::radians(gameState->camera.Zoom), 
         (float)SCR_WIDTH / (float)SCR_HEIGHT, 
-        0.1f, 100.0f
+        nearPlane, farPlane
     );
 
-    // Render all scene components in order
-    renderLevel();
-    renderBonfire(gameState->hasBrokenSword);
-    renderSword(gameState->swordType);
-    renderLightBeam();
-}
\ No newline at end of file
+    float time = static_cast<float>(glfwGetTime());
+    glm::mat4 view = gameState->camera.GetViewMatrix();
+
+    // Bin the point lights into the froxel grid of this view.
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glm::mat4 viewProjection = gameState->projection * view;
+    updateSectors(viewProjection);
+    updateLights(time);
+    lightClusters.build(pointLights, view, gameState->projection, nearPlane, farPlane,
+                        glm::ivec2(viewport[2], viewport[3]));
+    lightClusters.bind();
+    variantContext.update(gameState->camera.Position, pointLights);
+
+    // Upload camera, lights and fog once for every program.
+    updateFrameConstants(time);
+
+    glBeginQuery(GL_TIME_ELAPSED, sceneTimeQueries[frameIndex & 1]);
+
+    // Hi-Z verdicts from a few frames ago filter this frame's draws; the
+    // conditional mode instead gates the forward batches on the GPU. The
+    // GPU-driven path skips Hi-Z: its occluders are the level's meshes pushed
+    // through the CPU queue, which is the per-mesh cost that path removes, and
+    // the few objects left to test are not worth it.
+    bool gpuDriven = useGpuDriven();
+    bool hiZ = gameState->occlusionMode == OcclusionMode::HiZ && occlusionCuller && occlusionCuller->isComplete() &&
+               !gpuDriven;
+    bool conditional = gameState->occlusionMode == OcclusionMode::ConditionalRender && occlusionCuller;
+    const std::vector<uint8_t>* occlusion = nullptr;
+    if (hiZ) {
+        occlusionCuller->collect();
+        occlusion = &occlusionCuller->meshVisibility();
+    } else if (occlusionCuller) {
+        occlusionCuller->reset();
+    }
+    if (conditional) {
+        occlusionCuller->beginQueryFrame();
+    }
+    renderQueue.setOcclusionVisibility(occlusion);
+    geometryQueue.setOcclusionVisibility(occlusion);
+    renderQueue.setConditionalRender(conditional ? occlusionCuller : nullptr);
+
+    // Collect the scene, then submit it sorted by layer, program, material and depth.
+    bool deferred = useDeferred();
+    renderQueue.begin(gameState->camera.Position, farPlane, viewProjection);
+    geometryQueue.begin(gameState->camera.Position, farPlane, viewProjection);
+    if (!gpuDriven) {
+        submitLevel();
+    }
+    submitBonfire(gameState->hasBrokenSword);
+    submitSword(gameState->swordType);
+    submitLightBeam();
+
+    if (deferred) {
+        geometryQueue.sort();
+    }
+    renderQueue.setDepthPrepass(gameState->depthPrepass);
+    renderQueue.sort();
+
+    // Sorting collected the candidates; test them before drawing anything.
+    if (hiZ) {
+        renderOccluders(viewProjection, farPlane, viewport);
+    }
+
+    // The compute pass replaces the BVH and per-mesh box tests; the rooms the portals reach still apply.
+    if (gpuDriven) {
+        indirectScene->cull(viewProjection, hasLevelSectors() ? &sectorMeshVisibility : nullptr);
+    }
+
+    if (deferred) {
+        deferredRenderer->beginGeometry();
+        if (gpuDriven) {
+            indirectScene->draw(meshPool, *gbufferShaders->full().shader);
+        }
+        geometryQueue.execute(meshPool);
+        deferredRenderer->lightAndResolve(lightClusters, view, gameState->projection, farPlane, viewport);
+    } else if (gpuDriven) {
+        // Drawn first, so the queue's opaque draws are depth tested against the level.
+        indirectScene->draw(meshPool, *levelShaders->full().shader);
+    }
+
+    renderQueue.execute(meshPool);
+    // Every draw reading the streamed constants and light lists has been issued.
+    frameConstantsStream.end();
+    lightClusters.endFrame();
+
+    glEndQuery(GL_TIME_ELAPSED);
+
+    // The other query was issued last frame and has normally finished by now.
+    GLuint previous = sceneTimeQueries[(frameIndex + 1) & 1];
+    GLint available = 0;
+    if (frameIndex > 0) {
+        glGetQueryObjectiv(previous, GL_QUERY_RESULT_AVAILABLE, &available);
+    }
+    if (available) {
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(previous, GL_QUERY_RESULT, &elapsed);
+        sceneGpuMilliseconds = static_cast<float>(elapsed) / 1.0e6f;
+    }
+    frameIndex++;
+}
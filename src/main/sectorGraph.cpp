@@ -0,0 +1,498 @@
+/**
+ * @file sectorGraph.cpp
+ * @brief Room and portal visibility for levels split into sectors.
+ *
+ * The frustum culler and the BVH only know what is in front of the camera;
+ * the portal walk also knows what can be seen through the doorways, so the
+ * rooms behind walls are dropped before any per-mesh test, and the cost of
+ * a frame follows what is in view rather than how big the level is.
+ */
+
+#include "sectorGraph.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <iostream>
+
+namespace {
+    const char SECTOR_PREFIX[] = "sector_";
+    const char PORTAL_PREFIX[] = "portal_";
+    const char SECTOR_MAGIC[4] = { 'P', 'S', 'S', 'G' };
+    // Guards against rectangles that keep growing by tiny amounts around a loop of rooms.
+    const int MAX_PORTAL_DEPTH = 16;
+
+    const glm::vec4 FULL_RECT(-1.0f, -1.0f, 1.0f, 1.0f);
+
+    bool startsWith(const std::string& name, const char* prefix) {
+        return name.compare(0, std::strlen(prefix), prefix) == 0;
+    }
+
+    /**
+     * @brief Reads one room name starting at from; it ends at '_', '.' or the end of the name.
+     */
+    std::string roomName(const std::string& name, size_t from, size_t& end) {
+        end = name.find_first_of("_.", from);
+        if (end == std::string::npos) {
+            end = name.size();
+        }
+        return name.substr(from, end - from);
+    }
+
+    bool insideBox(const glm::vec3& point, const glm::vec3& boxMin, const glm::vec3& boxMax) {
+        return point.x >= boxMin.x && point.y >= boxMin.y && point.z >= boxMin.z &&
+               point.x <= boxMax.x && point.y <= boxMax.y && point.z <= boxMax.z;
+    }
+
+    // Rectangles are NDC xy = min, zw = max.
+    bool contains(const glm::vec4& outer, const glm::vec4& inner) {
+        return inner.x >= outer.x && inner.y >= outer.y && inner.z <= outer.z && inner.w <= outer.w;
+    }
+
+    glm::vec4 unite(const glm::vec4& a, const glm::vec4& b) {
+        return glm::vec4(std::min(a.x, b.x), std::min(a.y, b.y), std::max(a.z, b.z), std::max(a.w, b.w));
+    }
+
+    glm::vec4 intersect(const glm::vec4& a, const glm::vec4& b) {
+        return glm::vec4(std::max(a.x, b.x), std::max(a.y, b.y), std::min(a.z, b.z), std::min(a.w, b.w));
+    }
+
+    bool isEmpty(const glm::vec4& rect) {
+        return rect.x >= rect.z || rect.y >= rect.w;
+    }
+
+    // Little-endian appends and bounds-checked reads for the cache image.
+    void put(std::vector<uint8_t>& out, const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        out.insert(out.end(), bytes, bytes + size);
+    }
+
+    struct Reader {
+        const uint8_t* cursor;
+        const uint8_t* end;
+
+        size_t remaining() const {
+            return static_cast<size_t>(end - cursor);
+        }
+
+        bool get(void* data, size_t size) {
+            if (remaining() < size) return false;
+            std::memcpy(data, cursor, size);
+            cursor += size;
+            return true;
+        }
+    };
+}
+
+/**
+ * @brief Whether an object name carries a sector or portal tag.
+ */
+bool SectorGraph::isTagged(const std::string& name) {
+    return startsWith(name, SECTOR_PREFIX) || startsWith(name, PORTAL_PREFIX);
+}
+
+/**
+ * @brief Returns the index of a room, creating it with empty bounds on first use.
+ */
+uint32_t SectorGraph::sectorIndex(const std::string& name) {
+    for (size_t i = 0; i < sectorList.size(); i++) {
+        if (sectorList[i].name == name) return static_cast<uint32_t>(i);
+    }
+    Sector sector;
+    sector.name = name;
+    sector.boundsMin = glm::vec3(FLT_MAX);
+    sector.boundsMax = glm::vec3(-FLT_MAX);
+    sectorList.push_back(sector);
+    return static_cast<uint32_t>(sectorList.size() - 1);
+}
+
+/**
+ * @brief Files one imported mesh under its room, or turns it into a portal.
+ * @param name The object name from the model file.
+ * @param positions Model-space vertex positions.
+ * @param indices Triangle list.
+ * @param mesh The index the mesh keeps in Model::meshes if it is not a portal.
+ * @return True if the mesh was a portal and must not be drawn.
+ */
+bool SectorGraph::addMesh(const std::string& name, const std::vector<glm::vec3>& positions,
+                          const std::vector<unsigned int>& indices, uint32_t mesh) {
+    if (startsWith(name, PORTAL_PREFIX)) {
+        size_t end = 0;
+        PendingPortal entry;
+        entry.first = roomName(name, std::strlen(PORTAL_PREFIX), end);
+        if (end < name.size() && name[end] == '_') {
+            entry.second = roomName(name, end + 1, end);
+        }
+        if (entry.first.empty() || entry.second.empty()) {
+            std::cerr << "Sector graph: portal " << name << " does not name two rooms" << std::endl;
+            return true;
+        }
+
+        SectorPortal& portal = entry.portal;
+        portal.boundsMin = glm::vec3(FLT_MAX);
+        portal.boundsMax = glm::vec3(-FLT_MAX);
+        for (unsigned int index : indices) {
+            const glm::vec3& corner = positions[index];
+            portal.triangles.push_back(corner);
+            portal.boundsMin = glm::min(portal.boundsMin, corner);
+            portal.boundsMax = glm::max(portal.boundsMax, corner);
+        }
+        pending.push_back(entry);
+        return true;
+    }
+
+    if (meshSectors.size() <= mesh) {
+        meshSectors.resize(mesh + 1, -1);
+    }
+    if (!startsWith(name, SECTOR_PREFIX)) {
+        return false;
+    }
+
+    size_t end = 0;
+    std::string room = roomName(name, std::strlen(SECTOR_PREFIX), end);
+    if (room.empty()) {
+        std::cerr << "Sector graph: " << name << " has no room name" << std::endl;
+        return false;
+    }
+    uint32_t index = sectorIndex(room);
+    Sector& sector = sectorList[index];
+    sector.meshes.push_back(mesh);
+    for (const glm::vec3& position : positions) {
+        sector.boundsMin = glm::min(sector.boundsMin, position);
+        sector.boundsMax = glm::max(sector.boundsMax, position);
+    }
+    meshSectors[mesh] = static_cast<int32_t>(index);
+    return false;
+}
+
+/**
+ * @brief Connects the portals to their rooms once every room is known.
+ */
+void SectorGraph::finalize() {
+    for (PendingPortal& entry : pending) {
+        uint32_t first = sectorIndex(entry.first);
+        uint32_t second = sectorIndex(entry.second);
+        if (first == second) {
+            std::cerr << "Sector graph: portal joins " << entry.first << " to itself" << std::endl;
+            continue;
+        }
+        entry.portal.sectors[0] = first;
+        entry.portal.sectors[1] = second;
+        uint32_t index = static_cast<uint32_t>(portalList.size());
+        portalList.push_back(std::move(entry.portal));
+        sectorList[first].portals.push_back(index);
+        sectorList[second].portals.push_back(index);
+    }
+    pending.clear();
+
+    for (const Sector& sector : sectorList) {
+        if (sector.meshes.empty()) {
+            std::cerr << "Sector graph: room " << sector.name << " is only named by portals" << std::endl;
+        }
+    }
+}
+
+/**
+ * @brief Points the rooms at the merged meshes.
+ * @param meshMap New index of every mesh passed to addMesh.
+ */
+void SectorGraph::remapMeshes(const std::vector<uint32_t>& meshMap) {
+    for (Sector& sector : sectorList) {
+        for (uint32_t& mesh : sector.meshes) {
+            mesh = meshMap[mesh];
+        }
+        std::sort(sector.meshes.begin(), sector.meshes.end());
+        sector.meshes.erase(std::unique(sector.meshes.begin(), sector.meshes.end()), sector.meshes.end());
+    }
+
+    std::vector<int32_t> remapped;
+    for (size_t mesh = 0; mesh < meshSectors.size(); mesh++) {
+        if (meshSectors[mesh] < 0) continue;
+        uint32_t target = meshMap[mesh];
+        if (remapped.size() <= target) {
+            remapped.resize(target + 1, -1);
+        }
+        remapped[target] = meshSectors[mesh];
+    }
+    meshSectors = std::move(remapped);
+}
+
+/**
+ * @brief Drops every room and portal.
+ */
+void SectorGraph::clear() {
+    sectorList.clear();
+    portalList.clear();
+    pending.clear();
+    meshSectors.clear();
+}
+
+/**
+ * @brief Sector of a mesh, or -1 if it is untagged.
+ */
+int SectorGraph::meshSector(uint32_t mesh) const {
+    return mesh < meshSectors.size() ? meshSectors[mesh] : -1;
+}
+
+/**
+ * @brief Finds the room a point is in. Boxes overlap around doorways, where
+ * the smaller room wins; the walk reaches the other one through the portal.
+ */
+int SectorGraph::findSector(const glm::vec3& point) const {
+    int best = -1;
+    float bestVolume = FLT_MAX;
+    for (size_t i = 0; i < sectorList.size(); i++) {
+        const Sector& sector = sectorList[i];
+        if (!insideBox(point, sector.boundsMin, sector.boundsMax)) continue;
+        glm::vec3 size = sector.boundsMax - sector.boundsMin;
+        float volume = size.x * size.y * size.z;
+        if (volume < bestVolume) {
+            bestVolume = volume;
+            best = static_cast<int>(i);
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Projects a portal to the screen, clipping its triangles at the near plane.
+ * @param rect [out] The NDC rectangle around what is left, clamped to the screen.
+ * @return False if nothing of the portal is in front of the camera and on screen.
+ */
+bool SectorGraph::projectPortal(const SectorPortal& portal, const glm::mat4& clip, glm::vec4& rect) const {
+    glm::vec4 bounds(FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX);
+    bool any = false;
+
+    for (size_t t = 0; t + 2 < portal.triangles.size(); t += 3) {
+        glm::vec4 corners[3];
+        for (int i = 0; i < 3; i++) {
+            corners[i] = clip * glm::vec4(portal.triangles[t + i], 1.0f);
+        }
+        // Keep the part with z >= -w, in front of the near plane.
+        for (int i = 0; i < 3; i++) {
+            const glm::vec4& current = corners[i];
+            const glm::vec4& next = corners[(i + 1) % 3];
+            float currentSide = current.z + current.w;
+            float nextSide = next.z + next.w;
+
+            glm::vec4 kept[2];
+            int keptCount = 0;
+            if (currentSide >= 0.0f) {
+                kept[keptCount++] = current;
+            }
+            if ((currentSide >= 0.0f) != (nextSide >= 0.0f)) {
+                float fraction = currentSide / (currentSide - nextSide);
+                kept[keptCount++] = current + (next - current) * fraction;
+            }
+            for (int k = 0; k < keptCount; k++) {
+                if (kept[k].w <= 1e-6f) continue;
+                float x = kept[k].x / kept[k].w;
+                float y = kept[k].y / kept[k].w;
+                bounds = unite(bounds, glm::vec4(x, y, x, y));
+                any = true;
+            }
+        }
+    }
+    if (!any) return false;
+
+    rect = intersect(bounds, FULL_RECT);
+    return !isEmpty(rect);
+}
+
+/**
+ * @brief Walks the portals from the camera's room and collects the rooms in view.
+ * @param clip Projection times view times the model matrix of the level.
+ * @param eye The camera position in model space.
+ * @param nearMargin Distance from a portal's box at which it no longer narrows the view.
+ * @param out [out] Visible rooms and the rectangles they are seen through.
+ */
+void SectorGraph::traverse(const glm::mat4& clip, const glm::vec3& eye, float nearMargin,
+                           SectorVisibility& out) const {
+    size_t count = sectorList.size();
+    out.sectors.assign(count, 0);
+    out.rects.assign(count, glm::vec4(FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX));
+    out.portalsTested = 0;
+    out.portalsPassed = 0;
+    out.cameraSector = findSector(eye);
+
+    // Outside the rooms (noclip, an unfinished level) there is nothing to walk from.
+    if (out.cameraSector < 0) {
+        std::fill(out.sectors.begin(), out.sectors.end(), 1);
+        std::fill(out.rects.begin(), out.rects.end(), FULL_RECT);
+        out.visibleSectors = static_cast<unsigned int>(count);
+        return;
+    }
+
+    struct Visit {
+        uint32_t sector;
+        glm::vec4 rect;
+        int depth;
+        uint32_t through; // portal it was entered by, never walked back through
+    };
+    std::vector<Visit> stack;
+    stack.push_back({ static_cast<uint32_t>(out.cameraSector), FULL_RECT, 0, UINT32_MAX });
+
+    while (!stack.empty()) {
+        Visit visit = stack.back();
+        stack.pop_back();
+
+        out.rects[visit.sector] = unite(out.rects[visit.sector], visit.rect);
+        out.sectors[visit.sector] = 1;
+        if (visit.depth >= MAX_PORTAL_DEPTH) continue;
+
+        for (uint32_t portalIndex : sectorList[visit.sector].portals) {
+            if (portalIndex == visit.through) continue;
+            const SectorPortal& portal = portalList[portalIndex];
+            out.portalsTested++;
+
+            // Standing in the doorway the portal is edge-on; it no longer limits the view.
+            glm::vec4 portalRect = FULL_RECT;
+            bool inDoorway = insideBox(eye, portal.boundsMin - nearMargin, portal.boundsMax + nearMargin);
+            if (!inDoorway && !projectPortal(portal, clip, portalRect)) continue;
+
+            glm::vec4 narrowed = intersect(visit.rect, portalRect);
+            if (isEmpty(narrowed)) continue;
+
+            uint32_t next = portal.other(visit.sector);
+            if (out.sectors[next] && contains(out.rects[next], narrowed)) continue;
+            out.portalsPassed++;
+            stack.push_back({ next, narrowed, visit.depth + 1, portalIndex });
+        }
+    }
+
+    out.visibleSectors = 0;
+    for (uint8_t visible : out.sectors) {
+        out.visibleSectors += visible;
+    }
+}
+
+/**
+ * @brief Scales and offsets clip x and y so the rectangle fills the clip volume.
+ */
+glm::mat4 SectorGraph::narrowToRect(const glm::mat4& clip, const glm::vec4& rect) {
+    glm::mat4 window(1.0f);
+    window[0][0] = 2.0f / (rect.z - rect.x);
+    window[1][1] = 2.0f / (rect.w - rect.y);
+    // Applied to w, so the offset stays correct after the perspective divide.
+    window[3][0] = -(rect.z + rect.x) / (rect.z - rect.x);
+    window[3][1] = -(rect.w + rect.y) / (rect.w - rect.y);
+    return window * clip;
+}
+
+/**
+ * @brief Writes the rooms, their meshes and the portals into one flat image.
+ */
+void SectorGraph::serialize(std::vector<uint8_t>& out) const {
+    out.clear();
+    put(out, SECTOR_MAGIC, sizeof(SECTOR_MAGIC));
+    uint32_t counts[3] = { static_cast<uint32_t>(sectorList.size()), static_cast<uint32_t>(portalList.size()),
+                           static_cast<uint32_t>(meshSectors.size()) };
+    put(out, counts, sizeof(counts));
+
+    for (const Sector& sector : sectorList) {
+        uint32_t nameLength = static_cast<uint32_t>(sector.name.size());
+        put(out, &nameLength, sizeof(nameLength));
+        put(out, sector.name.data(), nameLength);
+        put(out, &sector.boundsMin[0], sizeof(glm::vec3));
+        put(out, &sector.boundsMax[0], sizeof(glm::vec3));
+        uint32_t meshCount = static_cast<uint32_t>(sector.meshes.size());
+        put(out, &meshCount, sizeof(meshCount));
+        put(out, sector.meshes.data(), meshCount * sizeof(uint32_t));
+    }
+
+    for (const SectorPortal& portal : portalList) {
+        put(out, portal.sectors, sizeof(portal.sectors));
+        uint32_t cornerCount = static_cast<uint32_t>(portal.triangles.size());
+        put(out, &cornerCount, sizeof(cornerCount));
+        put(out, portal.triangles.data(), cornerCount * sizeof(glm::vec3));
+    }
+}
+
+/**
+ * @brief Restores a graph written by serialize.
+ *
+ * Every count is checked against the bytes left (or, for the per-mesh table,
+ * which has none, against meshCount) before anything is allocated for it.
+ * @param meshCount Meshes of the model the graph belongs to.
+ * @return False if the data is truncated, inconsistent or not a sector image.
+ */
+bool SectorGraph::deserialize(const uint8_t* data, size_t size, size_t meshCount) {
+    clear();
+    Reader reader{ data, data + size };
+
+    char magic[4];
+    uint32_t counts[3];
+    if (!reader.get(magic, sizeof(magic)) || std::memcmp(magic, SECTOR_MAGIC, sizeof(magic)) != 0 ||
+        !reader.get(counts, sizeof(counts))) {
+        return false;
+    }
+    // A sector is at least its name length, bounds and mesh count; a portal its sectors and corner count.
+    const size_t minSectorBytes = sizeof(uint32_t) + 2 * sizeof(glm::vec3) + sizeof(uint32_t);
+    const size_t minPortalBytes = 2 * sizeof(uint32_t) + sizeof(uint32_t);
+    if (counts[2] > meshCount || counts[0] > reader.remaining() / minSectorBytes) {
+        return false;
+    }
+    meshSectors.assign(counts[2], -1);
+
+    sectorList.resize(counts[0]);
+    for (uint32_t s = 0; s < counts[0]; s++) {
+        Sector& sector = sectorList[s];
+        uint32_t nameLength = 0;
+        if (!reader.get(&nameLength, sizeof(nameLength)) || reader.remaining() < nameLength) {
+            clear();
+            return false;
+        }
+        sector.name.assign(reinterpret_cast<const char*>(reader.cursor), nameLength);
+        reader.cursor += nameLength;
+
+        uint32_t sectorMeshCount = 0;
+        if (!reader.get(&sector.boundsMin[0], sizeof(glm::vec3)) || !reader.get(&sector.boundsMax[0], sizeof(glm::vec3)) ||
+            !reader.get(&sectorMeshCount, sizeof(sectorMeshCount)) ||
+            sectorMeshCount > reader.remaining() / sizeof(uint32_t)) {
+            clear();
+            return false;
+        }
+        sector.meshes.resize(sectorMeshCount);
+        if (!reader.get(sector.meshes.data(), sectorMeshCount * sizeof(uint32_t))) {
+            clear();
+            return false;
+        }
+        for (uint32_t mesh : sector.meshes) {
+            if (mesh >= meshSectors.size()) {
+                clear();
+                return false;
+            }
+            meshSectors[mesh] = static_cast<int32_t>(s);
+        }
+    }
+
+    if (counts[1] > reader.remaining() / minPortalBytes) {
+        clear();
+        return false;
+    }
+    portalList.resize(counts[1]);
+    for (uint32_t p = 0; p < counts[1]; p++) {
+        SectorPortal& portal = portalList[p];
+        uint32_t cornerCount = 0;
+        if (!reader.get(portal.sectors, sizeof(portal.sectors)) || !reader.get(&cornerCount, sizeof(cornerCount)) ||
+            portal.sectors[0] >= counts[0] || portal.sectors[1] >= counts[0] ||
+            portal.sectors[0] == portal.sectors[1] || cornerCount > reader.remaining() / sizeof(glm::vec3)) {
+            clear();
+            return false;
+        }
+        portal.triangles.resize(cornerCount);
+        if (!reader.get(portal.triangles.data(), cornerCount * sizeof(glm::vec3))) {
+            clear();
+            return false;
+        }
+        portal.boundsMin = glm::vec3(FLT_MAX);
+        portal.boundsMax = glm::vec3(-FLT_MAX);
+        for (const glm::vec3& corner : portal.triangles) {
+            portal.boundsMin = glm::min(portal.boundsMin, corner);
+            portal.boundsMax = glm::max(portal.boundsMax, corner);
+        }
+        sectorList[portal.sectors[0]].portals.push_back(p);
+        sectorList[portal.sectors[1]].portals.push_back(p);
+    }
+    return reader.cursor == reader.end;
+}
@@ -0,0 +1,295 @@
+/**
+ * @file shaderVariants.cpp
+ * @brief Generates the scene shader variants and picks the cheapest one per draw.
+ *
+ * The GLSL sources only hold the stage logic. The light structs, the
+ * FrameConstants block, the light cluster lookups and every count or switch
+ * that must agree with the C++ side are generated here and injected after
+ * #version, so the two sides cannot drift apart.
+ */
+
+#include "shaderVariants.h"
+#include "frameConstants.h"
+
+#include <bit>
+#include <sstream>
+
+namespace {
+    // Must match the std140 structs in frameConstants.h; the static_asserts there guard the C++ side.
+    const char* const FRAME_CONSTANTS_GLSL = R"(
+struct DirLight {
+    vec3 direction;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct PointLight {
+    vec3 position;
+    float constant;
+    float linear;
+    float quadratic;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// Per-frame constants shared by every scene shader (std140, binding 0).
+layout (std140) uniform FrameConstants {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    float time;
+    DirLight dirLight;
+    vec3 fogColor;
+    float fogNear;
+    float fogFar;
+    vec4 clusterParams; // xy: clusters per pixel, z: slices per log depth, w: slice bias
+};
+)";
+
+    // Must match MaterialParams in material.h. The block is bound per material
+    // (binding 1) and the maps sit on fixed units, so no uniform changes per draw.
+    const char* const MATERIAL_GLSL = R"(
+layout (std140) uniform MaterialParams {
+    vec4 diffuseColor; // multiplies the diffuse map
+    float shininess;
+    float alpha;
+    float emissiveStrength;
+} material;
+
+uniform sampler2D diffuseMap;
+)";
+
+    // Lookups into the buffers written by LightClusters::build.
+    const char* const LIGHT_CLUSTERS_GLSL = R"(
+#ifdef POINT_LIGHTS
+uniform usamplerBuffer lightClusters; // per cluster: first index, count
+uniform usamplerBuffer lightIndices;
+uniform samplerBuffer lightData;      // LIGHT_DATA_TEXELS texels per light
+
+// window position and world position to the cluster's (first index, count)
+uvec2 lightCluster(vec2 fragCoord, vec3 worldPos) {
+    float depth = -(view * vec4(worldPos, 1.0)).z;
+    ivec3 cell = ivec3(vec3(fragCoord * clusterParams.xy, log(max(depth, 1e-4)) * clusterParams.z + clusterParams.w));
+    cell = clamp(cell, ivec3(0), ivec3(LIGHT_CLUSTER_X - 1, LIGHT_CLUSTER_Y - 1, LIGHT_CLUSTER_Z - 1));
+    return texelFetch(lightClusters, (cell.z * LIGHT_CLUSTER_Y + cell.y) * LIGHT_CLUSTER_X + cell.x).xy;
+}
+
+PointLight fetchPointLight(uint listIndex) {
+    int base = int(texelFetch(lightIndices, int(listIndex)).x) * LIGHT_DATA_TEXELS;
+    vec4 positionConstant = texelFetch(lightData, base);
+    vec4 ambientLinear = texelFetch(lightData, base + 1);
+    vec4 diffuseQuadratic = texelFetch(lightData, base + 2);
+    vec4 specularRange = texelFetch(lightData, base + 3);
+
+    PointLight light;
+    light.position = positionConstant.xyz;
+    light.constant = positionConstant.w;
+    light.ambient = ambientLinear.rgb;
+    light.linear = ambientLinear.w;
+    light.diffuse = diffuseQuadratic.rgb;
+    light.quadratic = diffuseQuadratic.w;
+    light.specular = specularRange.rgb;
+    return light;
+}
+#endif
+)";
+}
+
+/**
+ * @brief Returns the features the config allows.
+ */
+uint32_t enabledShaderFeatures() {
+    uint32_t features = SHADER_FEATURE_POINT_LIGHTS | SHADER_FEATURE_EMISSIVE;
+    if (ENABLE_FOG) features |= SHADER_FEATURE_FOG;
+    if (ENABLE_QUANTIZATION) features |= SHADER_FEATURE_QUANTIZE;
+    return features;
+}
+
+/**
+ * @brief Builds the source injected into both stages of a variant.
+ * @param features ShaderFeature bits; ones the config disables are dropped.
+ */
+std::string shaderVariantHeader(uint32_t features) {
+    features &= enabledShaderFeatures();
+
+    std::ostringstream header;
+    header << "#define LIGHT_CLUSTER_X " << LIGHT_CLUSTER_X << "\n";
+    header << "#define LIGHT_CLUSTER_Y " << LIGHT_CLUSTER_Y << "\n";
+    header << "#define LIGHT_CLUSTER_Z " << LIGHT_CLUSTER_Z << "\n";
+    header << "#define LIGHT_DATA_TEXELS " << LIGHT_DATA_TEXELS << "\n";
+    header << "#define ATTENUATION_LEVELS " << LIGHT_ATTENUATION_LEVELS << ".0\n";
+    header << "#define FOG_LEVELS " << FOG_LEVELS << ".0\n";
+    if (features & SHADER_FEATURE_POINT_LIGHTS) header << "#define POINT_LIGHTS 1\n";
+    if (features & SHADER_FEATURE_FOG) header << "#define FOG 1\n";
+    if (features & SHADER_FEATURE_QUANTIZE) header << "#define QUANTIZE 1\n";
+    if (features & SHADER_FEATURE_EMISSIVE) header << "#define EMISSIVE 1\n";
+    header << FRAME_CONSTANTS_GLSL;
+    header << MATERIAL_GLSL;
+    header << LIGHT_CLUSTERS_GLSL;
+    return header.str();
+}
+
+/**
+ * @brief Distance from the camera past which the quantized fog factor is zero.
+ */
+float fogHiddenDistance() {
+    return FOG_FAR - (FOG_FAR - FOG_NEAR) / static_cast<float>(FOG_LEVELS);
+}
+
+/**
+ * @brief Captures the camera and the reach of every light for this frame.
+ */
+void ShaderVariantContext::update(const glm::vec3& camera, const std::vector<ScenePointLight>& pointLights) {
+    cameraPosition = camera;
+    fogNear = FOG_NEAR;
+    fogHidden = fogHiddenDistance();
+    lights.clear();
+    for (const ScenePointLight& light : pointLights) {
+        lights.push_back(glm::vec4(light.position, pointLightRange(light)));
+    }
+}
+
+/**
+ * @brief Works out which optional features a draw can actually see.
+ *
+ * Fog is a no-op closer than fogNear, and a point light is a no-op past its
+ * range, so a draw whose bounds stay on the near side of the first and the far
+ * side of the second can use a variant without them.
+ */
+uint32_t ShaderVariantContext::requiredFeatures(const glm::vec3& center, float radius) const {
+    uint32_t required = 0;
+    if (glm::length(center - cameraPosition) + radius > fogNear) {
+        required |= SHADER_FEATURE_FOG;
+    }
+    for (const glm::vec4& light : lights) {
+        if (glm::length(center - glm::vec3(light)) - radius < light.w) {
+            required |= SHADER_FEATURE_POINT_LIGHTS;
+            break;
+        }
+    }
+    return required;
+}
+
+/**
+ * @brief Whether fog fully covers a draw covering the world-space sphere (center, radius).
+ */
+bool ShaderVariantContext::hiddenByFog(const glm::vec3& center, float radius) const {
+    return glm::length(center - cameraPosition) - radius > fogHidden;
+}
+
+/**
+ * @brief Submits one program per subset of the optional features.
+ *
+ * Shader only starts the builds, so all variants compile in parallel where the
+ * driver allows it.
+ */
+ShaderVariantSet::ShaderVariantSet(const char* vertexPath, const char* fragmentPath, uint32_t fixed,
+                                   uint32_t optional, uint8_t sortId)
+    : fixedFeatures(fixed & enabledShaderFeatures()),
+      optionalFeatures(optional & enabledShaderFeatures() & ~fixedFeatures),
+      firstSortId(sortId) {
+    // Walks the subsets of optionalFeatures in increasing order, ending with the full set.
+    for (uint32_t subset = 0;; subset = (subset - optionalFeatures) & optionalFeatures) {
+        uint32_t features = fixedFeatures | subset;
+        Shader* shader = new Shader(vertexPath, fragmentPath, shaderVariantHeader(features));
+        uint8_t id = static_cast<uint8_t>(firstSortId + variants.size());
+        variants.emplace_back(features, RenderProgram{ shader, id });
+        if (subset == optionalFeatures) break;
+    }
+    configured.assign(variants.size(), 0);
+}
+
+/**
+ * @brief Deletes every variant program.
+ */
+ShaderVariantSet::~ShaderVariantSet() {
+    for (auto& variant : variants) {
+        delete variant.second.shader;
+    }
+}
+
+/**
+ * @brief Returns the variant with exactly the fixed features plus the supported part of required.
+ *
+ * While that one is still building, a configured variant with more features
+ * draws the same image at a higher cost; only when there is none does this
+ * wait for the build.
+ */
+const RenderProgram& ShaderVariantSet::select(uint32_t required) const {
+    uint32_t features = fixedFeatures | (required & optionalFeatures);
+    size_t exact = variants.size() - 1;
+    for (size_t i = 0; i < variants.size(); i++) {
+        if (variants[i].first == features) {
+            exact = i;
+            break;
+        }
+    }
+    if (!configure || configured[exact]) {
+        return variants[exact].second;
+    }
+
+    size_t fallback = variants.size();
+    for (size_t i = 0; i < variants.size(); i++) {
+        bool covers = (variants[i].first & features) == features;
+        if (configured[i] && covers &&
+            (fallback == variants.size() || std::popcount(variants[i].first) < std::popcount(variants[fallback].first))) {
+            fallback = i;
+        }
+    }
+    if (fallback < variants.size()) {
+        return variants[fallback].second;
+    }
+
+    configureVariant(exact);
+    return variants[exact].second;
+}
+
+/**
+ * @brief Sets the program state callback and forgets which variants it was applied to.
+ */
+void ShaderVariantSet::setConfigure(std::function<void(const Shader&)> configureVariant) {
+    configure = std::move(configureVariant);
+    configured.assign(variants.size(), 0);
+}
+
+/**
+ * @brief Configures every variant whose build has finished, without waiting for the others.
+ */
+void ShaderVariantSet::configureReady() {
+    if (!configure) return;
+    for (size_t i = 0; i < variants.size(); i++) {
+        if (!configured[i] && variants[i].second.shader->isReady()) {
+            configureVariant(i);
+        }
+    }
+}
+
+/**
+ * @brief Applies the program state to one variant, finalizing (and if needed waiting for) its program.
+ */
+void ShaderVariantSet::configureVariant(size_t index) const {
+    configure(*variants[index].second.shader);
+    configured[index] = 1;
+}
+
+/**
+ * @brief Gives every variant the depth-only program of the depth pre-pass.
+ * @param shader A program whose vertex stage transforms exactly like the variants', or nullptr to opt out.
+ */
+void ShaderVariantSet::setDepthShader(Shader* shader) {
+    for (auto& variant : variants) {
+        variant.second.depthShader = shader;
+    }
+}
+
+/**
+ * @brief Whether these programs draw pure fog color beyond fogHiddenDistance().
+ *
+ * Programs without fog, and emissive ones whose glow shows through it, never do.
+ */
+bool ShaderVariantSet::fadesOutInFog() const {
+    uint32_t features = fixedFeatures | optionalFeatures;
+    return (features & SHADER_FEATURE_FOG) && !(features & SHADER_FEATURE_EMISSIVE);
+}
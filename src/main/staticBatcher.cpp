@@ -0,0 +1,111 @@
+/**
+ * @file staticBatcher.cpp
+ * @brief Load-time merging of static geometry into one mesh per material.
+ *
+ * Static objects are split by the modelling tool, not by how they draw: the
+ * level's walls, floor and roof are separate objects with the same material.
+ * Baking their transforms into the vertices and concatenating everything that
+ * shares a material turns them into one draw per material.
+ */
+
+#include "staticBatcher.h"
+
+#include <utility>
+
+namespace {
+    /**
+     * @brief Transforms a direction and renormalizes it, leaving zero vectors alone.
+     */
+    glm::vec3 transformDirection(const glm::mat3& linear, const glm::vec3& direction) {
+        glm::vec3 result = linear * direction;
+        float length = glm::length(result);
+        return length > 0.0f ? result / length : result;
+    }
+}
+
+/**
+ * @brief Bakes a transform into the vertices of every mesh.
+ * @param meshes CPU-side meshes, replaced by their transformed copies.
+ * @param transform The model matrix to apply.
+ */
+void bakeStaticTransform(std::vector<Mesh>& meshes, const glm::mat4& transform) {
+    glm::mat3 linear(transform);
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(linear));
+    bool mirrored = glm::determinant(linear) < 0.0f;
+
+    for (Mesh& mesh : meshes) {
+        std::vector<Vertex> vertices = std::move(mesh.vertices);
+        std::vector<unsigned int> indices = std::move(mesh.indices);
+        for (Vertex& vertex : vertices) {
+            vertex.Position = glm::vec3(transform * glm::vec4(vertex.Position, 1.0f));
+            vertex.Normal = transformDirection(normalMatrix, vertex.Normal);
+            vertex.Tangent = transformDirection(linear, vertex.Tangent);
+            vertex.Bitangent = transformDirection(linear, vertex.Bitangent);
+        }
+        // A negative determinant turns front faces into back faces.
+        if (mirrored) {
+            for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+                std::swap(indices[i + 1], indices[i + 2]);
+            }
+        }
+        const Material* material = mesh.material;
+        mesh = Mesh(std::move(vertices), std::move(indices), mesh.textures);
+        mesh.material = material;
+    }
+}
+
+/**
+ * @brief Concatenates meshes with the same material (and group) into batches.
+ * @param meshes CPU-side meshes, replaced by the batches.
+ * @param groups Optional extra key per mesh; empty puts every mesh in one group.
+ * @param meshMap Receives, per original mesh, the index of the batch holding it.
+ * @return Counts before and after.
+ */
+StaticBatchStats batchStaticMeshes(std::vector<Mesh>& meshes, const std::vector<int>& groups,
+                                   std::vector<uint32_t>& meshMap) {
+    StaticBatchStats stats;
+    stats.meshesBefore = meshes.size();
+
+    // Which source meshes go into each batch, in order of first appearance.
+    std::vector<std::vector<uint32_t>> members;
+    meshMap.assign(meshes.size(), 0);
+    for (uint32_t i = 0; i < meshes.size(); i++) {
+        int group = i < groups.size() ? groups[i] : 0;
+        size_t batch = 0;
+        for (; batch < members.size(); batch++) {
+            uint32_t first = members[batch][0];
+            int firstGroup = first < groups.size() ? groups[first] : 0;
+            if (firstGroup == group && meshes[first].material == meshes[i].material) break;
+        }
+        if (batch == members.size()) {
+            members.emplace_back();
+        }
+        members[batch].push_back(i);
+        meshMap[i] = static_cast<uint32_t>(batch);
+    }
+
+    std::vector<Mesh> batches;
+    batches.reserve(members.size());
+    for (const std::vector<uint32_t>& sources : members) {
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        for (uint32_t source : sources) {
+            Mesh& mesh = meshes[source];
+            unsigned int base = static_cast<unsigned int>(vertices.size());
+            vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+            for (unsigned int index : mesh.indices) {
+                indices.push_back(base + index);
+            }
+            std::vector<Vertex>().swap(mesh.vertices);
+            std::vector<unsigned int>().swap(mesh.indices);
+        }
+        stats.vertices += vertices.size();
+        stats.triangles += indices.size() / 3;
+        batches.push_back(Mesh(std::move(vertices), std::move(indices), meshes[sources[0]].textures));
+        batches.back().material = meshes[sources[0]].material;
+    }
+
+    meshes = std::move(batches);
+    stats.batches = meshes.size();
+    return stats;
+}
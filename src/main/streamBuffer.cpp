@@ -0,0 +1,165 @@
+/**
+ * @file streamBuffer.cpp
+ * @brief Implements the per-frame ring of persistently mapped regions and its orphaning fallback.
+ *
+ * Storage is always created and updated through GL_COPY_WRITE_BUFFER, so
+ * streaming never disturbs the array, element or uniform bindings of the
+ * code drawing with it.
+ */
+
+#include "streamBuffer.h"
+#include "glCaps.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+    // The largest offset alignment GL allows for uniform and texture buffers;
+    // regions start on it so any write alignment holds across regions.
+    const size_t REGION_ALIGNMENT = 256;
+    const size_t MIN_REGION_SIZE = 4096;
+
+    size_t alignUp(size_t value, size_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+/**
+ * @brief Unmaps and releases the buffer and its fences.
+ */
+StreamBuffer::~StreamBuffer() {
+    release();
+}
+
+/**
+ * @brief Deletes the buffer and any pending fences.
+ *
+ * Commands already issued keep the old storage alive, so this never waits.
+ */
+void StreamBuffer::release() {
+    for (GLsync& fence : fences) {
+        if (fence) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+    if (name) {
+        // Deleting a mapped buffer unmaps it.
+        glDeleteBuffers(1, &name);
+        name = 0;
+    }
+    mapped = nullptr;
+}
+
+/**
+ * @brief Creates the buffer with room for size bytes per region.
+ */
+void StreamBuffer::allocate(size_t size) {
+    release();
+    regionSize = alignUp(std::max(size, MIN_REGION_SIZE), REGION_ALIGNMENT);
+    region = 0;
+
+    bool persistent = glCaps().bufferStorage && (target != GL_TEXTURE_BUFFER || glCaps().textureBufferRange);
+
+    glGenBuffers(1, &name);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, name);
+    if (persistent) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        GLsizeiptr total = static_cast<GLsizeiptr>(regionSize * REGIONS);
+        glBufferStorage(GL_COPY_WRITE_BUFFER, total, nullptr, flags);
+        mapped = static_cast<uint8_t*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, total, flags));
+        if (!mapped) {
+            // Immutable storage cannot be respecified, so the fallback needs a new name.
+            std::cerr << "Stream buffer: persistent mapping failed, falling back to orphaning" << std::endl;
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            glDeleteBuffers(1, &name);
+            glGenBuffers(1, &name);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, name);
+        }
+    }
+    if (!mapped) {
+        glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(regionSize), nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+/**
+ * @brief Moves to the next region and makes sure the GPU is done reading it.
+ * @param bytes What this use will write in total.
+ */
+void StreamBuffer::begin(size_t bytes) {
+    // Each write may pad up to its alignment.
+    size_t needed = bytes + REGION_ALIGNMENT;
+    if (!name || needed > regionSize) {
+        allocate(std::max(needed, regionSize * 2));
+    } else if (mapped) {
+        region = (region + 1) % REGIONS;
+    }
+    cursor = 0;
+
+    if (!mapped) {
+        // Orphan: the driver hands out fresh storage while the old one drains.
+        glBindBuffer(GL_COPY_WRITE_BUFFER, name);
+        glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(regionSize), nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        return;
+    }
+
+    GLsync& fence = fences[region];
+    if (!fence) return;
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        // Three uses behind: the CPU is far ahead of the GPU and has to wait.
+        stallCount++;
+        const GLuint64 oneMillisecond = 1000000;
+        do {
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, oneMillisecond);
+        } while (status == GL_TIMEOUT_EXPIRED);
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+/**
+ * @brief Copies data into the current region.
+ * @param data The bytes to copy; may be null when bytes is zero.
+ * @param bytes How many bytes.
+ * @param alignment Required offset alignment, e.g. GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT.
+ * @return The offset of the copy in buffer(), or -1 if it does not fit.
+ */
+GLintptr StreamBuffer::write(const void* data, size_t bytes, size_t alignment) {
+    size_t offset = alignUp(cursor, std::max<size_t>(alignment, 1));
+    if (!name || offset + bytes > regionSize) {
+        std::cerr << "Stream buffer: region of " << regionSize << " bytes is full" << std::endl;
+        return -1;
+    }
+    cursor = offset + bytes;
+
+    if (mapped) {
+        size_t absolute = static_cast<size_t>(region) * regionSize + offset;
+        if (bytes > 0) {
+            std::memcpy(mapped + absolute, data, bytes);
+        }
+        return static_cast<GLintptr>(absolute);
+    }
+
+    if (bytes > 0) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, name);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(bytes), data);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    return static_cast<GLintptr>(offset);
+}
+
+/**
+ * @brief Marks the current region as in use until the commands issued so far complete.
+ */
+void StreamBuffer::end() {
+    if (!mapped) return;
+    GLsync& fence = fences[region];
+    if (fence) {
+        glDeleteSync(fence);
+    }
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
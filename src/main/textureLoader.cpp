@@ -0,0 +1,278 @@
+/**
+ * @file textureLoader.cpp
+ * @brief Implements threaded image decoding with PBO-streamed texture uploads.
+ *
+ * Worker threads run stbi_load and hand the pixels back through a queue. The
+ * GL thread copies each image into the next pixel buffer of a small ring and
+ * respecifies the texture from it, so the driver can transfer asynchronously
+ * instead of copying out of client memory inside glTexImage2D. A fence per
+ * pixel buffer keeps the ring from overwriting data that is still in use.
+ */
+
+#include "textureLoader.h"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+/**
+ * @brief Starts the decoder threads.
+ * @param workerCount Number of threads; 0 picks one per core minus the GL thread.
+ */
+TextureLoader::TextureLoader(unsigned int workerCount) {
+    if (workerCount == 0) {
+        unsigned int cores = std::thread::hardware_concurrency();
+        workerCount = cores > 1 ? cores - 1 : 1;
+    }
+    for (unsigned int i = 0; i < workerCount; i++) {
+        workers.emplace_back(&TextureLoader::workerLoop, this);
+    }
+}
+
+/**
+ * @brief Stops the workers and releases every texture and pixel buffer. Needs the GL context.
+ */
+TextureLoader::~TextureLoader() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    for (DecodedImage& image : decoded) {
+        stbi_image_free(image.pixels);
+    }
+
+    for (auto& entry : loaded) {
+        glDeleteTextures(1, &entry.second);
+    }
+    for (GLuint texture : released) {
+        glDeleteTextures(1, &texture);
+    }
+    for (PixelBuffer& pixelBuffer : pixelBuffers) {
+        if (pixelBuffer.fence) glDeleteSync(pixelBuffer.fence);
+        if (pixelBuffer.buffer) glDeleteBuffers(1, &pixelBuffer.buffer);
+    }
+}
+
+/**
+ * @brief Queues an image for decoding and returns its texture right away.
+ * @param path The image file.
+ * @param sampling Filtering, wrapping and mipmapping of the final texture.
+ * @return A texture name that shows a placeholder until the image arrives.
+ * The same path always yields the same texture.
+ */
+GLuint TextureLoader::load(const std::string& path, const TextureSampling& sampling) {
+    auto it = loaded.find(path);
+    if (it != loaded.end()) {
+        return it->second;
+    }
+
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    createPlaceholder(texture);
+    loaded[path] = texture;
+    pending.insert(texture);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back({ texture, path, sampling });
+    }
+    jobReady.notify_one();
+    return texture;
+}
+
+/**
+ * @brief Deletes a texture created by load().
+ *
+ * A texture whose decode is still in flight is deleted once the decode comes
+ * back, so its name cannot be reused and then overwritten by the late upload.
+ */
+void TextureLoader::release(GLuint texture) {
+    for (auto it = loaded.begin(); it != loaded.end(); ++it) {
+        if (it->second == texture) {
+            loaded.erase(it);
+            break;
+        }
+    }
+
+    if (pending.count(texture)) {
+        released.insert(texture);
+    } else {
+        glDeleteTextures(1, &texture);
+    }
+}
+
+/**
+ * @brief Uploads images the workers have finished decoding.
+ * @param maxUploads Upper bound on uploads in this call, 0 for no limit.
+ */
+void TextureLoader::update(unsigned int maxUploads) {
+    unsigned int uploads = 0;
+    while (maxUploads == 0 || uploads < maxUploads) {
+        DecodedImage image;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (decoded.empty()) {
+                break;
+            }
+            image = decoded.front();
+            decoded.pop_front();
+        }
+
+        if (!upload(image)) {
+            // Every pixel buffer is still being read; try again next time.
+            std::lock_guard<std::mutex> lock(mutex);
+            decoded.push_front(image);
+            break;
+        }
+        uploads++;
+    }
+}
+
+/**
+ * @brief Waits for every queued texture to be decoded and uploaded.
+ */
+void TextureLoader::finish() {
+    while (!pending.empty()) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            imageReady.wait(lock, [this] { return !decoded.empty(); });
+        }
+        update();
+    }
+}
+
+/**
+ * @brief Returns the number of textures still showing their placeholder.
+ */
+size_t TextureLoader::pendingCount() const {
+    return pending.size();
+}
+
+/**
+ * @brief Decodes queued images until the loader shuts down.
+ */
+void TextureLoader::workerLoop() {
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobReady.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (stopping) {
+                return;
+            }
+            job = jobs.front();
+            jobs.pop_front();
+        }
+
+        DecodedImage image{ job.texture, job.path, job.sampling, nullptr, 0, 0, 0 };
+        image.pixels = stbi_load(job.path.c_str(), &image.width, &image.height, &image.channels, 0);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            decoded.push_back(image);
+        }
+        imageReady.notify_one();
+    }
+}
+
+/**
+ * @brief Streams one decoded image into its texture through the pixel buffer ring.
+ * @return False if the next pixel buffer is still in use; the image is untouched.
+ */
+bool TextureLoader::upload(DecodedImage& image) {
+    if (released.count(image.texture)) {
+        released.erase(image.texture);
+        pending.erase(image.texture);
+        glDeleteTextures(1, &image.texture);
+        stbi_image_free(image.pixels);
+        return true;
+    }
+
+    if (!image.pixels) {
+        std::cout << "Texture failed to load at path: " << image.path << std::endl;
+        pending.erase(image.texture);
+        return true;
+    }
+
+    PixelBuffer& pixelBuffer = pixelBuffers[nextPixelBuffer];
+    if (pixelBuffer.fence) {
+        if (glClientWaitSync(pixelBuffer.fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            return false;
+        }
+        glDeleteSync(pixelBuffer.fence);
+        pixelBuffer.fence = nullptr;
+    }
+    nextPixelBuffer = (nextPixelBuffer + 1) % PIXEL_BUFFER_COUNT;
+
+    if (!pixelBuffer.buffer) {
+        glGenBuffers(1, &pixelBuffer.buffer);
+    }
+
+    size_t bytes = static_cast<size_t>(image.width) * image.height * image.channels;
+    pixelBuffer.capacity = std::max(pixelBuffer.capacity, bytes);
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer.buffer);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, pixelBuffer.capacity, nullptr, GL_STREAM_DRAW);
+    void* destination = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+                                         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    const void* source = nullptr; // offset into the pixel buffer
+    if (destination) {
+        std::memcpy(destination, image.pixels, bytes);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    } else {
+        // Mapping failed; fall back to a plain client-memory upload.
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        source = image.pixels;
+    }
+
+    GLenum format = GL_RGB;
+    if (image.channels == 1)
+        format = GL_RED;
+    else if (image.channels == 2)
+        format = GL_RG;
+    else if (image.channels == 4)
+        format = GL_RGBA;
+
+    glBindTexture(GL_TEXTURE_2D, image.texture);
+    // stb rows are tightly packed.
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, source);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    if (image.sampling.mipmaps) {
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, image.sampling.wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, image.sampling.wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, image.sampling.minFilter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, image.sampling.magFilter);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    if (destination) {
+        pixelBuffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    stbi_image_free(image.pixels);
+    pending.erase(image.texture);
+    return true;
+}
+
+/**
+ * @brief Gives a new texture a 1x1 grey image so it is complete until the real one lands.
+ */
+void TextureLoader::createPlaceholder(GLuint texture) {
+    const unsigned char grey[4] = { 128, 128, 128, 255 };
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
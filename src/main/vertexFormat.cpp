@@ -0,0 +1,182 @@
+/**
+ * @file vertexFormat.cpp
+ * @brief Encodes imported vertices into compact GPU layouts and describes them to OpenGL.
+ */
+
+#include "vertexFormat.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+    const float POSITION_QUANT_MAX = 32767.0f;
+}
+
+/**
+ * @brief Returns the size in bytes of one vertex in the given format.
+ */
+size_t vertexFormatStride(VertexFormat format) {
+    switch (format) {
+        case VertexFormat::Full:     return sizeof(Vertex);
+        case VertexFormat::Standard: return sizeof(StandardVertex);
+        case VertexFormat::Packed:   return sizeof(PackedVertex);
+        default:                     return 0;
+    }
+}
+
+/**
+ * @brief Returns a printable name for a vertex format.
+ */
+const char* vertexFormatName(VertexFormat format) {
+    switch (format) {
+        case VertexFormat::Full:     return "full";
+        case VertexFormat::Standard: return "standard";
+        case VertexFormat::Packed:   return "packed";
+        default:                     return "unknown";
+    }
+}
+
+/**
+ * @brief Picks the smallest vertex format that serves both the shader and the mesh.
+ * @param shaderAttributeMask Bit i set if the target shader reads attribute location i.
+ * @param vertices The mesh's imported vertices.
+ * @return Full if the shader reads tangents or bones, Packed if the UVs fit half
+ * precision, Standard otherwise.
+ */
+VertexFormat chooseVertexFormat(uint32_t shaderAttributeMask, const std::vector<Vertex>& vertices) {
+    if (shaderAttributeMask & TANGENT_SPACE_ATTRIBUTE_MASK) {
+        return VertexFormat::Full;
+    }
+
+    for (const Vertex& v : vertices) {
+        if (std::abs(v.TexCoords.x) > PACKED_UV_LIMIT || std::abs(v.TexCoords.y) > PACKED_UV_LIMIT) {
+            return VertexFormat::Standard;
+        }
+    }
+    return VertexFormat::Packed;
+}
+
+/**
+ * @brief Converts imported vertices into the byte layout of a GPU vertex format.
+ * @param vertices The imported vertices.
+ * @param format The target format.
+ * @param boundsMin Minimum corner of the mesh bounds, used to quantize positions.
+ * @param boundsMax Maximum corner of the mesh bounds.
+ * @param positionDecode [out] Matrix mapping stored positions back to model space.
+ * @return The encoded vertex data, ready for upload.
+ */
+std::vector<uint8_t> encodeVertices(const std::vector<Vertex>& vertices, VertexFormat format,
+                                    const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+                                    glm::mat4& positionDecode) {
+    std::vector<uint8_t> bytes(vertices.size() * vertexFormatStride(format));
+    positionDecode = glm::mat4(1.0f);
+
+    if (format == VertexFormat::Full) {
+        if (!vertices.empty()) {
+            std::memcpy(bytes.data(), vertices.data(), bytes.size());
+        }
+        return bytes;
+    }
+
+    if (format == VertexFormat::Standard) {
+        StandardVertex* out = reinterpret_cast<StandardVertex*>(bytes.data());
+        for (size_t i = 0; i < vertices.size(); i++) {
+            out[i].position = vertices[i].Position;
+            out[i].normal = vertices[i].Normal;
+            out[i].texCoords = vertices[i].TexCoords;
+        }
+        return bytes;
+    }
+
+    // Packed: quantize with one scale for all axes so the decode matrix stays a
+    // uniform scale and the shaders' normal matrix keeps normals undistorted.
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    glm::vec3 halfExtent = (boundsMax - boundsMin) * 0.5f;
+    float extent = std::max(halfExtent.x, std::max(halfExtent.y, halfExtent.z));
+    if (extent <= 0.0f) {
+        extent = 1.0f;
+    }
+    float step = extent / POSITION_QUANT_MAX;
+
+    positionDecode = glm::translate(glm::mat4(1.0f), center);
+    positionDecode = glm::scale(positionDecode, glm::vec3(step));
+
+    PackedVertex* out = reinterpret_cast<PackedVertex*>(bytes.data());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        const Vertex& v = vertices[i];
+        glm::vec3 q = (v.Position - center) / step;
+        for (int axis = 0; axis < 3; axis++) {
+            float value = std::round(glm::clamp(q[axis], -POSITION_QUANT_MAX, POSITION_QUANT_MAX));
+            out[i].position[axis] = static_cast<int16_t>(value);
+        }
+        out[i].position[3] = 0;
+
+        glm::vec3 n = v.Normal;
+        float length = glm::length(n);
+        n = length > 0.0f ? n / length : glm::vec3(0.0f, 1.0f, 0.0f);
+        out[i].normal = glm::packSnorm3x10_1x2(glm::vec4(n, 0.0f));
+
+        uint32_t uv = glm::packHalf2x16(v.TexCoords);
+        out[i].texCoords[0] = static_cast<uint16_t>(uv & 0xFFFF);
+        out[i].texCoords[1] = static_cast<uint16_t>(uv >> 16);
+    }
+    return bytes;
+}
+
+/**
+ * @brief Sets the attribute pointers of a vertex format on the bound VAO.
+ */
+void describeVertexFormat(VertexFormat format) {
+    switch (format) {
+        case VertexFormat::Full:
+            // vertex Positions
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+            // vertex normals
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+            // vertex texture coords
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+            // vertex tangent
+            glEnableVertexAttribArray(3);
+            glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+            // vertex bitangent
+            glEnableVertexAttribArray(4);
+            glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+            // ids
+            glEnableVertexAttribArray(5);
+            glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, m_BoneIDs));
+            // weights
+            glEnableVertexAttribArray(6);
+            glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
+            break;
+
+        case VertexFormat::Standard:
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(StandardVertex), (void*)offsetof(StandardVertex, position));
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(StandardVertex), (void*)offsetof(StandardVertex, normal));
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(StandardVertex), (void*)offsetof(StandardVertex, texCoords));
+            break;
+
+        case VertexFormat::Packed:
+            // Positions are read unnormalized so the integers arrive exactly; the
+            // decode matrix folded into the instance transform rescales them.
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_SHORT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, position));
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, normal));
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, texCoords));
+            break;
+
+        default:
+            break;
+    }
+}
@@ -1,31 +1,15 @@
 #version 330 core
 out vec4 FragColor;
 
-struct Material {
-    sampler2D diffuse;
-    float shininess;
-    float emissiveStrength;
-}; 
-
-struct DirLight {
-    vec3 direction;
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
+// From shaderVariantHeader(): DirLight, FrameConstants, MaterialParams,
+// diffuseMap and the FOG, QUANTIZE and EMISSIVE defines.
 
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
 
-uniform vec3 viewPos;
-uniform DirLight dirLight;
-uniform Material material;
-uniform float time;
-
-uniform float fogNear;
-uniform float fogFar;
-uniform vec3 fogColor;
+// Dim torch fill light, constant for the program and set once at startup
+uniform DirLight torchLight;
 
 const float COLOR_LEVELS = 32.0;
 const float LIGHTING_LEVELS = 8.0;
@@ -39,13 +23,13 @@ vec3 quantizeColor(vec3 color, float levels) {
 }
 
 vec3 calculateTorchLighting(vec3 normal, vec3 texColor) {
-    vec3 lightDir = normalize(-dirLight.direction);
+    vec3 lightDir = normalize(-torchLight.direction);
     
     float diff = max(dot(normal, lightDir), 0.0);
     diff = floor(diff * LIGHTING_LEVELS) / LIGHTING_LEVELS;
     
-    vec3 ambient = dirLight.ambient * texColor * 0.3;
-    vec3 diffuse = dirLight.diffuse * diff * texColor * 0.5;
+    vec3 ambient = torchLight.ambient * texColor * 0.3;
+    vec3 diffuse = torchLight.diffuse * diff * texColor * 0.5;
     
     return ambient + diffuse;
 }
@@ -59,10 +43,11 @@ float calculateFlicker(float time) {
 
 void main() {
     vec3 norm = normalize(Normal);
-    vec3 texColor = texture(material.diffuse, TexCoords).rgb;
+    vec3 texColor = texture(diffuseMap, TexCoords).rgb * material.diffuseColor.rgb;
     
     vec3 result = calculateTorchLighting(norm, texColor);
     
+#ifdef EMISSIVE
     float flicker = calculateFlicker(time);
     vec3 emissive = texColor * material.emissiveStrength * flicker;
     
@@ -72,22 +57,31 @@ void main() {
     }
     
     result += emissive;
+#endif
     
+#ifdef QUANTIZE
     result = quantizeColor(result, COLOR_LEVELS);
+#endif
     
+#ifdef FOG
     float distance = length(viewPos - FragPos);
     float fogFactor = clamp((fogFar - distance) / (fogFar - fogNear), 0.0, 1.0);
     
-    fogFactor = floor(fogFactor * LIGHTING_LEVELS) / LIGHTING_LEVELS;
+    fogFactor = floor(fogFactor * FOG_LEVELS) / FOG_LEVELS;
     
+#ifdef EMISSIVE
     float emissiveFactor = material.emissiveStrength * EMISSIVE_FOG_FACTOR;
     fogFactor = clamp(fogFactor + emissiveFactor, 0.0, 1.0);
+#endif
     
     result = mix(fogColor, result, fogFactor);
+#endif
     
+#ifdef QUANTIZE
     vec2 screenPos = gl_FragCoord.xy;
     float dither = mod(screenPos.x + screenPos.y, DITHER_PATTERN) * DITHER_AMOUNT;
     result += vec3(dither);
+#endif
     
     result = clamp(result, 0.0, 1.0);
     
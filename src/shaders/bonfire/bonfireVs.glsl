@@ -2,17 +2,19 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+// per-instance model matrix (locations 7-10) and parameters
+layout (location = 7) in mat4 aInstanceModel;
+layout (location = 11) in vec4 aInstanceParams;
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// view and projection come from the FrameConstants block in shaderVariantHeader().
 
 void main()
 {
+    mat4 model = aInstanceModel;
     FragPos = vec3(model * vec4(aPos, 1.0));
     Normal = mat3(transpose(inverse(model))) * aNormal;  
     TexCoords = aTexCoords;
@@ -0,0 +1,16 @@
+#version 330 core
+// G-buffer pass of the deferred path, drawn with level/levelVs.glsl.
+layout (location = 0) out vec4 gAlbedo;
+layout (location = 1) out vec4 gNormal;
+
+// MaterialParams and diffuseMap come from shaderVariantHeader().
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+
+void main() {
+    gAlbedo = vec4(texture(diffuseMap, TexCoords).rgb * material.diffuseColor.rgb, 1.0);
+    // [-1, 1] packed into the unsigned normal target
+    gNormal = vec4(normalize(Normal) * 0.5 + 0.5, 1.0);
+}
@@ -0,0 +1,45 @@
+#version 330 core
+// Adds one point light to the light accumulation target for the G-buffer
+// pixels its volume covers. Mirrors CalcPS1PointLight in level/levelFs.glsl.
+out vec4 LightColor;
+
+// lightData, LIGHT_DATA_TEXELS and ATTENUATION_LEVELS come from
+// shaderVariantHeader(SHADER_FEATURE_POINT_LIGHTS).
+
+flat in int LightIndex;
+
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+uniform mat4 inverseViewProjection;
+
+const float LIGHTING_LEVELS = 8.0;
+
+void main() {
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, texel, 0).r;
+    vec2 uv = (vec2(texel) + 0.5) / vec2(textureSize(gDepth, 0));
+    vec4 world = inverseViewProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    vec3 fragPos = world.xyz / world.w;
+
+    vec3 normal = normalize(texelFetch(gNormal, texel, 0).xyz * 2.0 - 1.0);
+    vec3 texColor = texelFetch(gAlbedo, texel, 0).rgb;
+
+    int base = LightIndex * LIGHT_DATA_TEXELS;
+    vec4 positionConstant = texelFetch(lightData, base);
+    vec4 ambientLinear = texelFetch(lightData, base + 1);
+    vec4 diffuseQuadratic = texelFetch(lightData, base + 2);
+
+    vec3 lightDir = normalize(positionConstant.xyz - fragPos);
+    float diff = max(dot(normal, lightDir), 0.0);
+    diff = floor(diff * LIGHTING_LEVELS) / LIGHTING_LEVELS;
+
+    float distance = length(positionConstant.xyz - fragPos);
+    float attenuation = 1.0 / (positionConstant.w + ambientLinear.w * distance + diffuseQuadratic.w * (distance * distance));
+    attenuation = floor(attenuation * ATTENUATION_LEVELS) / ATTENUATION_LEVELS;
+    attenuation = pow(attenuation, 0.7);
+
+    vec3 ambient = ambientLinear.rgb * texColor * 0.1;
+    vec3 diffuse = diffuseQuadratic.rgb * diff * texColor;
+    LightColor = vec4((ambient + diffuse) * attenuation, 1.0);
+}
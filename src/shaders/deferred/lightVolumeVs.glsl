@@ -0,0 +1,24 @@
+#version 330 core
+// One instance per visible point light; position and range come from the
+// light data buffer that LightClusters fills, in the same compact order.
+layout (location = 0) in vec3 aPos;
+
+// view, projection, lightData and LIGHT_DATA_TEXELS come from
+// shaderVariantHeader(SHADER_FEATURE_POINT_LIGHTS).
+
+// Grows the unit sphere so its flat faces still enclose the true sphere.
+uniform float volumeScale;
+// Caps unattenuated lights so their volume stays finite.
+uniform float maxRange;
+
+flat out int LightIndex;
+
+void main()
+{
+    int base = gl_InstanceID * LIGHT_DATA_TEXELS;
+    vec3 center = texelFetch(lightData, base).xyz;
+    float range = min(texelFetch(lightData, base + 3).w, maxRange);
+
+    LightIndex = gl_InstanceID;
+    gl_Position = projection * view * vec4(center + aPos * range * volumeScale, 1.0);
+}
@@ -0,0 +1,71 @@
+#version 330 core
+// Combines the G-buffer and the accumulated point lights into the final
+// color: directional light, PS1 quantization, fog and dithering, as the
+// forward level shader does. Also writes the G-buffer depth so the forward
+// passes that follow are depth tested against the level.
+out vec4 FragColor;
+
+// From shaderVariantHeader(): dirLight, viewPos and the fog values of
+// FrameConstants, FOG_LEVELS and the FOG and QUANTIZE defines.
+
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+uniform sampler2D lightAccumulation;
+uniform mat4 inverseViewProjection;
+uniform vec2 viewportSize;
+
+const float COLOR_LEVELS = 40.0;
+const float LIGHTING_LEVELS = 8.0;
+
+vec3 quantizeColor(vec3 color, float levels) {
+    return floor(color * levels) / levels;
+}
+
+void main() {
+    // Nearest upscale from the internal resolution keeps the chunky pixels.
+    ivec2 internalSize = textureSize(gDepth, 0);
+    ivec2 texel = min(ivec2(gl_FragCoord.xy / viewportSize * vec2(internalSize)), internalSize - 1);
+
+    float depth = texelFetch(gDepth, texel, 0).r;
+    if (depth >= 1.0)
+        discard; // background keeps the clear color
+
+    vec2 uv = (vec2(texel) + 0.5) / vec2(internalSize);
+    vec4 world = inverseViewProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    vec3 fragPos = world.xyz / world.w;
+
+    vec3 normal = normalize(texelFetch(gNormal, texel, 0).xyz * 2.0 - 1.0);
+    vec3 texColor = texelFetch(gAlbedo, texel, 0).rgb;
+
+    vec3 lightDir = normalize(-dirLight.direction);
+    float diff = max(dot(normal, lightDir), 0.0);
+    diff = floor(diff * LIGHTING_LEVELS) / LIGHTING_LEVELS;
+    vec3 result = dirLight.ambient * texColor * 0.2 + dirLight.diffuse * diff * texColor;
+
+    result += texelFetch(lightAccumulation, texel, 0).rgb;
+
+#ifdef QUANTIZE
+    result = quantizeColor(result, COLOR_LEVELS);
+#endif
+
+#ifdef FOG
+    float distance = length(viewPos - fragPos);
+    float fogFactor = clamp((fogFar - distance) / (fogFar - fogNear), 0.0, 1.0);
+    fogFactor = floor(fogFactor * FOG_LEVELS) / FOG_LEVELS;
+    result = mix(fogColor, result, fogFactor);
+#endif
+
+#ifdef QUANTIZE
+    vec2 screenPos = gl_FragCoord.xy;
+    float dither = mod(screenPos.x + screenPos.y, 2.0) * 0.01;
+#ifdef FOG
+    // Fully fogged pixels stay flat, matching the fog-colored clear behind culled geometry.
+    dither *= step(1.0 / FOG_LEVELS, fogFactor);
+#endif
+    result += vec3(dither);
+#endif
+
+    FragColor = vec4(clamp(result, 0.0, 1.0), 1.0);
+    gl_FragDepth = depth;
+}
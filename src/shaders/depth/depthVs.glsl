@@ -0,0 +1,17 @@
+#version 330 core
+// Depth pre-pass. Only the position is read, and gl_Position is computed
+// exactly as in level/levelVs.glsl; both are invariant, so the shading pass
+// can test against this depth with GL_EQUAL.
+layout (location = 0) in vec3 aPos;
+// per-instance model matrix (locations 7-10)
+layout (location = 7) in mat4 aInstanceModel;
+
+// view and projection come from the FrameConstants block in shaderVariantHeader(0).
+
+invariant gl_Position;
+
+void main()
+{
+    mat4 model = aInstanceModel;
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+}
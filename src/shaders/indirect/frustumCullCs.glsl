@@ -0,0 +1,53 @@
+#version 430 core
+// Frustum culling of the meshes drawn by IndirectScene. One invocation per
+// indirect command: the command draws its single instance or nothing. The
+// test matches FrustumCuller: a mesh survives unless its box or its sphere
+// (same center) lies entirely behind one of the planes.
+layout (local_size_x = 64) in;
+
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+// one per command, matches IndirectScene::GpuBounds
+struct Bounds {
+    vec4 centerRadius; // xyz box center, w sphere radius
+    vec3 halfExtent;
+    uint meshIndex;    // position in its model, for the mask
+};
+
+layout (std430, binding = 0) readonly buffer BoundsBuffer { Bounds bounds[]; };
+layout (std430, binding = 1) buffer Commands { DrawCommand commands[]; };
+// one byte per mesh index, four to a word
+layout (std430, binding = 2) readonly buffer Mask { uint mask[]; };
+
+uniform vec4 planes[6];
+uniform int objectCount;
+uniform bool useMask;
+
+void main()
+{
+    uint object = gl_GlobalInvocationID.x;
+    if (object >= uint(objectCount))
+        return;
+
+    vec4 center = bounds[object].centerRadius;
+    vec3 extent = bounds[object].halfExtent;
+
+    bool visible = true;
+    if (useMask) {
+        uint mesh = bounds[object].meshIndex;
+        visible = ((mask[mesh >> 2u] >> ((mesh & 3u) * 8u)) & 0xFFu) != 0u;
+    }
+    for (int p = 0; p < 6 && visible; p++) {
+        float distance = dot(planes[p].xyz, center.xyz) + planes[p].w;
+        float reach = min(dot(abs(planes[p].xyz), extent), center.w);
+        visible = distance >= -reach;
+    }
+
+    commands[object].instanceCount = visible ? 1u : 0u;
+}
@@ -1,46 +1,14 @@
 #version 330 core
 out vec4 FragColor;
 
-struct Material {
-    sampler2D diffuse;
-    float shininess;
-    float alpha;  // Added material alpha support
-    // Removed specular sampler2D since PS1 rarely used specular maps
-}; 
-
-struct DirLight {
-    vec3 direction;
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct PointLight {
-    vec3 position;
-    float constant;
-    float linear;
-    float quadratic;
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-#define NR_POINT_LIGHTS 9
+// From shaderVariantHeader(): FrameConstants, MaterialParams, diffuseMap, the
+// light cluster lookups, ATTENUATION_LEVELS, FOG_LEVELS and the POINT_LIGHTS,
+// FOG and QUANTIZE defines.
 
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
 
-uniform vec3 viewPos;
-uniform DirLight dirLight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform Material material;
-
-// PS1-style fog uniforms
-uniform float fogNear;
-uniform float fogFar;
-uniform vec3 fogColor;
-
 // PS1-style quantization levels - adjusted for more dramatic contrast
 const float COLOR_LEVELS = 40.0;  // Slightly reduced for more visible banding
 const float LIGHTING_LEVELS = 8.0; // Fewer levels for sharper light transitions
@@ -51,26 +19,23 @@ vec3 quantizeColor(vec3 color, float levels) {
 }
 
 // Simple PS1-style directional light (no fancy Phong)
-vec3 CalcPS1DirLight(DirLight light, vec3 normal) {
+vec3 CalcPS1DirLight(DirLight light, vec3 normal, vec3 texColor) {
     vec3 lightDir = normalize(-light.direction);
     
     // Simple dot product for lighting, quantized
     float diff = max(dot(normal, lightDir), 0.0);
     diff = floor(diff * LIGHTING_LEVELS) / LIGHTING_LEVELS;
     
-    // Sample texture with alpha
-    vec4 texColor = texture(material.diffuse, TexCoords);
-    
     // PS1 didn't have sophisticated ambient/diffuse separation
     // Just blend between dark and lit based on the quantized lighting
-    vec3 ambient = light.ambient * texColor.rgb * 0.2; // Slightly darker ambient
-    vec3 diffuse = light.diffuse * diff * texColor.rgb;
+    vec3 ambient = light.ambient * texColor * 0.2; // Slightly darker ambient
+    vec3 diffuse = light.diffuse * diff * texColor;
     
     return ambient + diffuse;
 }
 
 // PS1-style point light with harsh falloff
-vec3 CalcPS1PointLight(PointLight light, vec3 normal, vec3 fragPos) {
+vec3 CalcPS1PointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 texColor) {
     vec3 lightDir = normalize(light.position - fragPos);
     
     // Quantized diffuse lighting
@@ -82,16 +47,15 @@ vec3 CalcPS1PointLight(PointLight light, vec3 normal, vec3 fragPos) {
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
     
     // More aggressive quantization for sharper light boundaries
-    attenuation = floor(attenuation * (LIGHTING_LEVELS * 1.5)) / (LIGHTING_LEVELS * 1.5);
+    // (pointLightRange() in lightClusters.cpp relies on these levels)
+    attenuation = floor(attenuation * ATTENUATION_LEVELS) / ATTENUATION_LEVELS;
     
     // Enhance contrast - make bright areas brighter, dark areas darker
     attenuation = pow(attenuation, 0.7); // Gamma-like adjustment for more contrast
     
-    vec4 texColor = texture(material.diffuse, TexCoords);
-    
     // Reduced ambient to make shadows deeper
-    vec3 ambient = light.ambient * texColor.rgb * 0.1;
-    vec3 diffuse = light.diffuse * diff * texColor.rgb;
+    vec3 ambient = light.ambient * texColor * 0.1;
+    vec3 diffuse = light.diffuse * diff * texColor;
     
     return (ambient + diffuse) * attenuation;
 }
@@ -100,34 +64,47 @@ void main() {
     vec3 norm = normalize(Normal);
     
     // Sample texture alpha for transparency, but also use material alpha
-    vec4 texSample = texture(material.diffuse, TexCoords);
+    vec4 texSample = texture(diffuseMap, TexCoords) * material.diffuseColor;
     float alpha = texSample.a * material.alpha;  // Combine texture and material alpha
     
-    // Start with directional lighting
-    vec3 result = CalcPS1DirLight(dirLight, norm);
+    // Start with directional lighting; the texture is sampled once for all lights
+    vec3 result = CalcPS1DirLight(dirLight, norm, texSample.rgb);
     
-    // Add point lights (now all 9 torches)
-    for(int i = 0; i < NR_POINT_LIGHTS; i++) {
-        result += CalcPS1PointLight(pointLights[i], norm, FragPos);
+#ifdef POINT_LIGHTS
+    // Add only the point lights binned into this fragment's cluster
+    uvec2 cluster = lightCluster(gl_FragCoord.xy, FragPos);
+    for(uint i = 0u; i < cluster.y; i++) {
+        result += CalcPS1PointLight(fetchPointLight(cluster.x + i), norm, FragPos, texSample.rgb);
     }
+#endif
     
+#ifdef QUANTIZE
     // Quantize the final color to simulate PS1's limited color depth
     result = quantizeColor(result, COLOR_LEVELS);
+#endif
     
+#ifdef FOG
     // Calculate PS1-style fog
     float distance = length(viewPos - FragPos);
     float fogFactor = clamp((fogFar - distance) / (fogFar - fogNear), 0.0, 1.0);
     
     // Quantize fog factor for PS1-style stepped fog
-    fogFactor = floor(fogFactor * LIGHTING_LEVELS) / LIGHTING_LEVELS;
+    fogFactor = floor(fogFactor * FOG_LEVELS) / FOG_LEVELS;
     
     // Mix lit color with fog color
     result = mix(fogColor, result, fogFactor);
+#endif
     
+#ifdef QUANTIZE
     // Optional: Add slight dithering pattern for more authentic PS1 look
     vec2 screenPos = gl_FragCoord.xy;
     float dither = mod(screenPos.x + screenPos.y, 2.0) * 0.01;
+#ifdef FOG
+    // Fully fogged pixels stay flat, matching the fog-colored clear behind culled geometry.
+    dither *= step(1.0 / FOG_LEVELS, fogFactor);
+#endif
     result += vec3(dither);
+#endif
     
     // Clamp to prevent over-bright colors
     result = clamp(result, 0.0, 1.0);
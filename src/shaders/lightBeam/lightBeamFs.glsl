@@ -0,0 +1,47 @@
+#version 330 core
+out vec4 FragColor;
+
+// DirLight, MaterialParams, diffuseMap and the QUANTIZE define come from
+// shaderVariantHeader().
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+in float InstanceAlpha; // per-layer alpha from the instance data
+
+// Bright self-illumination for the beam, constant for the program and set once at startup.
+// The beam ignores the point lights and fog of the frame constants.
+uniform DirLight beamLight;
+
+const float COLOR_LEVELS = 40.0;
+const float LIGHTING_LEVELS = 8.0;
+
+vec3 quantizeColor(vec3 color, float levels) {
+    return floor(color * levels) / levels;
+}
+
+void main() {
+    vec3 norm = normalize(Normal);
+
+    vec4 texSample = texture(diffuseMap, TexCoords) * material.diffuseColor;
+    float alpha = texSample.a * InstanceAlpha;
+
+    vec3 lightDir = normalize(-beamLight.direction);
+    float diff = max(dot(norm, lightDir), 0.0);
+    diff = floor(diff * LIGHTING_LEVELS) / LIGHTING_LEVELS;
+
+    vec3 ambient = beamLight.ambient * texSample.rgb * 0.2;
+    vec3 diffuse = beamLight.diffuse * diff * texSample.rgb;
+    vec3 result = ambient + diffuse;
+
+#ifdef QUANTIZE
+    result = quantizeColor(result, COLOR_LEVELS);
+
+    vec2 screenPos = gl_FragCoord.xy;
+    float dither = mod(screenPos.x + screenPos.y, 2.0) * 0.01;
+    result += vec3(dither);
+#endif
+
+    result = clamp(result, 0.0, 1.0);
+    FragColor = vec4(result, alpha);
+}
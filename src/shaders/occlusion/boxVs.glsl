@@ -0,0 +1,14 @@
+#version 330 core
+// Bounding box of a batch for its occlusion query; drawn with color and depth
+// writes off, so it only counts samples that pass the depth already there.
+layout (location = 0) in vec3 aPos; // unit cube corner in [0, 1]
+
+// view and projection come from the FrameConstants block in shaderVariantHeader(0).
+
+uniform vec3 boxMin;
+uniform vec3 boxMax;
+
+void main()
+{
+    gl_Position = projection * view * vec4(mix(boxMin, boxMax, aPos), 1.0);
+}
@@ -0,0 +1,33 @@
+#version 330 core
+// One level of the Hi-Z pyramid. Every texel keeps the farthest occluder
+// depth of the texels it covers one level down, so anything nearer than that
+// somewhere in the area may be visible and anything farther is certainly hidden.
+// The source's base level is set to the level being read, so lod 0 is it.
+out float FragColor;
+
+uniform sampler2D source;
+uniform bool reduce; // false: copy the occluder depth into level 0
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    if (!reduce) {
+        FragColor = texelFetch(source, texel, 0).r;
+        return;
+    }
+
+    ivec2 size = textureSize(source, 0);
+    ivec2 base = texel * 2;
+    // An odd source row or column has no pair; the last texel takes it as a third.
+    ivec2 span = ivec2(1);
+    if ((size.x & 1) == 1 && base.x + 3 == size.x) span.x = 2;
+    if ((size.y & 1) == 1 && base.y + 3 == size.y) span.y = 2;
+
+    float depth = 0.0;
+    for (int y = 0; y <= span.y; y++) {
+        for (int x = 0; x <= span.x; x++) {
+            depth = max(depth, texelFetch(source, min(base + ivec2(x, y), size - 1), 0).r);
+        }
+    }
+    FragColor = depth;
+}
@@ -0,0 +1,10 @@
+#version 330 core
+// Writes the verdict of occlusionTestVs into the R8 visibility target.
+flat in float visible;
+
+out vec4 FragColor;
+
+void main()
+{
+    FragColor = vec4(visible);
+}
@@ -0,0 +1,67 @@
+#version 330 core
+// One point per candidate box. The box is projected, the pyramid level where
+// its screen rectangle spans at most 2x2 texels is picked, and the box counts
+// as hidden if its nearest depth lies behind the farthest occluder depth of
+// those texels. The verdict lands in texel (i % width, i / width) of the
+// visibility target.
+layout (location = 0) in vec3 aCenter;
+layout (location = 1) in vec3 aHalfExtent;
+
+// view and projection come from the FrameConstants block in shaderVariantHeader(0).
+
+uniform sampler2D hiZ;
+uniform int hiZLevels;
+uniform vec2 targetSize;
+
+flat out float visible;
+
+void main()
+{
+    int width = int(targetSize.x);
+    vec2 texel = vec2(gl_VertexID % width, gl_VertexID / width) + 0.5;
+    gl_Position = vec4(texel / targetSize * 2.0 - 1.0, 0.0, 1.0);
+
+    mat4 viewProjection = projection * view;
+    vec3 ndcMin = vec3(1.0e9);
+    vec3 ndcMax = vec3(-1.0e9);
+    for (int i = 0; i < 8; i++) {
+        vec3 corner = aCenter + aHalfExtent * vec3((i & 1) != 0 ? 1.0 : -1.0,
+                                                   (i & 2) != 0 ? 1.0 : -1.0,
+                                                   (i & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = viewProjection * vec4(corner, 1.0);
+        // The box reaches past the near plane, so it surrounds the camera.
+        if (clip.w <= 0.0 || clip.z < -clip.w) {
+            visible = 1.0;
+            return;
+        }
+        vec3 ndc = clip.xyz / clip.w;
+        ndcMin = min(ndcMin, ndc);
+        ndcMax = max(ndcMax, ndc);
+    }
+
+    vec2 uvMin = clamp(ndcMin.xy * 0.5 + 0.5, 0.0, 1.0);
+    vec2 uvMax = clamp(ndcMax.xy * 0.5 + 0.5, 0.0, 1.0);
+    // Off screen in this view; later frames' frustum test decides, so it must not stay culled.
+    if (any(greaterThanEqual(uvMin, uvMax))) {
+        visible = 1.0;
+        return;
+    }
+
+    // Walk up from level 0 the same way the reduction did, so each texel
+    // still covers every level 0 texel under the rectangle.
+    ivec2 size = textureSize(hiZ, 0);
+    ivec2 lo = clamp(ivec2(uvMin * vec2(size)), ivec2(0), size - 1);
+    ivec2 hi = clamp(ivec2(uvMax * vec2(size)), ivec2(0), size - 1);
+    int level = 0;
+    while (level < hiZLevels - 1 && any(greaterThan(hi - lo, ivec2(1)))) {
+        level++;
+        size = textureSize(hiZ, level);
+        lo = min(lo >> 1, size - 1);
+        hi = min(hi >> 1, size - 1);
+    }
+
+    float farthest = max(max(texelFetch(hiZ, lo, level).r, texelFetch(hiZ, ivec2(hi.x, lo.y), level).r),
+                         max(texelFetch(hiZ, ivec2(lo.x, hi.y), level).r, texelFetch(hiZ, hi, level).r));
+    float nearest = ndcMin.z * 0.5 + 0.5;
+    visible = nearest <= farthest ? 1.0 : 0.0;
+}
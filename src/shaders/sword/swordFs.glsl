@@ -1,39 +1,13 @@
 #version 330 core
 out vec4 FragColor;
 
-struct Material {
-    sampler2D diffuse;
-    float shininess;
-}; 
-
-struct DirLight {
-    vec3 direction;
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct PointLight {
-    vec3 position;
-    float constant;
-    float linear;
-    float quadratic;
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-#define NR_POINT_LIGHTS 9
+// From shaderVariantHeader(): DirLight, FrameConstants, MaterialParams,
+// diffuseMap, the light cluster lookups and the POINT_LIGHTS and QUANTIZE defines.
 
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
 
-uniform vec3 viewPos;
-uniform DirLight dirLight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform Material material;
-
 // PS1-style quantization levels
 const float COLOR_LEVELS = 32.0;
 const float LIGHTING_LEVELS = 8.0;
@@ -42,19 +16,18 @@ vec3 quantizeColor(vec3 color, float levels) {
     return floor(color * levels) / levels;
 }
 
-vec3 CalcPS1DirLight(DirLight light, vec3 normal) {
+vec3 CalcPS1DirLight(DirLight light, vec3 normal, vec3 texColor) {
     vec3 lightDir = normalize(-light.direction);
     float diff = max(dot(normal, lightDir), 0.0);
     diff = floor(diff * LIGHTING_LEVELS) / LIGHTING_LEVELS;
 
-    vec3 texColor = texture(material.diffuse, TexCoords).rgb;
     vec3 ambient = light.ambient * texColor * 0.3;
     vec3 diffuse = light.diffuse * diff * texColor;
 
     return ambient + diffuse;
 }
 
-vec3 CalcPS1PointLight(PointLight light, vec3 normal, vec3 fragPos) {
+vec3 CalcPS1PointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 texColor) {
     vec3 lightDir = normalize(light.position - fragPos);
     float diff = max(dot(normal, lightDir), 0.0);
     diff = floor(diff * LIGHTING_LEVELS) / LIGHTING_LEVELS;
@@ -63,7 +36,6 @@ vec3 CalcPS1PointLight(PointLight light, vec3 normal, vec3 fragPos) {
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
     attenuation = floor(attenuation * LIGHTING_LEVELS) / LIGHTING_LEVELS;
 
-    vec3 texColor = texture(material.diffuse, TexCoords).rgb;
     vec3 ambient = light.ambient * texColor * 0.2;
     vec3 diffuse = light.diffuse * diff * texColor;
 
@@ -74,23 +46,29 @@ void main() {
     vec3 norm = normalize(Normal);
     vec3 result = vec3(0.0);
     vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 texColor = texture(diffuseMap, TexCoords).rgb * material.diffuseColor.rgb;
 
     // Directional light
-    vec3 dirColor = CalcPS1DirLight(dirLight, norm);
+    vec3 dirColor = CalcPS1DirLight(dirLight, norm, texColor);
     vec3 dirLightDir = normalize(-dirLight.direction);
     float dirSpec = pow(max(dot(viewDir, reflect(-dirLightDir, norm)), 0.0), material.shininess);
     vec3 dirSpecular = dirLight.specular * dirSpec;
     result += dirColor + dirSpecular;
 
-    // Point lights
-    for(int i = 0; i < NR_POINT_LIGHTS; i++) {
-        vec3 pointColor = CalcPS1PointLight(pointLights[i], norm, FragPos);
-        vec3 pointDir = normalize(pointLights[i].position - FragPos);
+#ifdef POINT_LIGHTS
+    // Point lights binned into this fragment's cluster
+    uvec2 cluster = lightCluster(gl_FragCoord.xy, FragPos);
+    for(uint i = 0u; i < cluster.y; i++) {
+        PointLight light = fetchPointLight(cluster.x + i);
+        vec3 pointColor = CalcPS1PointLight(light, norm, FragPos, texColor);
+        vec3 pointDir = normalize(light.position - FragPos);
         float pointSpec = pow(max(dot(viewDir, reflect(-pointDir, norm)), 0.0), material.shininess);
-        vec3 pointSpecular = pointLights[i].specular * pointSpec;
+        vec3 pointSpecular = light.specular * pointSpec;
         result += pointColor + pointSpecular;
     }
+#endif
 
+#ifdef QUANTIZE
     // Quantize final color
     result = quantizeColor(result, COLOR_LEVELS);
 
@@ -98,6 +76,7 @@ void main() {
     vec2 screenPos = gl_FragCoord.xy;
     float dither = mod(screenPos.x + screenPos.y, 2.0) * 0.01;
     result += vec3(dither);
+#endif
 
     result = clamp(result, 0.0, 1.0);
     FragColor = vec4(result, 1.0);